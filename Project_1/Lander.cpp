@@ -159,214 +159,163 @@
   Standard C libraries
 */
 #include <math.h>
+#include <string.h>
 
-#include "Lander_Control.h"
+#include "Lander_Controller.h"
+#include "Lander_Profile.h"
+
+#define DEG2RAD (PI/180.0)
+#define RAD2DEG (180.0/PI)
 
 /*
-  Global Variables
+  Recovery flight (see Lander_Phase.h)
 */
 
-// Updates is sensors are working
-// 0: X-vel
-// 1: Y-vel
-// 2: X-pos
-// 3: Y-pos
-// 4: Angle
-// 5: Dist
-bool broken[6] = {true, true, true, true, true, true};
-
-// Store the last 5 values of each sensor
-double xvel_sensor[5];
-double yvel_sensor[5];
-double xpos_sensor[5];
-double ypos_sensor[5];
-double angle_sensor[5];
-double dist_sensor[5];
-bool init_gv = false;
+// Velocity response of the vector phase (1/s), and the time in which it
+// means to close the distance to its target (s)
+#define VEC_GAIN 2.0
+#define VEC_T 2.0
+
+// Largest tilt of the thrust off vertical, and on the main thruster
+// within mid_y of the platform, where the lander must stay within 15
+// degrees of upright (degrees)
+#define VEC_TILT 30.0
+#define VEC_TILT_LAND 8.0
+
+// The lift thruster stays off while the lander has more than this to
+// turn (degrees)
+#define VEC_ALIGN 20.0
+
+// Climb rate when the terrain is too close (m/s), up to VEC_CEILING
+// pixels from the top of the map. Without the sonar the climb phase
+// takes the lander up once it is CLIMB_SLACK pixels below that
+#define VEC_CLIMB 4.0
+#define VEC_CEILING 40.0
+#define CLIMB_SLACK 10.0
+
+// Hover height over the platform on a side thruster (pixels above
+// PLAT_Y): far enough for the lander (radius 31) to turn upright clear
+// of it, close enough that the fall stays below 10 m/s. Hover starts
+// within HOVER_X pixels of it and aims to reach it in HOVER_T seconds,
+// tilting at most HOVER_TILT degrees
+#define HOVER_H 40.0
+#define HOVER_X 30.0
+#define HOVER_T 1.0
+#define HOVER_TILT 20.0
+
+// Drop from the hover within DROP_DH pixels of its height, DROP_X of the
+// platform centre and below DROP_V m/s either way
+#define DROP_DH 3.0
+#define DROP_X 6.0
+#define DROP_V 1.0
 
 /*
-  Helper functions
+  Controller state
 */
 
-// Returns the weighted average of a 5-array
-double GetAvg(double (&arr)[5]) {
-  double avg = 0;
-  int count = 0;
-  for (int i = 0; i < 5; i++) {
-    count += 5 - i;
-    avg += (5 - i) * arr[i];
-  }
-  return avg/count;
+LanderController::LanderController(LanderIO *io) : io(io), policy(NULL) {
+  Set_Params(NULL);
+  Reset();
 }
 
-// Returns noise reduced value
-double ReduceNoise(double avg, double sensor) {
-  return (avg + 3 * sensor)/4;
+void LanderController::Set_Params(const ControllerParams *params) {
+  if (params != NULL) this->params = *params;
+  else Params_Default(&this->params);
+  est.Set_Limits(this->params.gate, this->params.var_limit, this->params.bias_limit);
 }
 
-// Returns if the input value is within delta of the avg
-bool IsOutlier(double avg, double val, double delta) {
-  return (val/avg > (1 + delta) || val/avg < (1 - delta)) ? false : true;
-}
-
-// Updates the history and returns the last value
-double UpdateHistory(double val, double (&his)[5]) {
-  for (int i = 4; i > 0; i--) {
-      his[i] = his[i - 1];
-    }
-    his[0] = val;
-    return val;
+void LanderController::Reset() {
+  est.Reset();
+  sonar.Reset();
+  pred.Reset();
+  snap_fresh = false;
+  memset(&snap, 0, sizeof(snap));
+  memset(&cmd, 0, sizeof(cmd));
+  memset(&pending, 0, sizeof(pending));
+  memset(&timeline, 0, sizeof(timeline));
+  phase = -1;
+  tick = 0;
+  overrides = 0;
 }
 
-// Returns the X velocity
-// Removes the noise, checks if the sensor is working
-double Velocity_X_R() {
-  // Get the weighted average from the recent history of X locations
-  double avg = GetAvg(xvel_sensor);
-
-  // Get the noisy input
-  double x_sen = Velocity_X();
-
-  // Get noise reduce value
-  double x_r = ReduceNoise(avg, x_sen);
-
-  // If the sensor is not broken
-  if (!broken[0]) {
-    // Check if the sensor is broken 
-    // >25% difference from avg
-    bool works = IsOutlier(avg, x_r, 0.25);
-
-    // If the sensor works, update history and return sensor
-    if (works) return UpdateHistory(x_r, xvel_sensor);
-
-    // If the sensor is newly broken, update broken list
-    broken[0] = false;
+// Reads every sensor and flight computer variable once for this tick and
+// brings the state estimate up to date
+void LanderController::Read_Sensors() {
+  {
+    PROF_SCOPE(PROF_READ);
+    snap.vx = io->Velocity_X();
+    snap.vy = io->Velocity_Y();
+    snap.px = io->Position_X();
+    snap.py = io->Position_Y();
+    snap.angle = io->Angle();
+    snap.range = io->RangeDist();
+    memcpy(snap.sonar, io->SONAR_DIST(), sizeof(snap.sonar));
+    sonar.Update(snap.sonar);
+    snap.MT_OK = io->MT_OK();
+    snap.RT_OK = io->RT_OK();
+    snap.LT_OK = io->LT_OK();
+    snap.plat_x = io->PLAT_X();
+    snap.plat_y = io->PLAT_Y();
+    snap_fresh = true;
+    cmd.rotated = false;
   }
 
-  // If broken, try to use X position to determine velocity
-  // If X position sensor is also not broken
-  double pos_avg = GetAvg(xvel_sensor);
-  double x_pos = ReduceNoise(pos_avg, Position_X());
-  double x_r2 = UpdateHistory(x_pos - xpos_sensor[0], xvel_sensor);
-  if (!broken[2]) return x_r2;
-
-  // If both sensors are broken, return their average
-  // This is beyond the scope of the problem
-  return (x_r + x_r2)/2;
+  PROF_SCOPE(PROF_ESTIMATE);
+  est.Update(&snap);
+  pred.Update(snap.sonar, est.Position_X(), est.Position_Y());
 }
 
-// Returns the Y velocity
-// Removes the noise, checks if the sensor is working
-double Velocity_Y_R() {
-  // Get the weighted average from the recent history of X locations
-  double avg = GetAvg(yvel_sensor);
-
-  // Get the noisy input
-  double y_sen = Velocity_Y();
-
-  // Get noise reduce value
-  double y_r = ReduceNoise(avg, y_sen);
-
-  // If the sensor is not broken
-  if (!broken[1]) {
-    // Check if the sensor is broken 
-    // >25% difference from avg
-    bool works = IsOutlier(avg, y_r, 0.25);
-
-    // If the sensor works, update history and return sensor
-    if (works) return UpdateHistory(y_r, yvel_sensor);
-
-    // If the sensor is newly broken, update broken list
-    broken[1] = false;
-  }
-
-  // If broken, try to use X position to determine velocity
-  // If X position sensor is also not broken
-  double pos_avg = GetAvg(ypos_sensor);
-  double y_pos = ReduceNoise(pos_avg, Position_Y());
-  double y_r2 = UpdateHistory(y_pos - ypos_sensor[0], yvel_sensor);
-  if (!broken[3]) return y_r2;
+/*
+  Flight controls
+*/
 
-  // If both sensors are broken, return their average
-  // This is beyond the scope of the problem
-  return (y_r + y_r2)/2;
+void LanderController::Main_Thruster(double power) {
+  pending.pw[0] = power;
+  pending.set[0] = true;
 }
 
-// Returns the X position
-// Removes the noise, checks if the sensor is working
-double Position_X_R() {
-  // Get the weighted average from the recent history of X locations
-  double avg = GetAvg(xpos_sensor);
-
-  // Get the noisy input
-  double x_sen = Position_X();
-
-  // Get noise reduce value
-  double x_r = ReduceNoise(avg, x_sen);
-
-  // If the sensor is not broken
-  if (!broken[2]) {
-    // Check if the sensor is broken 
-    // >25% difference from avg
-    bool works = IsOutlier(avg, x_r, 0.25);
-
-    // If the sensor works, update history and return sensor
-    if (works) return UpdateHistory(x_r, xpos_sensor);
-
-    // If the sensor is newly broken, update broken list
-    broken[2]= false;
-  }
-
-  // If broken, try to use X velocity to determine position
-  // If X position sensor is also not broken
-  double vel_avg = GetAvg(xvel_sensor);
-  double x_vel = ReduceNoise(vel_avg, Velocity_X());
-  double x_r2 = UpdateHistory(xpos_sensor[0] + x_vel, xpos_sensor);
-  if (!broken[0]) return x_r2;
-
-  // If both sensors are broken, return their average
-  // This is beyond the scope of the problem
-  return (x_r + x_r2)/2;
+void LanderController::Left_Thruster(double power) {
+  pending.pw[1] = power;
+  pending.set[1] = true;
 }
 
-// Returns the Y position
-// Removes the noise, checks if the sensor is working
-double Position_Y_R() {
-  // Get the weighted average from the recent history of Y locations
-  double avg = GetAvg(ypos_sensor);
-
-  // Get the noisy input
-  double y_sen = Position_Y();
-
-  // Get noise reduce value
-  double y_r = ReduceNoise(avg, y_sen);
-
-  // If the sensor is not broken
-  if (!broken[3]) {
-    // Check if the sensor is broken 
-    // >25% difference from avg
-    bool works = IsOutlier(avg, y_r, 0.25);
+void LanderController::Right_Thruster(double power) {
+  pending.pw[2] = power;
+  pending.set[2] = true;
+}
 
-    // If the sensor works, update history and return sensor
-    if (works) return UpdateHistory(y_r, ypos_sensor);
+void LanderController::Rotate(double angle) {
+  pending.rotate = angle;
+  pending.rotated = true;
+}
 
-    // If the sensor is newly broken, update broken list
-    broken[3]= false;
+// Sends the commands decided this tick, the last one per actuator
+void LanderController::Issue() {
+  if (pending.set[0]) {
+    io->Main_Thruster(pending.pw[0]);
+    est.Command_Main(pending.pw[0]);
+    cmd.main_pw = pending.pw[0];
   }
-
-  // If broken, try to use X velocity to determine position
-  // If X position sensor is also not broken
-  double vel_avg = GetAvg(yvel_sensor);
-  double y_vel = ReduceNoise(vel_avg, Velocity_Y());
-  double y_r2 = UpdateHistory(ypos_sensor[0] + y_vel, ypos_sensor);
-  if (!broken[0]) return y_r2;
-
-  // If both sensors are broken, return their average
-  // This is beyond the scope of the problem
-  return (y_r + y_r2)/2;
+  if (pending.set[1]) {
+    io->Left_Thruster(pending.pw[1]);
+    est.Command_Left(pending.pw[1]);
+    cmd.left_pw = pending.pw[1];
+  }
+  if (pending.set[2]) {
+    io->Right_Thruster(pending.pw[2]);
+    est.Command_Right(pending.pw[2]);
+    cmd.right_pw = pending.pw[2];
+  }
+  if (pending.rotated) {
+    io->Rotate(pending.rotate);
+    est.Command_Rotate(pending.rotate);
+    cmd.rotate = pending.rotate;
+    cmd.rotated = true;
+  }
+  memset(&pending, 0, sizeof(pending));
 }
 
-void Lander_Control(void)
+void LanderController::Lander_Control()
 {
  /*
    This is the main control function for the lander. It attempts
@@ -388,6 +337,13 @@ void Lander_Control(void)
 
    As noted above, this function assumes everything is working
    fine.
+
+   Each tick runs only the active flight phase (see Lander_Phase.h):
+   the steps above are stabilize, and cruise, descend and final, which
+   differ only in their limits. Once a thruster is lost the recovery
+   phases fly on whatever is left. The safety checks of
+   Safety_Override() run at the end of the tick, and whatever was
+   decided is sent once per actuator.
 */
 
 /*************************************************
@@ -418,59 +374,171 @@ void Lander_Control(void)
         I'll give you zero.
 **************************************************/
 
-  if (!init_gv) {
-    for (int i = 0; i< 5; i++) {
-      xvel_sensor[i] = Velocity_X();
-      yvel_sensor[i] = Velocity_Y();
-      xpos_sensor[i] = Position_X();
-      ypos_sensor[i] = Position_Y();
-      angle_sensor[i] = Angle();
-      dist_sensor[i] = RangeDist();
+  PROF_SCOPE(PROF_CONTROL);
+  Read_Sensors();
+  {
+    PROF_SCOPE(PROF_DECIDE);
+    Enter_Phase(Next_Phase());
+    if (phase == PHASE_POLICY) Policy_Control();
+    else if (phase == PHASE_STABILIZE) Fly_Stabilize();
+    else if (phase == PHASE_CLIMB) Fly_Climb();
+    else if (PHASE_RECOVERY(phase)) Fly_Recovery();
+    else
+    {
+      double PLAT_X = snap.plat_x;
+      double PLAT_Y = snap.plat_y;
+      double xpr = est.Position_X();
+      double ypr = est.Position_Y();
+
+      // Set velocity limits depending on distance to platform.
+      // If the module is far from the platform allow it to
+      // move faster, decrease speed limits as the module
+      // approaches landing. The phase already says which
+      // tiers are possible.
+      // (The limits are in params, see Lander_Params.h)
+      double VXlim;
+      double VYlim;
+      if (phase == PHASE_CRUISE)
+      {
+        if (fabs(xpr-PLAT_X)>params.far_x) VXlim=params.vx_far;
+        else VXlim=params.vx_mid;
+        if (PLAT_Y-ypr>params.far_y) VYlim=-params.vy_far;
+        else if (PLAT_Y-ypr>params.mid_y) VYlim=-params.vy_mid;  // These are negative because they
+        else VYlim=-params.vy_near;                                // limit descent velocity
+        if (est.Faults()->Faulty(FAULT_SONAR)) VYlim=0;            // Blind, hold the height
+      }
+      else if (phase == PHASE_DESCEND)
+      {
+        VXlim=params.vx_near;
+        if (PLAT_Y-ypr>params.far_y) VYlim=-params.vy_far;
+        else VYlim=-params.vy_mid;
+      }
+      else
+      {
+        VXlim=params.vx_near;
+        VYlim=-params.vy_near;
+      }
+
+      // Ensure we will be OVER the platform when we land
+      double xvr = est.Velocity_X();
+      double yvr = est.Velocity_Y();
+      if (fabs(PLAT_X-xpr)/fabs(xvr)>params.overshoot*fabs(PLAT_Y-ypr)/fabs(yvr)) VYlim=0;
+
+      Fly_Upright(VXlim, VYlim);
     }
-    init_gv = true;
   }
 
-  double VXlim;
-  double VYlim;
+  // The recovery phases keep their own distance from the terrain, the
+  // checks below assume an upright lander
+  if (!PHASE_RECOVERY(phase) && Safety_Check()) overrides++;
+  Issue();
+}
 
-  // Set velocity limits depending on distance to platform.
-  // If the module is far from the platform allow it to
-  // move faster, decrease speed limits as the module
-  // approaches landing. You may need to be more conservative
-  // with velocity limits when things fail.
-  double xpr = Position_X_R();
-  if (fabs(xpr-PLAT_X)>200) VXlim=25;
-  else if (fabs(xpr-PLAT_X)>100) VXlim=15;
-  else VXlim=5;
-
-  double ypr = Position_Y_R();
-  if (PLAT_Y-ypr>200) VYlim=-20;
-  else if (PLAT_Y-ypr>100) VYlim=-10;  // These are negative because they
-  else VYlim=-4;				       // limit descent velocity
-
-  // Ensure we will be OVER the platform when we land
-  double xvr = Velocity_X_R();
-  double yvr = Velocity_Y_R();
-  if (fabs(PLAT_X-xpr)/fabs(xvr)>1.25*fabs(PLAT_Y-ypr)/fabs(yvr)) VYlim=0;
-
-  // IMPORTANT NOTE: The code below assumes all components working
-  // properly. IT MAY OR MAY NOT BE USEFUL TO YOU when components
-  // fail. More likely, you will need a set of case-based code
-  // chunks, each of which works under particular failure conditions.
-
-  // Check for rotation away from zero degrees - Rotate first,
-  // use thrusters only when not rotating to avoid adding
-  // velocity components along the rotation directions
-  // Note that only the latest Rotate() command has any
-  // effect, i.e. the rotation angle does not accumulate
-  // for successive calls.
-
-  if (Angle()>1&&Angle()<359)
-  {
-    if (Angle()>=180) Rotate(360-Angle());
-    else Rotate(-Angle());
-    return;
+/*
+  Flight phases
+*/
+
+// Thruster j (0 main, 1 left, 2 right) works, as far as the flight
+// computer can tell
+static bool Thruster_Up(const SensorSnapshot *snap, const StateEstimator *est, int j) {
+  static const int comp[3] = {FAULT_MAIN, FAULT_LEFT, FAULT_RIGHT};
+  int ok = j == 0 ? snap->MT_OK : j == 1 ? snap->LT_OK : snap->RT_OK;
+  return ok && !est->Faults()->Faulty(comp[j]);
+}
+
+// The thruster to lift on: main if it works, else left, else right, -1
+// if none does
+int LanderController::Lift_Thruster() const {
+  for (int j = 0; j < 3; j++)
+    if (Thruster_Up(&snap, &est, j)) return j;
+  return -1;
+}
+
+// The phase for this tick: the current one while its exit condition
+// does not hold, else the first whose entry condition does
+int LanderController::Next_Phase() {
+  if (policy != NULL) return PHASE_POLICY;
+
+  double dx = fabs(est.Position_X() - snap.plat_x);
+  double h = snap.plat_y - est.Position_Y();
+  double angle = est.Angle();
+  bool upright = !(angle > 1 && angle < 359);
+
+  // Recovery, for good once a thruster is gone
+  int lift = Lift_Thruster();
+  bool nominal = lift == 0 && Thruster_Up(&snap, &est, 1) && Thruster_Up(&snap, &est, 2);
+  if (!nominal || PHASE_RECOVERY(phase)) {
+    if (phase == PHASE_DROP) return PHASE_DROP;
+    if (lift < 0) return PHASE_BALLISTIC;
+    if (lift == 0) return PHASE_VECTOR;
+    double vx = est.Velocity_X(), vy = est.Velocity_Y();
+    if (phase == PHASE_HOVER) {
+      if (fabs(h - HOVER_H) < DROP_DH && dx < DROP_X && fabs(vx) < DROP_V && fabs(vy) < DROP_V)
+        return PHASE_DROP;
+      if (dx < 2 * HOVER_X) return PHASE_HOVER;
+    }
+    if (dx < HOVER_X && h < HOVER_H + HOVER_X) return PHASE_HOVER;
+    return PHASE_VECTOR;
+  }
+
+  // Blind, the lander cruises only from the ceiling
+  bool blind = est.Faults()->Faulty(FAULT_SONAR);
+  double y = est.Position_Y();
+
+  switch (phase) {
+  case PHASE_STABILIZE:
+    if (!upright) return PHASE_STABILIZE;
+    break;
+  case PHASE_CRUISE:
+    if (upright && dx > params.mid_x && !(blind && y > VEC_CEILING + CLIMB_SLACK)) return PHASE_CRUISE;
+    break;
+  case PHASE_CLIMB:
+    if (upright && dx > params.mid_x && y > VEC_CEILING) return PHASE_CLIMB;
+    break;
+  case PHASE_DESCEND:
+    if (upright && dx <= params.mid_x && h > params.mid_y) return PHASE_DESCEND;
+    break;
+  case PHASE_FINAL:
+    if (upright && dx <= params.mid_x && h <= params.mid_y) return PHASE_FINAL;
+    break;
+  }
+  if (!upright) return PHASE_STABILIZE;
+  if (dx > params.mid_x) return blind && y > VEC_CEILING + CLIMB_SLACK ? PHASE_CLIMB : PHASE_CRUISE;
+  if (h > params.mid_y) return PHASE_DESCEND;
+  return PHASE_FINAL;
+}
+
+// Makes p the phase of this tick and books it on the timeline
+void LanderController::Enter_Phase(int p) {
+  if (p != phase) {
+    int k = timeline.changes++ % PHASE_LOG;
+    timeline.tick[k] = tick;
+    timeline.phase[k] = (unsigned char)p;
+    phase = p;
   }
+  timeline.ticks[p]++;
+  tick++;
+}
+
+// Check for rotation away from zero degrees - Rotate first,
+// use thrusters only when not rotating to avoid adding
+// velocity components along the rotation directions
+// Note that only the latest Rotate() command has any
+// effect, i.e. the rotation angle does not accumulate
+// for successive calls.
+void LanderController::Fly_Stabilize()
+{
+  if (est.Angle()>=180) Rotate(360-est.Angle());
+  else Rotate(-est.Angle());
+}
+
+// The upright phases: steer within the velocity limits
+void LanderController::Fly_Upright(double VXlim, double VYlim)
+{
+  double PLAT_X = snap.plat_x;
+  double xpr = est.Position_X();
+  double xvr = est.Velocity_X();
+  double yvr = est.Velocity_Y();
 
   // Module is oriented properly, check for horizontal position
   // and set thrusters appropriately.
@@ -501,12 +569,134 @@ void Lander_Control(void)
 
   // Vertical adjustments. Basically, keep the module below the limit for
   // vertical velocity and allow for continuous descent. We trust
-  // Safety_Override() to save us from crashing with the ground.
+  // Safety_Check() to save us from crashing with the ground.
   if (yvr<VYlim) Main_Thruster(1.0);
   else Main_Thruster(0);
 }
 
-void Safety_Override(void)
+// The climb phase: brake on the side thrusters and climb at VEC_CLIMB
+void LanderController::Fly_Climb()
+{
+  double xvr = est.Velocity_X();
+  Left_Thruster(xvr < 0 ? fmin(1, -xvr * VEC_GAIN / LT_ACCEL) : 0);
+  Right_Thruster(xvr > 0 ? fmin(1, xvr * VEC_GAIN / RT_ACCEL) : 0);
+  Main_Thruster(est.Velocity_Y() < VEC_CLIMB ? 1.0 : 0);
+}
+
+// Points the lift thruster (0 main, 1 left, 2 right) along the thrust
+// that takes the velocity to (vx_des, vy_des), at most tilt degrees off
+// vertical. The lander turns to point it, with the thruster off while
+// the turn still has more than VEC_ALIGN degrees to go; the other
+// thrusters stay off
+void LanderController::Fly_Vector(int lift, double vx_des, double vy_des, double tilt)
+{
+  static const double accel[3] = {MT_ACCEL, LT_ACCEL, RT_ACCEL};
+  static const double offset[3] = {0, 90, -90};   // Thrust direction from the lander's angle
+
+  double ax = VEC_GAIN * (vx_des - est.Velocity_X());
+  double ay = fmax(G_ACCEL + VEC_GAIN * (vy_des - est.Velocity_Y()), 0);
+  double dir = fmax(-tilt, fmin(tilt, atan2(ax, ay) * RAD2DEG));
+  double power = fmin(1, ay / (accel[lift] * cos(dir * DEG2RAD)));
+  double turn = fmod(dir - offset[lift] - est.Angle() + 720 + 180, 360) - 180;
+  if (fabs(turn) > VEC_ALIGN) power = 0;
+  if (fabs(turn) > .5) Rotate(turn);
+  for (int j = 0; j < 3; j++) {
+    double pw = j == lift ? power : 0;
+    if (j == 0) Main_Thruster(pw);
+    else if (j == 1) Left_Thruster(pw);
+    else Right_Thruster(pw);
+  }
+}
+
+// The recovery phases
+void LanderController::Fly_Recovery()
+{
+  if (phase == PHASE_DROP || phase == PHASE_BALLISTIC)
+  {
+    Main_Thruster(0);
+    Left_Thruster(0);
+    Right_Thruster(0);
+    if (est.Angle() > .5 && est.Angle() < 359.5) Fly_Stabilize();
+    return;
+  }
+
+  int lift = Lift_Thruster();
+  double dx = snap.plat_x - est.Position_X();
+  double h = snap.plat_y - est.Position_Y();
+  double xvr = est.Velocity_X();
+  double yvr = est.Velocity_Y();
+
+  if (phase == PHASE_HOVER)
+  {
+    // Hold over the platform centre at HOVER_H
+    double vx_des = fmax(-DROP_V, fmin(DROP_V, dx / S_SCALE / HOVER_T));
+    double vy_des = fmax(-DROP_V, fmin(DROP_V, (HOVER_H - h) / S_SCALE / HOVER_T));
+    Fly_Vector(lift, vx_des, vy_des, HOVER_TILT);
+    return;
+  }
+
+  // Horizontal speed by distance, as the nominal phases have it
+  double VXlim;
+  if (fabs(dx)>params.far_x) VXlim=params.vx_far;
+  else if (fabs(dx)>params.mid_x) VXlim=params.vx_mid;
+  else VXlim=params.vx_near;
+  double vx_des = fmax(-VXlim, fmin(VXlim, dx / S_SCALE / VEC_T));
+
+  // Cruise at the current height until over the platform area, then
+  // descend by height, down onto the platform on the main thruster or
+  // to the hover height on a side one
+  double VYlim;
+  if (h>params.far_y) VYlim=params.vy_far;
+  else if (h>params.mid_y) VYlim=params.vy_mid;
+  else VYlim=params.vy_near;
+  double vy_des = fabs(dx) > params.mid_x ? 0 : -VYlim;
+  if (lift != 0) vy_des = fmax(vy_des, (HOVER_H - h) / S_SCALE / VEC_T);
+  if (fabs(dx)>HOVER_X && fabs(dx)/fabs(xvr)>params.overshoot*fabs(h)/fabs(yvr)) vy_des = fmax(vy_des, 0);
+
+  // Keep clear of the terrain away from the platform: with terrain ahead
+  // or below, stop and climb (the lander turns too slowly to dodge it)
+  double Vmag = xvr*xvr + yvr*yvr;
+  double DistLimit = fmax(params.dist_floor, Vmag);
+  if (!(fabs(dx)<params.override_box && fabs(h)<params.override_box))
+  {
+    bool ahead = sonar.Nearest(dx > 0 ? SECTOR_RIGHT : SECTOR_LEFT) < DistLimit;
+    bool below = sonar.Nearest(SECTOR_DOWN) < DistLimit;
+    if (ahead) vx_des = 0;
+    if ((ahead || below) && est.Position_Y() > VEC_CEILING) vy_des = fmax(vy_des, VEC_CLIMB);
+  }
+
+  // Land upright enough on the main thruster
+  double tilt = lift == 0 && h <= params.mid_y ? VEC_TILT_LAND : VEC_TILT;
+  Fly_Vector(lift, vx_des, vy_des, tilt);
+}
+
+// Lander_Control() by table lookup: the commands for the current state
+// and working thrusters, rotating first (and coasting meanwhile) when the
+// table wants another attitude, as the solver assumed
+void LanderController::Policy_Control()
+{
+  int combo = Policy_Combo(snap.MT_OK, snap.LT_OK, snap.RT_OK);
+  double angle = est.Angle();
+  PolicyCommand pc;
+  Policy_Lookup(policy, combo, Policy_Attitude(policy, combo, angle),
+                est.Position_X() - snap.plat_x, snap.plat_y - est.Position_Y(),
+                est.Velocity_X(), est.Velocity_Y(), &pc);
+
+  double off = fmod(pc.angle - angle + 540, 360) - 180;
+  if (fabs(off) > 1)
+  {
+    Main_Thruster(0);
+    Left_Thruster(0);
+    Right_Thruster(0);
+    Rotate(off);
+    return;
+  }
+  Main_Thruster(pc.main_pw);
+  Left_Thruster(pc.left_pw);
+  Right_Thruster(pc.right_pw);
+}
+
+void LanderController::Safety_Override()
 {
  /*
    This function is intended to keep the lander from
@@ -529,100 +719,63 @@ void Safety_Override(void)
 
 /**************************************************
   How this works:
-  Check the sonar readings, for each sonar
-  reading that is below a minimum safety threshold
-  AND in the general direction of motion AND
-  not corresponding to the landing platform,
-  carry out speed corrections using the thrusters
+  The recent sonar returns make a small obstacle
+  map around the lander. Fly the lander ahead for
+  a short while under the commands it has been
+  given, and if that brings it too close to the
+  terrain (away from the landing platform), swap
+  them for the thrust that changes them least and
+  keeps it clear (see Lander_Predict.h)
 **************************************************/
 
- double DistLimit;
- double Vmag;
- double dmin;
-
- // Establish distance threshold based on lander
- // speed (we need more time to rectify direction
- // at high speed)
- Vmag=Velocity_X()*Velocity_X();
- Vmag+=Velocity_Y()*Velocity_Y();
+ // Lander_Control() has already made the checks on this tick's
+ // readings, as the last step before it sent its commands, so nothing
+ // it decided is overwritten. Without it the override reads the
+ // sensors and acts on its own. Either way they are used up after this
+ // call.
+ if (snap_fresh)
+ {
+  snap_fresh = false;
+  return;
+ }
+ Read_Sensors();
+ snap_fresh = false;
+ if (!PHASE_RECOVERY(phase) && Safety_Check()) overrides++;
+ Issue();
+}
 
- DistLimit=fmax(75,Vmag);
+// The checks of Safety_Override(), changing this tick's commands.
+// Returns true if they did
+bool LanderController::Safety_Check()
+{
+ PROF_SCOPE(PROF_SAFETY);
+ double PLAT_X = snap.plat_x;
+ double PLAT_Y = snap.plat_y;
 
  // If we're close to the landing platform, disable
  // safety override (close to the landing platform
  // the Control_Policy() should be trusted to
  // safely land the craft)
- if (fabs(PLAT_X-Position_X())<150&&fabs(PLAT_Y-Position_Y())<150) return;
-
- // Determine the closest surfaces in the direction
- // of motion. This is done by checking the sonar
- // array in the quadrant corresponding to the
- // ship's motion direction to find the entry
- // with the smallest registered distance
-
- // Horizontal direction.
- dmin=1000000;
- if (Velocity_X()>0)
- {
-  for (int i=5;i<14;i++)
-   if (SONAR_DIST[i]>-1&&SONAR_DIST[i]<dmin) dmin=SONAR_DIST[i];
- }
- else
- {
-  for (int i=22;i<32;i++)
-   if (SONAR_DIST[i]>-1&&SONAR_DIST[i]<dmin) dmin=SONAR_DIST[i];
- }
- // Determine whether we're too close for comfort. There is a reason
- // to have this distance limit modulated by horizontal speed...
- // what is it?
- if (dmin<DistLimit*fmax(.25,fmin(fabs(Velocity_X())/5.0,1)))
- { // Too close to a surface in the horizontal direction
-  if (Angle()>1&&Angle()<359)
-  {
-   if (Angle()>=180) Rotate(360-Angle());
-   else Rotate(-Angle());
-   return;
-  }
-
-  if (Velocity_X()>0){
-   Right_Thruster(1.0);
-   Left_Thruster(0.0);
-  }
-  else
-  {
-   Left_Thruster(1.0);
-   Right_Thruster(0.0);
-  }
- }
-
- // Vertical direction
- dmin=1000000;
- if (Velocity_Y()>5)      // Mind this! there is a reason for it...
- {
-  for (int i=0; i<5; i++)
-   if (SONAR_DIST[i]>-1&&SONAR_DIST[i]<dmin) dmin=SONAR_DIST[i];
-  for (int i=32; i<36; i++)
-   if (SONAR_DIST[i]>-1&&SONAR_DIST[i]<dmin) dmin=SONAR_DIST[i];
- }
- else
- {
-  for (int i=14; i<22; i++)
-   if (SONAR_DIST[i]>-1&&SONAR_DIST[i]<dmin) dmin=SONAR_DIST[i];
- }
- if (dmin<DistLimit)   // Too close to a surface in the horizontal direction
- {
-  if (Angle()>1||Angle()>359)
-  {
-   if (Angle()>=180) Rotate(360-Angle());
-   else Rotate(-Angle());
-   return;
-  }
-  if (Velocity_Y()>2.0){
-   Main_Thruster(0.0);
-  }
-  else
-  {
-   Main_Thruster(1.0);
-  }
- }
+ if (fabs(PLAT_X-est.Position_X())<params.override_box&&fabs(PLAT_Y-est.Position_Y())<params.override_box) return false;
+
+ // The commands in effect once this tick's are sent
+ double now[3];
+ now[0] = pending.set[0] ? pending.pw[0] : cmd.main_pw;
+ now[1] = pending.set[1] ? pending.pw[1] : cmd.left_pw;
+ now[2] = pending.set[2] ? pending.pw[2] : cmd.right_pw;
+
+ PredictState st;
+ st.px = est.Position_X();
+ st.py = est.Position_Y();
+ st.vx = est.Velocity_X();
+ st.vy = est.Velocity_Y();
+ st.angle = est.Angle();
+ for (int j = 0; j < 3; j++) st.ok[j] = Thruster_Up(&snap, &est, j);
+
+ double pw[3];
+ if (!pred.Choose(&st, now, params.pred_horizon, params.pred_clear, pw)) return false;
+ Main_Thruster(pw[0]);
+ Left_Thruster(pw[1]);
+ Right_Thruster(pw[2]);
+ return true;
 }
@@ -0,0 +1,305 @@
+/*
+	Monte Carlo landing harness.
+
+	Flies N randomized landings for every (map, failure configuration)
+	pair on a pool of worker threads and reports success rate,
+	touchdown vertical speed, touchdown angle and time to land, each
+	with a 95% confidence interval.
+
+	Usage: Lander_Batch [-n N] [-j threads] [-s seed] [-t max_time] [-c config] ... [-d dir] [-p policy] [-P params] [-a] map1.ppm [map2.ppm ...]
+
+	A failure configuration is a failure mode, optionally followed by a
+	mode 3 component list: "0", "2", "3:4" or "3:1,5,8". -c may be given
+	several times. By default modes 0, 1 and 2 plus mode 3 with each
+	single component 1-9 are flown.
+
+	Episode k of every cell uses seed+k, so all configurations see the
+	same initial states and noise draws (common random numbers), which
+	makes comparisons between cells and between builds much tighter.
+
+	With -d every episode runs the flight recorder, and each crash
+	leaves a trace in dir named after its map, configuration and seed,
+	e.g. hard_3-1,5_1042.ltr (see Lander_Recorder.h).
+
+	With -p every controller flies by the given policy table (see
+	Lander_Policy.h, Lander_MkPolicy builds one) instead of the
+	hand-coded velocity limits. The table is mapped once and shared.
+
+	With -P every controller flies with the gains in the given parameter
+	file (see Lander_Params.h) instead of the defaults.
+
+	With -a the simulation locates each touchdown within its step
+	instead of at the end of it, and skips contact tests while the
+	terrain is out of reach (see Sim_Set_Exact_Contact).
+
+	After the table come how often the safety override stepped in: the
+	share of ticks it changed the commands on, the runs of such ticks
+	(interventions) per flight, and the true clearance from the terrain
+	when they began (higher is earlier). Then a fault detection summary
+	counts the components that failed, how many ticks the flight
+	computer took to isolate them (mean, and the worst case for each
+	component), the failures it never isolated before the episode
+	ended, and false alarms: components isolated while they still
+	worked, whether or not they failed later (see Lander_Fault.h).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "Lander_Episode.h"
+
+#define MAX_CONFIGS 64
+#define MAX_MAPS 8
+
+// Running mean and variance (Welford)
+struct RunningStat {
+  long n;
+  double mean, m2;
+};
+
+static void Stat_Add(RunningStat *s, double v) {
+  s->n++;
+  double d = v - s->mean;
+  s->mean += d / s->n;
+  s->m2 += d * (v - s->mean);
+}
+
+// Half width of the 95% confidence interval of the mean
+static double Stat_CI(const RunningStat *s) {
+  if (s->n < 2) return 0;
+  return 1.96 * sqrt(s->m2 / (s->n - 1) / s->n);
+}
+
+static void Stat_Print(char *buf, size_t len, const RunningStat *s) {
+  if (s->n == 0) snprintf(buf, len, "-");
+  else snprintf(buf, len, "%.2f +- %.2f", s->mean, Stat_CI(s));
+}
+
+// 95% Wilson score interval for a success proportion
+static void Wilson(long k, long n, double *lo, double *hi) {
+  if (n == 0) {
+    *lo = *hi = 0;
+    return;
+  }
+  double z = 1.96;
+  double p = (double)k / n;
+  double den = 1 + z * z / n;
+  double c = (p + z * z / (2 * n)) / den;
+  double h = z * sqrt(p * (1 - p) / n + z * z / (4.0 * n * n)) / den;
+  *lo = c - h > 0 ? c - h : 0;
+  *hi = c + h < 1 ? c + h : 1;
+}
+
+// Trace file for one episode: dir/<map>_<config>_<seed>.ltr, with the
+// map's directory and extension dropped and ':' in the config made '-'
+static void Trace_Name(char *buf, size_t len, const char *dir, const char *map_name,
+                       const char *config, long seed) {
+  const char *base = strrchr(map_name, '/');
+  base = base != NULL ? base + 1 : map_name;
+  const char *ext = strrchr(base, '.');
+  int nbase = ext != NULL ? (int)(ext - base) : (int)strlen(base);
+  char cfg[32];
+  snprintf(cfg, sizeof(cfg), "%s", config);
+  for (char *c = cfg; *c; c++)
+    if (*c == ':') *c = '-';
+  snprintf(buf, len, "%s/%.*s_%s_%ld.ltr", dir, nbase, base, cfg, seed);
+}
+
+static void Usage(void) {
+  fprintf(stderr, "Usage: Lander_Batch [-n N] [-j threads] [-s seed] [-t max_time] [-c config] ... [-d dir] [-p policy] [-P params] [-a] map1.ppm [map2.ppm ...]\n");
+  fprintf(stderr, "  config is a failure mode with an optional mode 3 component list, e.g. 2 or 3:1,5,8\n");
+}
+
+int main(int argc, char *argv[]) {
+  long n = 100;
+  int nthreads = (int)std::thread::hardware_concurrency();
+  long seed = 1;
+  double max_time = 300;
+  FailConfig configs[MAX_CONFIGS];
+  int nconfigs = 0;
+  const char *trace_dir = NULL;
+  const char *policy_name = NULL;
+  const char *params_name = NULL;
+  int exact_contact = 0;
+
+  int a = 1;
+  while (a < argc && argv[a][0] == '-') {
+    long threads = nthreads;
+    int ok = 1;
+    if (!strcmp(argv[a], "-n") && a + 1 < argc) ok = Parse_Long(argv[++a], &n);
+    else if (!strcmp(argv[a], "-j") && a + 1 < argc) ok = Parse_Long(argv[++a], &threads);
+    else if (!strcmp(argv[a], "-s") && a + 1 < argc) ok = Parse_Long(argv[++a], &seed);
+    else if (!strcmp(argv[a], "-t") && a + 1 < argc) ok = Parse_Double(argv[++a], &max_time);
+    else if (!strcmp(argv[a], "-d") && a + 1 < argc) trace_dir = argv[++a];
+    else if (!strcmp(argv[a], "-p") && a + 1 < argc) policy_name = argv[++a];
+    else if (!strcmp(argv[a], "-P") && a + 1 < argc) params_name = argv[++a];
+    else if (!strcmp(argv[a], "-a")) exact_contact = 1;
+    else if (!strcmp(argv[a], "-c") && a + 1 < argc && nconfigs < MAX_CONFIGS) {
+      if (!Parse_Config(argv[++a], &configs[nconfigs++])) {
+        fprintf(stderr, "Bad failure configuration %s\n", argv[a]);
+        return 1;
+      }
+    }
+    else {
+      Usage();
+      return 1;
+    }
+    if (!ok) {
+      fprintf(stderr, "Bad value %s for %s\n", argv[a], argv[a - 1]);
+      return 1;
+    }
+    nthreads = (int)threads;
+    a++;
+  }
+  if (a >= argc || n < 1) {
+    Usage();
+    return 1;
+  }
+  if (nthreads < 1) nthreads = 1;
+
+  if (nconfigs == 0) {
+    const char *defaults[] = {"0", "1", "2", "3:1", "3:2", "3:3", "3:4", "3:5", "3:6", "3:7", "3:8", "3:9"};
+    for (int i = 0; i < 12; i++) Parse_Config(defaults[i], &configs[nconfigs++]);
+  }
+
+  static LanderMap maps[MAX_MAPS];
+  const char *map_names[MAX_MAPS];
+  int nmaps = 0;
+  for (; a < argc && nmaps < MAX_MAPS; a++) {
+    if (!Sim_Load_Map(argv[a], &maps[nmaps])) return 1;
+    map_names[nmaps++] = argv[a];
+  }
+  static LanderShape shape;
+  if (!Sim_Load_Shape("lander.ppm", &shape)) {
+    fprintf(stderr, "Unable to load lander image. Ensure it is in the same directory\n");
+    return 1;
+  }
+  static LanderPolicy policy;
+  if (policy_name != NULL && !Policy_Map(policy_name, &policy)) return 1;
+  static ControllerParams params;
+  Params_Default(&params);
+  if (params_name != NULL && !Params_Load(params_name, &params)) return 1;
+
+  // One job per episode, cells are (map, config) pairs
+  long ncells = (long)nmaps * nconfigs;
+  long njobs = ncells * n;
+  std::vector<EpisodeResult> results(njobs);
+  std::atomic<long> next(0);
+
+  struct timespec t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+
+  std::vector<std::thread> workers;
+  for (int t = 0; t < nthreads; t++) {
+    workers.push_back(std::thread([&]() {
+      long j;
+      while ((j = next.fetch_add(1)) < njobs) {
+        long cell = j / n;
+        const FailConfig *cfg = &configs[cell % nconfigs];
+        Scenario sc;
+        sc.map = &maps[cell / nconfigs];
+        sc.shape = &shape;
+        sc.fail_mode = cfg->mode;
+        memcpy(sc.comps, cfg->comps, sizeof(sc.comps));
+        sc.ncomps = cfg->ncomps;
+        sc.seed = seed + j % n;
+        sc.max_time = max_time;
+        sc.map_name = map_names[cell / nconfigs];
+        sc.trace_name = NULL;
+        sc.policy = policy_name != NULL ? &policy : NULL;
+        sc.params = &params;
+        sc.exact_contact = exact_contact;
+        sc.plan = NULL;
+        sc.time_control = 0;
+        char trace_name[1024];
+        if (trace_dir != NULL) {
+          Trace_Name(trace_name, sizeof(trace_name), trace_dir, sc.map_name, cfg->name, sc.seed);
+          sc.trace_name = trace_name;
+        }
+        Run_Episode(&sc, &results[j]);
+      }
+    }));
+  }
+  for (size_t t = 0; t < workers.size(); t++) workers[t].join();
+  Recorder_Wait();
+
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  double wall = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+
+  printf("%-10s %-10s %7s  %-22s %-16s %-16s %-16s\n", "map", "config", "n",
+         "success [95% CI]", "|vy| at td", "angle at td", "time to land");
+  long total_ticks = 0;
+  long total_reads[N_SENS] = {0};
+  long total_tests = 0;
+  long total_overrides = 0, total_interventions = 0;
+  double total_clear = 0;
+  long n_failed = 0, n_missed = 0, n_false = 0;
+  RunningStat latency = {0, 0, 0};
+  long worst[N_COMP];
+  for (int i = 0; i < N_COMP; i++) worst[i] = -1;
+  for (long cell = 0; cell < ncells; cell++) {
+    RunningStat vy = {0, 0, 0}, ang = {0, 0, 0}, tl = {0, 0, 0};
+    long landed = 0;
+    for (long k = 0; k < n; k++) {
+      const EpisodeResult *r = &results[cell * n + k];
+      total_ticks += r->ticks;
+      total_tests += r->contact_tests;
+      total_overrides += r->overrides;
+      total_interventions += r->interventions;
+      total_clear += r->intervention_clear;
+      for (int i = 0; i < N_SENS; i++) total_reads[i] += r->reads[i];
+      for (int i = 1; i < N_COMP; i++) {
+        long f = r->fail_tick[i], d = r->found_tick[i];
+        if (d >= 0 && (f < 0 || d < f)) n_false++;
+        if (f < 0) continue;
+        n_failed++;
+        if (d < 0) n_missed++;
+        if (d < f) continue;
+        Stat_Add(&latency, d - f);
+        if (d - f > worst[i]) worst[i] = d - f;
+      }
+      if (r->status != SIM_LANDED) continue;
+      landed++;
+      Stat_Add(&vy, fabs(r->td_vy));
+      Stat_Add(&ang, fabs(r->td_angle));
+      Stat_Add(&tl, r->time);
+    }
+    double lo, hi;
+    Wilson(landed, n, &lo, &hi);
+    char succ[32], s_vy[32], s_ang[32], s_tl[32];
+    snprintf(succ, sizeof(succ), "%.3f [%.3f,%.3f]", (double)landed / n, lo, hi);
+    Stat_Print(s_vy, sizeof(s_vy), &vy);
+    Stat_Print(s_ang, sizeof(s_ang), &ang);
+    Stat_Print(s_tl, sizeof(s_tl), &tl);
+    printf("%-10s %-10s %7ld  %-22s %-16s %-16s %-16s\n", map_names[cell / nconfigs],
+           configs[cell % nconfigs].name, n, succ, s_vy, s_ang, s_tl);
+  }
+  printf("%ld episodes, %ld ticks on %d threads in %.2fs (%.0f episodes/s)\n",
+         njobs, total_ticks, nthreads, wall, njobs / wall);
+  printf("sensor reads/tick:");
+  for (int i = 0; i < N_SENS; i++)
+    printf(" %s=%.2f", Sim_Sensor_Name(i), (double)total_reads[i] / total_ticks);
+  printf("\n");
+  printf("contact tests/tick: %.3f\n", (double)total_tests / total_ticks);
+  printf("safety override: %.2f%% of ticks, %.2f interventions per flight, %.1f px from the terrain at the start\n",
+         100.0 * total_overrides / total_ticks, (double)total_interventions / njobs,
+         total_interventions > 0 ? total_clear / total_interventions : 0);
+  printf("fault detection: %ld failures, %ld isolated in %.2f ticks on average, %ld missed, %ld false alarms\n",
+         n_failed, latency.n, latency.mean, n_missed, n_false);
+  printf("worst isolation latency (ticks):");
+  for (int i = 1; i < N_COMP; i++) {
+    if (worst[i] >= 0) printf(" %d=%ld", i, worst[i]);
+    else printf(" %d=-", i);
+  }
+  printf("\n");
+
+  for (int i = 0; i < nmaps; i++) Sim_Free_Map(&maps[i]);
+  return 0;
+}
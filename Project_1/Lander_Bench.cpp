@@ -0,0 +1,439 @@
+/*
+	Regression benchmark over a fixed corpus of landings.
+
+	The corpus (bench.corpus) is a text file of seeded landings, one per
+	line: the map, the failure mode the landing stands for, the seed of
+	its sensor and actuator noise, its initial state and its failure
+	schedule,
+
+	  # map      mode  seed   x        y        vx       vy       theta    failures
+	  easy.ppm   2     2031   512.334  71.208   -3.2047  -8.1032  2.41703  1@2.3514,6@6.1021
+
+	(failures is "-" for none, otherwise component@seconds, components
+	numbered as on the command line). Every landing is flown headless
+	with Sim_Set_Plan(), so all builds fly exactly the same landings.
+
+	Usage: Lander_Bench [-o out.json] [-b baseline.json] [-t max_time] [-P params] corpus
+	       Lander_Bench -g N [-s seed] map1.ppm [map2.ppm ...] > corpus
+
+	Results are grouped by map and mode, plus all landings together, and
+	written as JSON (to stdout, or to -o): landings and success rate,
+	and over the landings that landed the mean thrust used (seconds at
+	full power, all thrusters), time to land, touchdown speed and
+	touchdown angle, and for every landing the mean time the controller
+	took per tick. Landings run one at a time on one thread so the
+	timing is comparable between runs; it includes two clock reads per
+	tick, and unlike the rest it depends on the machine.
+
+	With -b the results are compared with a baseline written by an
+	earlier run, and a before -> after table is printed (to stdout, or
+	to stderr when the JSON goes to stdout). make bench runs the corpus
+	against bench_baseline.json, make bench-baseline makes the current
+	build the baseline.
+
+	-g writes a corpus of N landings per map and mode 0, 1 and 2. The
+	initial states and failure times are the ones Sim_Reset() draws for
+	the seed, the failed components are drawn as modes 1 (thrusters)
+	and 2 (any but the sonar) do, two per landing.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <vector>
+
+#include "Lander_Episode.h"
+
+#define MAX_MAPS 8
+#define MAX_GROUPS 64
+#define MAX_LINE 1024
+#define DIFF_CELL (2 * 32 + 5)  // Two 32 byte values and " -> "
+
+struct CorpusEntry {
+  int map;
+  int mode;
+  long seed;
+  FlightPlan plan;
+};
+
+// Results of one group of landings
+struct BenchGroup {
+  char map[64];
+  int mode;               // -1 for all modes
+  long n, landed;
+  double thrust_s, time, td_speed, td_angle; // Means over the landings that landed
+  double ns_tick;         // Controller time per tick
+  long ticks;
+};
+
+/*
+  Corpus
+*/
+
+// Parses "1@2.35,6@6.1" or "-" into a schedule, returns 0 if malformed
+static int Parse_Failures(const char *spec, double *fail_time) {
+  for (int i = 0; i < N_COMP; i++) fail_time[i] = 0;
+  if (!strcmp(spec, "-")) return 1;
+  const char *p = spec;
+  while (*p) {
+    char *end;
+    int c = (int)strtol(p, &end, 10);
+    if (end == p || *end != '@' || c < 1 || c >= N_COMP) return 0;
+    p = end + 1;
+    double t = strtod(p, &end);
+    if (end == p || t <= 0) return 0;
+    if (*end != ',' && *end != '\0') return 0;
+    fail_time[c] = t;
+    p = (*end == ',') ? end + 1 : end;
+  }
+  return 1;
+}
+
+// Reads a corpus, loading each map it names once. Returns 0 on failure
+static int Read_Corpus(const char *fname, std::vector<CorpusEntry> *corpus,
+                       LanderMap *maps, char (*map_names)[64], int *nmaps) {
+  FILE *f = fopen(fname, "r");
+  if (f == NULL) {
+    fprintf(stderr, "Unable to open corpus %s\n", fname);
+    return 0;
+  }
+  char line[MAX_LINE];
+  int lineno = 0;
+  while (fgets(line, sizeof(line), f)) {
+    lineno++;
+    if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0') continue;
+    CorpusEntry e;
+    char map[64], failures[256];
+    if (sscanf(line, "%63s %d %ld %lf %lf %lf %lf %lf %255s", map, &e.mode, &e.seed, &e.plan.x, &e.plan.y,
+               &e.plan.vx, &e.plan.vy, &e.plan.theta, failures) != 9 ||
+        !Parse_Failures(failures, e.plan.fail_time)) {
+      fprintf(stderr, "%s:%d: malformed landing\n", fname, lineno);
+      fclose(f);
+      return 0;
+    }
+    e.map = -1;
+    for (int i = 0; i < *nmaps; i++)
+      if (!strcmp(map_names[i], map)) e.map = i;
+    if (e.map < 0) {
+      if (*nmaps == MAX_MAPS) {
+        fprintf(stderr, "%s:%d: more than %d maps\n", fname, lineno, MAX_MAPS);
+        fclose(f);
+        return 0;
+      }
+      if (!Sim_Load_Map(map, &maps[*nmaps])) {
+        fclose(f);
+        return 0;
+      }
+      snprintf(map_names[*nmaps], 64, "%s", map);
+      e.map = (*nmaps)++;
+    }
+    corpus->push_back(e);
+  }
+  fclose(f);
+  if (corpus->empty()) {
+    fprintf(stderr, "Corpus %s is empty\n", fname);
+    return 0;
+  }
+  return 1;
+}
+
+// Small deterministic generator for the failed components, the corpus
+// must not depend on libc
+static double Gen_Rand(unsigned long long *state) {
+  *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+  return (double)(*state >> 11) / 9007199254740992.0;
+}
+
+static int Generate(long n, long seed, int argc, char **argv) {
+  static LanderShape shape;
+  if (!Sim_Load_Shape("lander.ppm", &shape)) {
+    fprintf(stderr, "Unable to load lander image. Ensure it is in the same directory\n");
+    return 1;
+  }
+  printf("# map      mode  seed   x        y        vx       vy       theta    failures\n");
+  for (int a = 0; a < argc; a++) {
+    static LanderMap map;
+    if (!Sim_Load_Map(argv[a], &map)) return 1;
+    for (int mode = 0; mode <= 2; mode++) {
+      for (long k = 0; k < n; k++) {
+        long s = seed + (a * 3 + mode) * n + k;
+        static LanderSim sim;
+        Sim_Reset(&sim, &map, &shape, mode, NULL, 0, s);
+        unsigned long long state = (unsigned long long)s * 2654435761ULL + 1;
+
+        // Failures at the two times Sim_Reset() drew, as the mode picks
+        // them. A component drawn twice fails at the first time
+        char failures[256] = "-";
+        double fail_time[N_COMP] = {0};
+        if (mode > 0) {
+          double t[2] = {sim.fail_t1, sim.fail_t2};
+          for (int i = 0; i < 2; i++) {
+            int c;
+            if (mode == 1) {
+              double r = Gen_Rand(&state);
+              c = r < .5 ? COMP_MAIN : (r < .75 ? COMP_LEFT : COMP_RIGHT);
+            }
+            else c = 1 + (int)(Gen_Rand(&state) * 8);
+            if (fail_time[c] == 0 || t[i] < fail_time[c]) fail_time[c] = t[i];
+          }
+          failures[0] = '\0';
+          for (int c = 1; c < N_COMP; c++) {
+            if (fail_time[c] == 0) continue;
+            size_t at = strlen(failures);
+            snprintf(failures + at, sizeof(failures) - at, at > 0 ? ",%d@%.4f" : "%d@%.4f", c, fail_time[c]);
+          }
+        }
+        printf("%-10s %-5d %-6ld %-8.3f %-8.3f %-8.4f %-8.4f %-8.5f %s\n", argv[a], mode, s,
+               sim.x, sim.y, sim.vx, sim.vy, sim.theta, failures);
+      }
+    }
+    Sim_Free_Map(&map);
+  }
+  return 0;
+}
+
+/*
+  Results
+*/
+
+static void Group_Finish(BenchGroup *g) {
+  if (g->landed > 0) {
+    g->thrust_s /= g->landed;
+    g->time /= g->landed;
+    g->td_speed /= g->landed;
+    g->td_angle /= g->landed;
+  }
+  g->ns_tick = g->ticks > 0 ? g->ns_tick / g->ticks : 0;
+}
+
+static void Group_Add(BenchGroup *g, const EpisodeResult *r) {
+  g->n++;
+  g->ticks += r->ticks;
+  g->ns_tick += r->control_ns;
+  if (r->status != SIM_LANDED) return;
+  g->landed++;
+  g->thrust_s += r->thrust_s;
+  g->time += r->time;
+  g->td_speed += sqrt(r->td_vx * r->td_vx + r->td_vy * r->td_vy);
+  g->td_angle += fabs(r->td_angle);
+}
+
+// Means of a group without landings are written as null
+static void Json_Number(FILE *f, const char *key, double v, int valid) {
+  if (valid) fprintf(f, ", \"%s\": %.4f", key, v);
+  else fprintf(f, ", \"%s\": null", key);
+}
+
+static void Write_Json(FILE *f, const char *corpus, const BenchGroup *groups, int ngroups) {
+  fprintf(f, "{\n  \"corpus\": \"%s\",\n  \"groups\": [\n", corpus);
+  for (int i = 0; i < ngroups; i++) {
+    const BenchGroup *g = &groups[i];
+    fprintf(f, "    {\"map\": \"%s\", \"mode\": %d, \"landings\": %ld, \"landed\": %ld", g->map, g->mode, g->n, g->landed);
+    Json_Number(f, "success", (double)g->landed / g->n, 1);
+    Json_Number(f, "thrust_s", g->thrust_s, g->landed > 0);
+    Json_Number(f, "time_to_land", g->time, g->landed > 0);
+    Json_Number(f, "td_speed", g->td_speed, g->landed > 0);
+    Json_Number(f, "td_angle", g->td_angle, g->landed > 0);
+    Json_Number(f, "ns_per_tick", g->ns_tick, 1);
+    fprintf(f, "}%s\n", i + 1 < ngroups ? "," : "");
+  }
+  fprintf(f, "  ]\n}\n");
+}
+
+// Value of a key on a line of Write_Json() output, NAN for null or
+// missing
+static double Json_Field(const char *line, const char *key) {
+  char pat[64];
+  snprintf(pat, sizeof(pat), "\"%s\": ", key);
+  const char *p = strstr(line, pat);
+  if (p == NULL) return NAN;
+  p += strlen(pat);
+  if (!strncmp(p, "null", 4)) return NAN;
+  return strtod(p, NULL);
+}
+
+// Reads the groups of a baseline written by Write_Json(), returns the
+// number read, -1 if the file cannot be opened
+static int Read_Json(const char *fname, BenchGroup *groups, int max) {
+  FILE *f = fopen(fname, "r");
+  if (f == NULL) return -1;
+  char line[MAX_LINE];
+  int n = 0;
+  while (n < max && fgets(line, sizeof(line), f)) {
+    const char *p = strstr(line, "{\"map\": \"");
+    if (p == NULL) continue;
+    BenchGroup *g = &groups[n++];
+    memset(g, 0, sizeof(BenchGroup));
+    p += strlen("{\"map\": \"");
+    size_t len = strcspn(p, "\"");
+    snprintf(g->map, sizeof(g->map), "%.*s", (int)len, p);
+    g->mode = (int)Json_Field(line, "mode");
+    g->n = (long)Json_Field(line, "landings");
+    g->landed = (long)Json_Field(line, "landed");
+    g->thrust_s = Json_Field(line, "thrust_s");
+    g->time = Json_Field(line, "time_to_land");
+    g->td_speed = Json_Field(line, "td_speed");
+    g->td_angle = Json_Field(line, "td_angle");
+    g->ns_tick = Json_Field(line, "ns_per_tick");
+  }
+  fclose(f);
+  return n;
+}
+
+// "1.234 -> 1.250" for one metric, with - for a missing value
+static void Diff_Cell(char *buf, size_t len, double before, double after, int prec) {
+  char b[32], a[32];
+  if (isnan(before)) snprintf(b, sizeof(b), "-");
+  else snprintf(b, sizeof(b), "%.*f", prec, before);
+  if (isnan(after)) snprintf(a, sizeof(a), "-");
+  else snprintf(a, sizeof(a), "%.*f", prec, after);
+  snprintf(buf, len, "%s -> %s", b, a);
+}
+
+static void Print_Diff(FILE *f, const BenchGroup *base, int nbase, const BenchGroup *groups, int ngroups) {
+  fprintf(f, "%-14s %-16s %-16s %-16s %-16s %-16s %-16s\n", "group", "success", "thrust-s",
+          "time to land", "td speed", "td angle", "ns/tick");
+  for (int i = 0; i < ngroups; i++) {
+    const BenchGroup *g = &groups[i];
+    const BenchGroup *b = NULL;
+    for (int j = 0; j < nbase; j++)
+      if (!strcmp(base[j].map, g->map) && base[j].mode == g->mode) b = &base[j];
+    char name[80];
+    if (g->mode < 0) snprintf(name, sizeof(name), "%.*s", (int)sizeof(g->map) - 1, g->map);
+    else snprintf(name, sizeof(name), "%.*s/%d", (int)sizeof(g->map) - 1, g->map, g->mode);
+    if (b == NULL) {
+      fprintf(f, "%-14s not in the baseline\n", name);
+      continue;
+    }
+    int landed = g->landed > 0;
+    char cells[6][DIFF_CELL];
+    Diff_Cell(cells[0], DIFF_CELL, b->n > 0 ? (double)b->landed / b->n : NAN, (double)g->landed / g->n, 3);
+    Diff_Cell(cells[1], DIFF_CELL, b->thrust_s, landed ? g->thrust_s : NAN, 2);
+    Diff_Cell(cells[2], DIFF_CELL, b->time, landed ? g->time : NAN, 2);
+    Diff_Cell(cells[3], DIFF_CELL, b->td_speed, landed ? g->td_speed : NAN, 2);
+    Diff_Cell(cells[4], DIFF_CELL, b->td_angle, landed ? g->td_angle : NAN, 2);
+    Diff_Cell(cells[5], DIFF_CELL, b->ns_tick, g->ns_tick, 0);
+    fprintf(f, "%-14s %-16s %-16s %-16s %-16s %-16s %-16s\n", name, cells[0], cells[1], cells[2],
+            cells[3], cells[4], cells[5]);
+  }
+}
+
+static void Usage(void) {
+  fprintf(stderr, "Usage: Lander_Bench [-o out.json] [-b baseline.json] [-t max_time] [-P params] corpus\n");
+  fprintf(stderr, "       Lander_Bench -g N [-s seed] map1.ppm [map2.ppm ...] > corpus\n");
+}
+
+int main(int argc, char *argv[]) {
+  const char *out_name = NULL;
+  const char *base_name = NULL;
+  const char *params_name = NULL;
+  double max_time = 300;
+  long gen = 0;
+  long seed = 1;
+
+  int a = 1;
+  while (a < argc && argv[a][0] == '-') {
+    if (!strcmp(argv[a], "-o") && a + 1 < argc) out_name = argv[++a];
+    else if (!strcmp(argv[a], "-b") && a + 1 < argc) base_name = argv[++a];
+    else if (!strcmp(argv[a], "-t") && a + 1 < argc) max_time = atof(argv[++a]);
+    else if (!strcmp(argv[a], "-P") && a + 1 < argc) params_name = argv[++a];
+    else if (!strcmp(argv[a], "-g") && a + 1 < argc) gen = strtol(argv[++a], NULL, 10);
+    else if (!strcmp(argv[a], "-s") && a + 1 < argc) seed = strtol(argv[++a], NULL, 10);
+    else {
+      Usage();
+      return 1;
+    }
+    a++;
+  }
+  if (a >= argc) {
+    Usage();
+    return 1;
+  }
+  if (gen > 0) return Generate(gen, seed, argc - a, argv + a);
+  if (a + 1 != argc) {
+    Usage();
+    return 1;
+  }
+  const char *corpus_name = argv[a];
+
+  static LanderMap maps[MAX_MAPS];
+  static char map_names[MAX_MAPS][64];
+  int nmaps = 0;
+  std::vector<CorpusEntry> corpus;
+  if (!Read_Corpus(corpus_name, &corpus, maps, map_names, &nmaps)) return 1;
+  static LanderShape shape;
+  if (!Sim_Load_Shape("lander.ppm", &shape)) {
+    fprintf(stderr, "Unable to load lander image. Ensure it is in the same directory\n");
+    return 1;
+  }
+  static ControllerParams params;
+  Params_Default(&params);
+  if (params_name != NULL && !Params_Load(params_name, &params)) return 1;
+
+  // Groups in the order they first appear, then all landings
+  static BenchGroup groups[MAX_GROUPS + 1];
+  int ngroups = 0;
+  std::vector<int> group_of(corpus.size());
+  for (size_t i = 0; i < corpus.size(); i++) {
+    int g = -1;
+    for (int j = 0; j < ngroups; j++)
+      if (!strcmp(groups[j].map, map_names[corpus[i].map]) && groups[j].mode == corpus[i].mode) g = j;
+    if (g < 0) {
+      if (ngroups == MAX_GROUPS) {
+        fprintf(stderr, "More than %d map and mode groups in %s\n", MAX_GROUPS, corpus_name);
+        return 1;
+      }
+      g = ngroups++;
+      snprintf(groups[g].map, sizeof(groups[g].map), "%s", map_names[corpus[i].map]);
+      groups[g].mode = corpus[i].mode;
+    }
+    group_of[i] = g;
+  }
+  BenchGroup *all = &groups[ngroups];
+  snprintf(all->map, sizeof(all->map), "all");
+  all->mode = -1;
+
+  for (size_t i = 0; i < corpus.size(); i++) {
+    const CorpusEntry *e = &corpus[i];
+    Scenario sc;
+    sc.map = &maps[e->map];
+    sc.shape = &shape;
+    sc.fail_mode = 0;
+    sc.ncomps = 0;
+    sc.seed = e->seed;
+    sc.max_time = max_time;
+    sc.map_name = map_names[e->map];
+    sc.trace_name = NULL;
+    sc.policy = NULL;
+    sc.params = &params;
+    sc.exact_contact = 0;
+    sc.plan = &e->plan;
+    sc.time_control = 1;
+    EpisodeResult r;
+    Run_Episode(&sc, &r);
+    Group_Add(&groups[group_of[i]], &r);
+    Group_Add(all, &r);
+  }
+  for (int i = 0; i <= ngroups; i++) Group_Finish(&groups[i]);
+
+  FILE *out = stdout;
+  if (out_name != NULL && (out = fopen(out_name, "w")) == NULL) {
+    fprintf(stderr, "Unable to write %s\n", out_name);
+    return 1;
+  }
+  Write_Json(out, corpus_name, groups, ngroups + 1);
+  if (out != stdout) fclose(out);
+
+  if (base_name != NULL) {
+    static BenchGroup base[MAX_GROUPS + 1];
+    int nbase = Read_Json(base_name, base, MAX_GROUPS + 1);
+    FILE *f = out == stdout ? stderr : stdout;
+    if (nbase < 0) fprintf(f, "No baseline %s to compare with\n", base_name);
+    else Print_Diff(f, base, nbase, groups, ngroups + 1);
+  }
+
+  for (int i = 0; i < nmaps; i++) Sim_Free_Map(&maps[i]);
+  return 0;
+}
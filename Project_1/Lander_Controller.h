@@ -0,0 +1,173 @@
+/*
+	The flight computer as an object.
+
+	LanderController holds everything Lander_Control() and
+	Safety_Override() know about a flight (estimator, sonar stage,
+	collision predictor, phase and commands), so any number of landers
+	can be flown in one process. It reaches the lander only through a
+	LanderIO: the sensors, the flight controls and the flight computer
+	variables of Lander_Control.h, one virtual call each.
+
+	A LanderIO is called from the controller's thread only: sensors as
+	the controller reads them, and each flight control at most once per
+	tick, when Lander_Control() finishes (or a Safety_Override() called
+	without it).
+
+	Lander_Default.cpp forwards to the globals of the interactive
+	program; Lander_Sim (SimIO), the IO logs (RecordIO, ReplayIO) and
+	Lander_MicroBench supply others.
+*/
+
+#ifndef _LANDER_CONTROLLER_H
+#define _LANDER_CONTROLLER_H
+
+#include "Lander_Control.h"
+#include "Lander_Estimator.h"
+#include "Lander_Sonar.h"
+#include "Lander_Policy.h"
+#include "Lander_Params.h"
+#include "Lander_Phase.h"
+#include "Lander_Predict.h"
+
+// Sensor and actuator interface seen by one controller instance. The
+// methods mirror the flight controls, sensors and global variables in
+// Lander_Control.h so the control code reads the same either way.
+class LanderIO {
+ public:
+  virtual ~LanderIO() {}
+
+  // Flight controls
+  virtual void Main_Thruster(double power) = 0;
+  virtual void Left_Thruster(double power) = 0;
+  virtual void Right_Thruster(double power) = 0;
+  virtual void Rotate(double angle) = 0;
+
+  // Sensors
+  virtual double Velocity_X() = 0;
+  virtual double Velocity_Y() = 0;
+  virtual double Position_X() = 0;
+  virtual double Position_Y() = 0;
+  virtual double Angle() = 0;
+  virtual double RangeDist() = 0;
+
+  // Variables accessible to the flight computer
+  virtual int MT_OK() = 0;
+  virtual int RT_OK() = 0;
+  virtual int LT_OK() = 0;
+  virtual double PLAT_X() = 0;
+  virtual double PLAT_Y() = 0;
+  virtual const double *SONAR_DIST() = 0;
+};
+
+// Commands the flight computer has given. Thruster powers hold until
+// changed, rotated is set only on ticks where Rotate() was called
+struct IssuedCommands {
+  double main_pw, left_pw, right_pw;
+  double rotate;
+  bool rotated;
+};
+
+// Commands decided during a tick, sent once at its end. Actuators not
+// set hold their previous command
+struct PendingCommands {
+  double pw[3];             // Main, left, right
+  bool set[3];
+  double rotate;
+  bool rotated;
+};
+
+// Flight computer for one lander. All controller state lives here, so
+// any number of landers can be flown in one process (one instance per
+// lander, one thread per instance at a time).
+class LanderController {
+ public:
+  LanderController(LanderIO *io);
+
+  // Forget everything learned about the current flight
+  void Reset();
+
+  void Lander_Control();
+  void Safety_Override();
+
+  // Fly by a precomputed policy table (see Lander_Policy.h) instead of
+  // the hand-coded velocity limits, NULL for the limits. The table is
+  // only read, any number of controllers can share one
+  void Set_Policy(const LanderPolicy *policy) { this->policy = policy; }
+
+  // Gains to fly by (see Lander_Params.h), copied, NULL for the defaults.
+  // They hold across Reset()
+  void Set_Params(const ControllerParams *params);
+  const ControllerParams *Params() const { return &params; }
+
+  // What the flight computer saw, believed and did on the current tick
+  // (for the flight recorder, see Lander_Recorder.h)
+  const SensorSnapshot *Snapshot() const { return &snap; }
+  const StateEstimator *Estimator() const { return &est; }
+  const SonarStage *Sonar() const { return &sonar; }
+  const IssuedCommands *Commands() const { return &cmd; }
+
+  // Flight phase of the current tick and the phase timeline so far (see
+  // Lander_Phase.h)
+  int Phase() const { return phase; }
+  const PhaseTimeline *Timeline() const { return &timeline; }
+
+  // Ticks on which the safety checks changed the commands
+  long Overrides() const { return overrides; }
+
+ private:
+  void Read_Sensors();
+  void Policy_Control();
+
+  // Phases
+  int Next_Phase();
+  void Enter_Phase(int p);
+  int Lift_Thruster() const;
+  void Fly_Stabilize();
+  void Fly_Upright(double VXlim, double VYlim);
+  void Fly_Climb();
+  void Fly_Vector(int lift, double vx_des, double vy_des, double tilt);
+  void Fly_Recovery();
+  bool Safety_Check();
+
+  // Flight controls. Decided commands wait in pending until Issue()
+  // sends them, each actuator at most once per tick, also passing them
+  // on to the estimator
+  void Main_Thruster(double power);
+  void Left_Thruster(double power);
+  void Right_Thruster(double power);
+  void Rotate(double angle);
+  void Issue();
+
+  LanderIO *io;
+  const LanderPolicy *policy;
+  ControllerParams params;
+
+  // Sensor readings for the current tick. Taken by Lander_Control(),
+  // which also makes the safety checks, and consumed by
+  // Safety_Override()
+  SensorSnapshot snap;
+  bool snap_fresh;
+
+  // Position, velocity and angle estimates, updated with each snapshot
+  StateEstimator est;
+
+  // Nearest sonar return per sector, recomputed only when a reading changes
+  SonarStage sonar;
+
+  // Obstacle map from recent sonar returns, for the safety checks
+  CollisionPredictor pred;
+
+  IssuedCommands cmd;
+  PendingCommands pending;
+
+  int phase;
+  long tick;                // Lander_Control() calls since Reset()
+  PhaseTimeline timeline;
+  long overrides;
+};
+
+// The controller behind the global Lander_Control() and Safety_Override()
+// (Lander_Default.cpp)
+LanderController *Default_Controller(void);
+
+#endif
@@ -0,0 +1,74 @@
+/*
+	Default controller instance.
+
+	Lander_Control() and Safety_Override() as called by the simulator
+	(Lander_Control.o or Lander_Headless) fly one LanderController wired
+	to the global interface in Lander_Control.h. Programs that create
+	their own controllers (see Lander_Episode.h) do not link this file.
+
+	At startup it takes its gains from the parameter file named by
+	LANDER_PARAMS, or from lander.params if there is one (see
+	Lander_Params.h), so a Lander_Tune result is flown without rebuilding.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "Lander_Controller.h"
+
+class GlobalIO : public LanderIO {
+ public:
+  void Main_Thruster(double power) { ::Main_Thruster(power); }
+  void Left_Thruster(double power) { ::Left_Thruster(power); }
+  void Right_Thruster(double power) { ::Right_Thruster(power); }
+  void Rotate(double angle) { ::Rotate(angle); }
+  double Velocity_X() { return ::Velocity_X(); }
+  double Velocity_Y() { return ::Velocity_Y(); }
+  double Position_X() { return ::Position_X(); }
+  double Position_Y() { return ::Position_Y(); }
+  double Angle() { return ::Angle(); }
+  double RangeDist() { return ::RangeDist(); }
+  int MT_OK() { return ::MT_OK; }
+  int RT_OK() { return ::RT_OK; }
+  int LT_OK() { return ::LT_OK; }
+  double PLAT_X() { return ::PLAT_X; }
+  double PLAT_Y() { return ::PLAT_Y; }
+  const double *SONAR_DIST() { return ::SONAR_DIST; }
+};
+
+static GlobalIO global_io;
+static LanderController default_controller(&global_io);
+
+static int Load_Params(void)
+{
+  const char *fname = getenv("LANDER_PARAMS");
+  if (fname == NULL) {
+    if (access(PARAMS_FILE, R_OK) != 0) return 0;
+    fname = PARAMS_FILE;
+  }
+  ControllerParams params;
+  Params_Default(&params);
+  if (!Params_Load(fname, &params)) exit(1);
+  default_controller.Set_Params(&params);
+  fprintf(stderr, "Flying with controller parameters from %s\n", fname);
+  return 1;
+}
+
+// After default_controller, initialization runs in definition order
+static int params_loaded = Load_Params();
+
+LanderController *Default_Controller(void)
+{
+  return &default_controller;
+}
+
+void Lander_Control(void)
+{
+  default_controller.Lander_Control();
+}
+
+void Safety_Override(void)
+{
+  default_controller.Safety_Override();
+}
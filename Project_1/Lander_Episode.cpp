@@ -0,0 +1,121 @@
+/*
+	Single landing episode - see Lander_Episode.h
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Lander_Episode.h"
+#include "Lander_SDF.h"
+
+void Run_Episode(const Scenario *sc, EpisodeResult *res) {
+  LanderSim sim;
+  SimIO io(&sim);
+  LanderController controller(&io);
+  controller.Set_Policy(sc->policy);
+  controller.Set_Params(sc->params);
+
+  Sim_Reset(&sim, sc->map, sc->shape, sc->fail_mode, sc->comps, sc->ncomps, sc->seed);
+  if (sc->plan != NULL) Sim_Set_Plan(&sim, sc->plan);
+  if (sc->max_time > 0) sim.max_time = sc->max_time;
+  Sim_Set_Exact_Contact(&sim, sc->exact_contact);
+
+  FlightRecorder rec;
+  bool recording = sc->trace_name != NULL && Recorder_Init(&rec);
+
+  // With timing on, the clock is read around the controller calls of
+  // each tick, so the time includes two clock reads per tick
+  double control_ns = 0;
+  struct timespec t0, t1;
+  long overrides = 0;
+  bool overriding = false;
+  res->interventions = 0;
+  res->intervention_clear = 0;
+  while (sim.status == SIM_FLYING) {
+    if (sc->time_control) clock_gettime(CLOCK_MONOTONIC, &t0);
+    controller.Lander_Control();
+    controller.Safety_Override();
+    if (sc->time_control) {
+      clock_gettime(CLOCK_MONOTONIC, &t1);
+      control_ns += (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+    }
+    if (recording) Recorder_Capture(&rec, &sim, &controller);
+
+    // A run of ticks on which the safety override changed the commands
+    // is one intervention, booked with the true clearance it began at
+    long ov = controller.Overrides();
+    if (ov > overrides) {
+      if (!overriding) {
+        res->interventions++;
+        if (sim.map->sdf != NULL) res->intervention_clear += Sdf_Clearance(sim.map->sdf, sim.x, sim.y);
+      }
+      overriding = true;
+    }
+    else overriding = false;
+    overrides = ov;
+    Sim_Step(&sim);
+  }
+
+  if (recording) {
+    if (sim.status == SIM_CRASHED)
+      Recorder_Flush(&rec, &sim, sc->map_name != NULL ? sc->map_name : "", sc->seed, sc->trace_name);
+    Recorder_Free(&rec);
+  }
+
+  res->status = sim.status;
+  res->time = sim.sim_time;
+  res->td_vx = sim.td_vx;
+  res->td_vy = sim.td_vy;
+  res->td_angle = sim.td_angle;
+  res->ticks = sim.ticks;
+  for (int i = 0; i < N_SENS; i++) res->reads[i] = sim.reads[i];
+  res->contact_tests = sim.contact_tests;
+  res->thrust_s = sim.thrust_s;
+  res->control_ns = control_ns;
+  res->overrides = overrides;
+  const FaultDetector *faults = controller.Estimator()->Faults();
+  for (int i = 0; i < N_COMP; i++) {
+    res->fail_tick[i] = sim.fail_tick[i];
+    res->found_tick[i] = i > 0 ? faults->Found(i) : -1;
+  }
+}
+
+int Parse_Config(const char *spec, FailConfig *cfg) {
+  memset(cfg, 0, sizeof(FailConfig));
+  snprintf(cfg->name, sizeof(cfg->name), "%s", spec);
+  char *end;
+  cfg->mode = (int)strtol(spec, &end, 10);
+  if (end == spec || cfg->mode < 0 || cfg->mode > 3) return 0;
+  if (*end == '\0') return 1;
+  if (*end != ':') return 0;
+
+  // Components separated by commas, nothing after the last
+  const char *p = end + 1;
+  for (;;) {
+    if (cfg->ncomps == N_COMP) return 0;
+    int c = (int)strtol(p, &end, 10);
+    if (end == p || c < 1 || c > 9) return 0;
+    cfg->comps[cfg->ncomps++] = c;
+    if (*end == '\0') return 1;
+    if (*end != ',') return 0;
+    p = end + 1;
+  }
+}
+
+int Parse_Long(const char *s, long *v) {
+  char *end;
+  long x = strtol(s, &end, 10);
+  if (end == s || *end != '\0') return 0;
+  *v = x;
+  return 1;
+}
+
+int Parse_Double(const char *s, double *v) {
+  char *end;
+  double x = strtod(s, &end);
+  if (end == s || *end != '\0') return 0;
+  *v = x;
+  return 1;
+}
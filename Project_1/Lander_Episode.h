@@ -0,0 +1,72 @@
+/*
+	One complete landing: a fresh LanderSim flown by a fresh
+	LanderController until it lands, crashes, leaves the map or runs
+	out of time. Episodes share nothing but the (read-only) map and
+	lander shape, so they can run concurrently on any number of threads.
+
+	With a trace name the episode runs a flight recorder and flushes it
+	if the lander crashes (see Lander_Recorder.h). The file is written
+	in the background, callers must Recorder_Wait() before exiting.
+*/
+
+#ifndef _LANDER_EPISODE_H
+#define _LANDER_EPISODE_H
+
+#include "Lander_Sim.h"
+#include "Lander_Recorder.h"
+
+struct Scenario {
+  const LanderMap *map;
+  const LanderShape *shape;
+  int fail_mode;
+  int comps[N_COMP];      // Mode 3 component list
+  int ncomps;
+  long seed;
+  double max_time;
+  const char *map_name;   // For the trace header
+  const char *trace_name; // Flight trace to write on a crash, NULL for none
+  const LanderPolicy *policy; // Table to fly by (Lander_Policy.h), NULL for the hand-coded limits
+  const ControllerParams *params; // Gains (Lander_Params.h), NULL for the defaults
+  int exact_contact;      // Locate touchdown within the step (Sim_Set_Exact_Contact)
+  const FlightPlan *plan; // Initial state and failure schedule, NULL for the seeded ones
+  int time_control;       // Time the controller (EpisodeResult::control_ns)
+};
+
+// A failure configuration: a failure mode, with a component list in
+// mode 3. Written "0", "2", "3:4" or "3:1,5,8"
+struct FailConfig {
+  int mode;
+  int comps[N_COMP];
+  int ncomps;
+  char name[32];
+};
+
+struct EpisodeResult {
+  int status;             // SIM_LANDED, SIM_CRASHED, ...
+  double time;            // Simulated seconds until the episode ended
+  double td_vx, td_vy;    // Velocity at touchdown (m/s)
+  double td_angle;        // Angle at touchdown (degrees from vertical)
+  long ticks;
+  long reads[N_SENS];     // Sensor calls made by the controller
+  long contact_tests;     // Outline tests made by the simulation
+  long fail_tick[N_COMP]; // Tick each component failed at, -1 if it did not
+  long found_tick[N_COMP]; // Tick the flight computer isolated it at, -1 if it did not
+  double thrust_s;        // Thrust used, seconds at full power
+  double control_ns;      // Time spent in the controller, if timed (ns)
+  long overrides;         // Ticks the safety override changed the commands on
+  long interventions;     // Runs of such ticks
+  double intervention_clear; // Sum of the true terrain clearance (pixels) each began at
+};
+
+void Run_Episode(const Scenario *sc, EpisodeResult *res);
+
+// Parse a failure configuration, returns 0 if it is malformed or has
+// anything after it
+int Parse_Config(const char *spec, FailConfig *cfg);
+
+// Parse a whole option value into v, returns 0 (leaving v alone) if s
+// is empty or has anything after the number
+int Parse_Long(const char *s, long *v);
+int Parse_Double(const char *s, double *v);
+
+#endif
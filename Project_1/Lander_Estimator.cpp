@@ -0,0 +1,223 @@
+/*
+	Fused state estimator - see Lander_Estimator.h
+*/
+
+#include <math.h>
+
+#include "Lander_Control.h"
+#include "Lander_Estimator.h"
+
+#define DEG2RAD (PI/180.0)
+#define RAD2DEG (180.0/PI)
+
+// Innovation gate, in standard deviations. Readings outside it are not
+// used
+#define GATE 5.0
+
+// Consistency test over the last INNOV_WINDOW normalized innovations
+// (see Lander_Estimator.h). A working sensor's innovations have zero
+// mean and at most unit variance
+#define INNOV_CLAMP 10.0
+#define VAR_LIMIT 4.0
+#define BIAS_LIMIT .5
+
+// (GATE, VAR_LIMIT and BIAS_LIMIT are the defaults, Set_Limits() changes
+// them, see Lander_Params.h)
+
+// Variance of a reading with uniform relative noise NP1 (the sensor
+// model in Lander_Control.h), plus a floor so values near zero are not
+// trusted blindly
+static double Sensor_Var(double value) {
+  double w = NP1 * value;
+  return w * w / 12 + 1e-4;
+}
+
+static double Wrap(double a) {
+  while (a > PI) a -= 2 * PI;
+  while (a < -PI) a += 2 * PI;
+  return a;
+}
+
+/*
+  Per axis filter
+*/
+
+// Position changes by k * velocity per tick (k is negative for y, which
+// grows downward while vy is positive upward)
+static void Axis_Predict(AxisFilter *f, double k, double a, double qa) {
+  f->v += a * T_STEP;
+  f->p += k * f->v;
+
+  double Ppp = f->Ppp + 2 * k * f->Ppv + k * k * f->Pvv;
+  double Ppv = f->Ppv + k * f->Pvv;
+  double g = k * T_STEP;
+  f->Ppp = Ppp + qa * g * g;
+  f->Ppv = Ppv + qa * g * T_STEP;
+  f->Pvv += qa * T_STEP * T_STEP;
+}
+
+// Innovation of a position (vel = 0) or velocity (vel = 1) reading and
+// its variance
+static double Axis_Innovation(const AxisFilter *f, int vel, double z, double R, double *S) {
+  *S = (vel ? f->Pvv : f->Ppp) + R;
+  return z - (vel ? f->v : f->p);
+}
+
+static void Axis_Correct(AxisFilter *f, int vel, double innov, double S) {
+  double Pp = vel ? f->Ppv : f->Ppp;   // Cov(p, z)
+  double Pv = vel ? f->Pvv : f->Ppv;   // Cov(v, z)
+  f->p += Pp / S * innov;
+  f->v += Pv / S * innov;
+  f->Ppp -= Pp * Pp / S;
+  f->Ppv -= Pp * Pv / S;
+  f->Pvv -= Pv * Pv / S;
+}
+
+/*
+  Estimator
+*/
+
+StateEstimator::StateEstimator() : gate(GATE), var_limit(VAR_LIMIT), bias_limit(BIAS_LIMIT) {
+  Reset();
+}
+
+void StateEstimator::Reset() {
+  x.p = x.v = y.p = y.v = 0;
+  x.Ppp = x.Ppv = x.Pvv = 0;
+  y.Ppp = y.Ppv = y.Pvv = 0;
+  theta = Ptt = rot_left = 0;
+  main_pw = left_pw = right_pw = 0;
+  mt_ok = lt_ok = rt_ok = 1;
+  for (int i = 0; i < N_SENS; i++) {
+    innov[i].Reset(0);
+    failed[i] = false;
+  }
+  init = false;
+  faults.Reset();
+}
+
+// Thrusters deliver about 95% of the requested power plus a small idle
+// leak (mean of the actuator noise)
+double StateEstimator::Delivered_Power(double power) {
+  return fmin(fmax(power, 0), 1) * .95 + .025;
+}
+
+void StateEstimator::Command_Rotate(double angle) {
+  // Only the latest Rotate() counts, it replaces any rotation in progress.
+  // The lander turns about 95% of the request plus up to .05 degrees
+  // more (mean of the actuator noise), which adds up when the rotation
+  // is corrected every tick
+  rot_left = (angle * .95 + .025) * DEG2RAD;
+}
+
+double StateEstimator::Angle() const {
+  double a = fmod(theta * RAD2DEG, 360);
+  return a < 0 ? a + 360 : a;
+}
+
+// Books a reading's innovation and runs the consistency test, returns
+// true if the reading should be used
+bool StateEstimator::Check(int sensor, double e, double S) {
+  double nu = e / sqrt(S);
+  innov[sensor].Push(fmax(-INNOV_CLAMP, fmin(INNOV_CLAMP, nu)));
+  if (innov[sensor].Variance() > var_limit || fabs(innov[sensor].Mean()) > bias_limit)
+    failed[sensor] = true;
+  return !failed[sensor] && fabs(nu) <= gate;
+}
+
+void StateEstimator::Correct(AxisFilter *f, int sensor, int vel, double z) {
+  if (failed[sensor]) return;
+  double S;
+  double e = Axis_Innovation(f, vel, z, Sensor_Var(vel ? f->v : f->p), &S);
+  if (Check(sensor, e, S)) Axis_Correct(f, vel, e, S);
+}
+
+void StateEstimator::Update(const SensorSnapshot *snap) {
+  if (!init) {
+    x.p = snap->px;
+    y.p = snap->py;
+    x.v = snap->vx;
+    y.v = snap->vy;
+    x.Ppp = Sensor_Var(snap->px) + 1;
+    y.Ppp = Sensor_Var(snap->py) + 1;
+    x.Pvv = Sensor_Var(snap->vx) + 1;
+    y.Pvv = Sensor_Var(snap->vy) + 1;
+    theta = snap->angle * DEG2RAD;
+    Ptt = NP1 * NP1 / 12;
+    mt_ok = snap->MT_OK;
+    lt_ok = snap->LT_OK;
+    rt_ok = snap->RT_OK;
+    faults.Update(snap, NULL);
+    init = true;
+    return;
+  }
+
+  // Angle: the lander turns at most MAX_ROT_RATE per tick towards the
+  // commanded rotation
+  double step = fmax(-MAX_ROT_RATE, fmin(MAX_ROT_RATE, rot_left));
+  theta += step;
+  rot_left -= step;
+  Ptt += 1e-7 + 1e-3 * step * step;
+  if (!failed[SENS_ANGLE]) {
+    double e = Wrap(snap->angle * DEG2RAD - theta);
+    double S = Ptt + NP1 * NP1 / 12;
+    if (Check(SENS_ANGLE, e, S)) {
+      theta += Ptt / S * e;
+      Ptt -= Ptt * Ptt / S;
+    }
+  }
+  theta = fmod(theta, 2 * PI);
+  if (theta < 0) theta += 2 * PI;
+
+  // Accelerations from the thrust in effect during the last step, using
+  // the thruster status from before that step
+  double s = sin(theta);
+  double c = cos(theta);
+  double mp = mt_ok ? main_pw : 0;
+  double lp = lt_ok ? left_pw : 0;
+  double rp = rt_ok ? right_pw : 0;
+  double ax = MT_ACCEL * mp * s + LT_ACCEL * lp * c - RT_ACCEL * rp * c;
+  double ay = -G_ACCEL + MT_ACCEL * mp * c - LT_ACCEL * lp * s + RT_ACCEL * rp * s;
+
+  // Process noise: actuator noise plus the effect of the angle
+  // uncertainty on the main thruster direction
+  double qa = (NP1 * NP1 / 12) * (MT_ACCEL * MT_ACCEL + LT_ACCEL * LT_ACCEL + RT_ACCEL * RT_ACCEL);
+  qa += MT_ACCEL * MT_ACCEL * mp * mp * Ptt + .01;
+
+  // The same step for the fault detector, with worst-case bounds: each
+  // thruster delivers within .025 of the modelled power, and the thrust
+  // direction is off by at most the angle error
+  FaultModel m;
+  double dt = NP1 / 2 + 4 * sqrt(Ptt);
+  m.ax = ax;
+  m.ay = ay;
+  m.a_err = .025 * (MT_ACCEL + LT_ACCEL + RT_ACCEL) +
+            dt * (MT_ACCEL * (mp + .025) + LT_ACCEL * (lp + .025) + RT_ACCEL * (rp + .025));
+  m.thrust_x[0] = MT_ACCEL * mp * s;
+  m.thrust_y[0] = MT_ACCEL * mp * c;
+  m.thrust_x[1] = LT_ACCEL * lp * c;
+  m.thrust_y[1] = -LT_ACCEL * lp * s;
+  m.thrust_x[2] = -RT_ACCEL * rp * c;
+  m.thrust_y[2] = RT_ACCEL * rp * s;
+  m.step = step;
+  m.vx = x.v + ax * T_STEP;
+  m.vy = y.v + ay * T_STEP;
+  m.vx_err = 4 * sqrt(x.Pvv + qa * T_STEP * T_STEP) + m.a_err * T_STEP;
+  m.vy_err = 4 * sqrt(y.Pvv + qa * T_STEP * T_STEP) + m.a_err * T_STEP;
+  faults.Update(snap, &m);
+  static const int sensor_comp[N_SENS] = {FAULT_VEL_X, FAULT_VEL_Y, FAULT_POS_X, FAULT_POS_Y, FAULT_ANGLE, 0};
+  for (int i = 0; i < N_SENS; i++)
+    if (sensor_comp[i] && faults.Faulty(sensor_comp[i])) failed[i] = true;
+
+  Axis_Predict(&x, T_STEP * S_SCALE, ax, qa);
+  Axis_Predict(&y, -T_STEP * S_SCALE, ay, qa);
+
+  Correct(&x, SENS_POS_X, 0, snap->px);
+  Correct(&y, SENS_POS_Y, 0, snap->py);
+  Correct(&x, SENS_VEL_X, 1, snap->vx);
+  Correct(&y, SENS_VEL_Y, 1, snap->vy);
+
+  mt_ok = snap->MT_OK && !faults.Faulty(FAULT_MAIN);
+  lt_ok = snap->LT_OK && !faults.Faulty(FAULT_LEFT);
+  rt_ok = snap->RT_OK && !faults.Faulty(FAULT_RIGHT);
+}
@@ -0,0 +1,122 @@
+/*
+	Fused state estimator for the flight computer.
+
+	Once per tick the estimator predicts where the lander should be
+	from the thrust and rotation it was commanded to do, then corrects
+	the prediction with whichever sensors still agree with it. Each axis
+	is a two state (position, velocity) Kalman filter, the angle is a
+	one state filter driven by the commanded rotation.
+
+	Readings far outside the prediction (the innovation gate) are
+	skipped. Each sensor also keeps a window of its normalized
+	innovations, which for a working sensor have zero mean and about
+	unit variance. A sensor whose window shows excess variance or a
+	bias is flagged failed and ignored from then on, the affected
+	states keep going on the remaining sensors or, if none are left,
+	on dead reckoning.
+
+	Alongside that statistical test the estimator runs a FaultDetector
+	(Lander_Fault.h), which checks the sensors against each other and
+	against the commanded thrust and rotation with worst-case noise
+	bounds. A sensor it isolates is failed too, and a thruster it
+	isolates is left out of the model even while its OK flag is set.
+*/
+
+#ifndef _LANDER_ESTIMATOR_H
+#define _LANDER_ESTIMATOR_H
+
+#include "Lander_History.h"
+#include "Lander_Fault.h"
+
+// Sensors, in the order used by the estimator and the simulator's read
+// counters
+#define SENS_VEL_X 0
+#define SENS_VEL_Y 1
+#define SENS_POS_X 2
+#define SENS_POS_Y 3
+#define SENS_ANGLE 4
+#define SENS_RANGE 5
+#define N_SENS 6
+
+// Innovation window for the sensor consistency test
+#define INNOV_WINDOW 64
+
+// Everything the flight computer observes in one tick. Each sensor is
+// read exactly once per tick into a snapshot, and the control and safety
+// paths both work from the same samples.
+struct SensorSnapshot {
+  double vx, vy;
+  double px, py;
+  double angle;
+  double range;
+  double sonar[36];
+  int MT_OK, RT_OK, LT_OK;
+  double plat_x, plat_y;
+};
+
+// Position (pixels) and velocity (m/s) along one axis with covariance
+struct AxisFilter {
+  double p, v;
+  double Ppp, Ppv, Pvv;
+};
+
+class StateEstimator {
+ public:
+  StateEstimator();
+
+  void Reset();
+
+  // Innovation gate (standard deviations), and the window variance and
+  // bias beyond which a sensor is failed
+  void Set_Limits(double gate, double var_limit, double bias_limit) {
+    this->gate = gate;
+    this->var_limit = var_limit;
+    this->bias_limit = bias_limit;
+  }
+
+  // Commands sent to the lander this tick, they act on the next update
+  void Command_Main(double power) { main_pw = Delivered_Power(power); }
+  void Command_Left(double power) { left_pw = Delivered_Power(power); }
+  void Command_Right(double power) { right_pw = Delivered_Power(power); }
+  void Command_Rotate(double angle);
+
+  // Advance one tick and fold in this tick's readings
+  void Update(const SensorSnapshot *snap);
+
+  // Current estimates. Angle in degrees in [0, 360) like Angle()
+  double Position_X() const { return x.p; }
+  double Position_Y() const { return y.p; }
+  double Velocity_X() const { return x.v; }
+  double Velocity_Y() const { return y.v; }
+  double Angle() const;
+
+  // True once a sensor has been flagged failed
+  bool Failed(int sensor) const { return failed[sensor]; }
+
+  // Cross-sensor fault detection
+  const FaultDetector *Faults() const { return &faults; }
+
+ private:
+  static double Delivered_Power(double power);
+  bool Check(int sensor, double e, double S);
+  void Correct(AxisFilter *f, int sensor, int vel, double z);
+
+  AxisFilter x, y;
+  double theta, Ptt;        // Angle (radians, clockwise) and its variance
+  double rot_left;          // Commanded rotation not carried out yet
+
+  // Thrust in effect since the last update
+  double main_pw, left_pw, right_pw;
+  int mt_ok, lt_ok, rt_ok;
+
+  // Recent normalized innovations, per sensor
+  SensorHistory<INNOV_WINDOW, UniformWeights> innov[N_SENS];
+  bool failed[N_SENS];
+  bool init;
+
+  FaultDetector faults;
+
+  double gate, var_limit, bias_limit;
+};
+
+#endif
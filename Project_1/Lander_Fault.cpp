@@ -0,0 +1,208 @@
+/*
+	Cross-sensor fault detection - see Lander_Fault.h
+*/
+
+#include <math.h>
+
+#include "Lander_Control.h"
+#include "Lander_Estimator.h"
+#include "Lander_Fault.h"
+
+#define DEG2RAD (PI/180.0)
+
+// CUSUM alarm threshold, in bounds
+#define CUSUM_H 2.0
+
+// The sonar check counts the ticks RangeDist() sees terrain this close
+// (pixels from the bottom of the lander, a sweep reaches about 455), and
+// isolates the sonar once this many have gone by without a fresh return.
+// A working sonar returns from terrain in reach every sweep (51 ticks);
+// terrain that has just come into reach may wait for the next sweep, and
+// the beam takes up to 47 more ticks to get there
+#define SONAR_NEAR 420.0
+#define SONAR_QUIET 102
+
+// The simulator carries out a rotation to within .025 degrees of the
+// .95 * angle + .025 the estimator expects, a step is allowed the whole
+// .05 degree spread of the actuator noise
+#define ROT_ERR (.05 * DEG2RAD)
+
+// Largest error of a reading with uniform relative noise NP1, given the
+// reading (the true value is at most |r| / (1 - NP1/2)). The small floor
+// covers rounding
+static double Reading_Bound(double r) {
+  return NP1 / 2 * fabs(r) / (1 - NP1 / 2) + 1e-9;
+}
+
+static double Wrap(double a) {
+  while (a > PI) a -= 2 * PI;
+  while (a < -PI) a += 2 * PI;
+  return a;
+}
+
+void FaultDetector::Reset() {
+  tick = 0;
+  for (int i = 0; i < N_FAULT; i++) found[i] = -1;
+  for (int i = 0; i < N_FCH; i++) cusum[i] = 0;
+  sonar_quiet = 0;
+  for (int i = 0; i < 36; i++) sonar_last[i] = -1;
+  px = py = angle = 0;
+  n_hist = since = 0;
+}
+
+void FaultDetector::Isolate(int comp) {
+  if (found[comp] < 0) found[comp] = tick;
+}
+
+// Adds a residual to its channel, returns true on alarm
+bool FaultDetector::Test(int ch, double e, double bound) {
+  cusum[ch] = fmax(0, cusum[ch] + fabs(e) / bound - 1);
+  return cusum[ch] > CUSUM_H;
+}
+
+// Velocity residual of one tick, i ticks back, and its bound. With j
+// >= 0 thruster j is taken out of the model
+void FaultDetector::Tick_Residual(int i, int j, double *ex, double *ey, double *bx, double *by) const {
+  const VelocityStep *h = &hist[(n_hist - 1 - i) % (DV_WINDOW + 1)];
+  const VelocityStep *g = &hist[(n_hist - 2 - i) % (DV_WINDOW + 1)];
+  *ex = h->vx - g->vx - (h->sum_x - g->sum_x) + (j >= 0 ? h->cx[j] : 0);
+  *ey = h->vy - g->vy - (h->sum_y - g->sum_y) + (j >= 0 ? h->cy[j] : 0);
+  double err = h->sum_err - g->sum_err;
+  *bx = Reading_Bound(h->vx) + Reading_Bound(g->vx) + err;
+  *by = Reading_Bound(h->vy) + Reading_Bound(g->vy) + err;
+}
+
+// A thruster that, had it stopped at some tick of the last w, explains
+// the velocity residual (ex, ey) over them, 0 if there is none. The
+// thrust it takes out has to be more than the bound, or any thruster
+// would do. The last two ticks on their own have to fit too: a failed
+// velocity sensor jumps around from tick to tick, a lost thruster only
+// makes the velocity drift
+int FaultDetector::Explaining_Thruster(int w, double ex, double ey, double bx, double by) const {
+  if (w < 3) return 0;
+  for (int j = 0; j < 3; j++) {
+    if (Faulty(FAULT_MAIN + j)) continue;
+    bool fits = true;
+    for (int i = 0; i < 2 && fits; i++) {
+      double dx, dy, ux, uy;
+      Tick_Residual(i, j, &dx, &dy, &ux, &uy);
+      fits = fabs(dx) <= ux && fabs(dy) <= uy;
+    }
+    if (!fits) continue;
+
+    double sx = 0, sy = 0;
+    for (int i = 0; i < w; i++) {
+      const VelocityStep *h = &hist[(n_hist - 1 - i) % (DV_WINDOW + 1)];
+      sx += h->cx[j];
+      sy += h->cy[j];
+      if (fabs(ex + sx) <= bx && fabs(ey + sy) <= by && (fabs(sx) > bx || fabs(sy) > by))
+        return FAULT_MAIN + j;
+    }
+  }
+  return 0;
+}
+
+// True if the last tick's velocity change along an axis (0 = x) is out
+// of bounds with or without any one working thruster: the sensor jumped
+bool FaultDetector::Jumped(int axis) const {
+  for (int j = -1; j < 3; j++) {
+    if (j >= 0 && Faulty(FAULT_MAIN + j)) continue;
+    double ex, ey, bx, by;
+    Tick_Residual(0, j, &ex, &ey, &bx, &by);
+    if (axis == 0 ? fabs(ex) <= bx : fabs(ey) <= by) return false;
+  }
+  return true;
+}
+
+void FaultDetector::Update(const SensorSnapshot *snap, const FaultModel *m) {
+  // Thruster flags come from the lander itself
+  if (!snap->MT_OK) Isolate(FAULT_MAIN);
+  if (!snap->LT_OK) Isolate(FAULT_LEFT);
+  if (!snap->RT_OK) Isolate(FAULT_RIGHT);
+
+  // Book this tick's velocity step
+  VelocityStep *cur = &hist[n_hist % (DV_WINDOW + 1)];
+  const VelocityStep *prev = n_hist > 0 ? &hist[(n_hist - 1) % (DV_WINDOW + 1)] : NULL;
+  cur->vx = snap->vx;
+  cur->vy = snap->vy;
+  cur->sum_x = cur->sum_y = cur->sum_err = 0;
+  for (int j = 0; j < 3; j++) cur->cx[j] = cur->cy[j] = 0;
+  if (prev != NULL && m != NULL) {
+    cur->sum_x = prev->sum_x + m->ax * T_STEP;
+    cur->sum_y = prev->sum_y + m->ay * T_STEP;
+    cur->sum_err = prev->sum_err + m->a_err * T_STEP;
+    for (int j = 0; j < 3; j++) {
+      cur->cx[j] = m->thrust_x[j] * T_STEP;
+      cur->cy[j] = m->thrust_y[j] * T_STEP;
+    }
+  }
+  n_hist++;
+  since++;
+
+  double a = snap->angle * DEG2RAD;
+  if (tick > 0 && m != NULL) {
+    // Position against velocity. y grows downward while vy is positive
+    // upward
+    double k = T_STEP * S_SCALE;
+    double ux = Faulty(FAULT_VEL_X) ? m->vx : snap->vx;
+    double uy = Faulty(FAULT_VEL_Y) ? m->vy : snap->vy;
+    double ux_b = Faulty(FAULT_VEL_X) ? m->vx_err : Reading_Bound(snap->vx);
+    double uy_b = Faulty(FAULT_VEL_Y) ? m->vy_err : Reading_Bound(snap->vy);
+    if (!Faulty(FAULT_POS_X) &&
+        Test(FCH_POS_X, snap->px - px - k * ux, Reading_Bound(snap->px) + Reading_Bound(px) + k * ux_b))
+      Isolate(FAULT_POS_X);
+    if (!Faulty(FAULT_POS_Y) &&
+        Test(FCH_POS_Y, snap->py - py + k * uy, Reading_Bound(snap->py) + Reading_Bound(py) + k * uy_b))
+      Isolate(FAULT_POS_Y);
+
+    // Velocity against thrust, over the window
+    int w = since - 1 < DV_WINDOW ? (int)(since - 1) : DV_WINDOW;
+    if (w > 0) {
+      const VelocityStep *old = &hist[(n_hist - 1 - w) % (DV_WINDOW + 1)];
+      double ex = cur->vx - old->vx - (cur->sum_x - old->sum_x);
+      double ey = cur->vy - old->vy - (cur->sum_y - old->sum_y);
+      double err = cur->sum_err - old->sum_err;
+      double bx = Reading_Bound(cur->vx) + Reading_Bound(old->vx) + err;
+      double by = Reading_Bound(cur->vy) + Reading_Bound(old->vy) + err;
+      bool alarm_x = !Faulty(FAULT_VEL_X) && Test(FCH_VEL_X, ex, bx);
+      bool alarm_y = !Faulty(FAULT_VEL_Y) && Test(FCH_VEL_Y, ey, by);
+      if (alarm_x || alarm_y) {
+        int thr = Explaining_Thruster(w, ex, ey, bx, by);
+        if (thr) {
+          // The model leaves it out from now on, start a fresh window
+          Isolate(thr);
+          cusum[FCH_VEL_X] = cusum[FCH_VEL_Y] = 0;
+          since = 1;
+        }
+        else {
+          // A sensor is only blamed when it jumps, a drift nothing
+          // explains yet keeps the alarm up for the next tick
+          if (alarm_x && Jumped(0)) Isolate(FAULT_VEL_X);
+          if (alarm_y && Jumped(1)) Isolate(FAULT_VEL_Y);
+        }
+      }
+    }
+
+    // Angle against the commanded rotation, two readings with NP1/2
+    // noise each
+    if (!Faulty(FAULT_ANGLE) && Test(FCH_ANGLE, Wrap(a - angle - m->step), NP1 + ROT_ERR + 1e-9))
+      Isolate(FAULT_ANGLE);
+  }
+
+  // Sonar against RangeDist. Every return draws fresh noise, a failed
+  // sonar's readings freeze and then drop to -1. Ticks with nothing in
+  // reach say nothing either way and leave the count where it is
+  bool fresh = false;
+  for (int i = 0; i < 36; i++) {
+    fresh = fresh || (snap->sonar[i] >= 0 && snap->sonar[i] != sonar_last[i]);
+    sonar_last[i] = snap->sonar[i];
+  }
+  if (fresh) sonar_quiet = 0;
+  else if (snap->range >= 0 && snap->range <= SONAR_NEAR) sonar_quiet++;
+  if (sonar_quiet > SONAR_QUIET) Isolate(FAULT_SONAR);
+
+  px = snap->px;
+  py = snap->py;
+  angle = a;
+  tick++;
+}
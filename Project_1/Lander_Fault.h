@@ -0,0 +1,135 @@
+/*
+	Cross-sensor fault detection for the flight computer.
+
+	Each tick FaultDetector checks the readings against each other and
+	against what the lander was told to do:
+
+	  position  - the change in position against the velocity readings
+	              (per axis, the simulator moves the lander by exactly
+	              T_STEP * S_SCALE * velocity each step)
+	  velocity  - the change in velocity over the last DV_WINDOW ticks
+	              against what the commanded thrust should have
+	              produced (per axis). A single tick of thrust is lost
+	              in the velocity noise, a window of them is not
+	  angle     - the change in angle against the commanded rotation
+	  sonar     - no fresh return while RangeDist() sees terrain well
+	              within sonar reach
+
+	Sensor noise and actuator noise are bounded (uniform), so every
+	residual comes with the largest value a working lander can produce,
+	and residuals are normalized by it: a working sensor never gives
+	|z| > 1. Each channel runs a one-sided CUSUM,
+
+	  S = max(0, S + |z| - 1)
+
+	which stays at 0 on a working lander and alarms once S > CUSUM_H. A
+	fault that keeps |z| >= d > 1 is therefore isolated within
+	ceil(CUSUM_H / (d - 1)) ticks, and the garbage a failed sensor
+	returns is almost always far outside the bound (one or two ticks
+	in practice). The sonar channel counts ticks instead: a failed sonar
+	stops returning at once, and is isolated after SONAR_QUIET ticks
+	with terrain in reach. Nothing bounds the latency in flight time: a
+	sonar that fails with no terrain in reach reads just as a working
+	one does, and stays unnoticed until the lander comes within reach.
+
+	An alarm is pinned on one component. Position and angle alarms
+	blame their own sensor. A velocity alarm is pinned on a thruster if
+	taking its thrust out of the model, from some tick of the window
+	on, explains the residual: the thruster has failed without its OK
+	flag saying so (it only shows once the thrust it should have given
+	is more than the bound). Otherwise it blames the velocity sensor,
+	but only on a tick where the reading jumped by more than any
+	thruster could account for. Thruster flags that do drop are taken
+	at their word. Faults in the simulator are permanent, so an
+	isolated component stays isolated, and channels that read it are
+	not run any more.
+
+	Components are numbered as in the simulator's failure lists, and
+	the detector records the tick (Update() calls since Reset(), the
+	first is tick 0) each one was isolated at.
+*/
+
+#ifndef _LANDER_FAULT_H
+#define _LANDER_FAULT_H
+
+struct SensorSnapshot;
+
+// Components, numbered as in the simulator's failure lists (-c 3:...)
+#define FAULT_MAIN 1
+#define FAULT_LEFT 2
+#define FAULT_RIGHT 3
+#define FAULT_VEL_X 4
+#define FAULT_VEL_Y 5
+#define FAULT_POS_X 6
+#define FAULT_POS_Y 7
+#define FAULT_ANGLE 8
+#define FAULT_SONAR 9
+#define N_FAULT 10
+
+// CUSUM channels
+#define FCH_POS_X 0
+#define FCH_POS_Y 1
+#define FCH_VEL_X 2
+#define FCH_VEL_Y 3
+#define FCH_ANGLE 4
+#define N_FCH 5
+
+// Ticks over which velocity is checked against thrust
+#define DV_WINDOW 32
+
+// What the estimator expects of the step just taken
+struct FaultModel {
+  double ax, ay;            // Acceleration (m/s^2)
+  double a_err;             // Bound on its error
+  double thrust_x[3], thrust_y[3]; // Part of it from main, left and right
+  double step;              // Rotation (radians)
+  double vx, vy;            // Estimated velocity, stands in for an isolated velocity sensor
+  double vx_err, vy_err;    // Bound on its error
+};
+
+class FaultDetector {
+ public:
+  FaultDetector() { Reset(); }
+
+  void Reset();
+
+  // Check this tick's readings. m is the estimator's model of the step
+  // that led to them (unused on the first tick)
+  void Update(const SensorSnapshot *snap, const FaultModel *m);
+
+  bool Faulty(int comp) const { return found[comp] >= 0; }
+
+  // Tick a component was isolated at, -1 if it has not been
+  long Found(int comp) const { return found[comp]; }
+
+  // Current CUSUM of a channel
+  double Cusum(int ch) const { return cusum[ch]; }
+
+ private:
+  void Isolate(int comp);
+  bool Test(int ch, double e, double bound);
+  void Tick_Residual(int i, int j, double *ex, double *ey, double *bx, double *by) const;
+  int Explaining_Thruster(int w, double ex, double ey, double bx, double by) const;
+  bool Jumped(int axis) const;
+
+  long tick;
+  long found[N_FAULT];
+  double cusum[N_FCH];
+  long sonar_quiet;         // Ticks with terrain in reach since the last fresh return
+  double sonar_last[36];    // Last tick's sonar readings
+
+  // Last tick's readings
+  double px, py, angle;
+
+  // Velocity readings and the modelled change in velocity of the last
+  // DV_WINDOW + 1 ticks, in a ring
+  struct VelocityStep {
+    double vx, vy;
+    double sum_x, sum_y, sum_err; // Running totals of the modelled change and its bound
+    double cx[3], cy[3];    // Change from each thruster this tick
+  } hist[DV_WINDOW + 1];
+  long n_hist;              // Ticks in the ring
+  long since;               // Ticks since the window was last restarted
+};
+
+#endif
@@ -0,0 +1,173 @@
+/*
+	Headless driver for the lander controller.
+
+	Implements the interface in Lander_Control.h on top of one
+	LanderSim (see Lander_Sim.h) and flies a single landing with no
+	window and no display throttling.
+
+	Usage: Lander_Headless [-s seed] [-t max_time] [-q] [-r] [-d trace] [-p policy] [-P params] [-a] MapName FailMode [component1] ...
+
+	MapName, FailMode and the component list are the same as for
+	Lander_Control (see the header of Lander.cpp). The seed makes the
+	run repeatable, by default it is taken from the clock. -r also prints
+	how many times per tick the flight computer called each sensor. -d
+	runs the flight recorder and writes its trace to the given file if
+	the lander crashes (see Lander_Recorder.h, Lander_Trace renders it).
+	-p flies by a policy table instead of the hand-coded velocity limits
+	(see Lander_Policy.h). -P flies with the gains in a parameter file
+	(see Lander_Params.h) instead of lander.params or the defaults. -a
+	locates the touchdown within its step (see Sim_Set_Exact_Contact).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Lander_Sim.h"
+#include "Lander_Recorder.h"
+
+/*
+  Global variables accessible to the flight computer
+*/
+int MT_OK;
+int RT_OK;
+int LT_OK;
+double PLAT_X;
+double PLAT_Y;
+double SONAR_DIST[36];
+
+static LanderSim sim;
+
+/*
+  Flight controls
+*/
+void Main_Thruster(double power) { Sim_Main_Thruster(&sim, power); }
+void Left_Thruster(double power) { Sim_Left_Thruster(&sim, power); }
+void Right_Thruster(double power) { Sim_Right_Thruster(&sim, power); }
+void Rotate(double angle) { Sim_Rotate(&sim, angle); }
+double Velocity_X(void) { return Sim_Velocity_X(&sim); }
+double Velocity_Y(void) { return Sim_Velocity_Y(&sim); }
+double Position_X(void) { return Sim_Position_X(&sim); }
+double Position_Y(void) { return Sim_Position_Y(&sim); }
+double Angle(void) { return Sim_Angle(&sim); }
+double RangeDist(void) { return Sim_RangeDist(&sim); }
+
+static void Usage(void) {
+  fprintf(stderr, "Usage: Lander_Headless [-s seed] [-t max_time] [-q] [-r] [-d trace] [-p policy] [-P params] [-a] MapName FailMode [component1] [component2] ... [component9]\n");
+  fprintf(stderr, "See header of Lander.cpp for details\n");
+}
+
+int main(int argc, char *argv[]) {
+  long seed = (long)time(NULL);
+  double max_time = 300;
+  int quiet = 0;
+  int show_reads = 0;
+  const char *trace_name = NULL;
+  const char *policy_name = NULL;
+  const char *params_name = NULL;
+  int exact_contact = 0;
+
+  int a = 1;
+  while (a < argc && argv[a][0] == '-') {
+    if (!strcmp(argv[a], "-s") && a + 1 < argc) seed = strtol(argv[++a], NULL, 10);
+    else if (!strcmp(argv[a], "-t") && a + 1 < argc) max_time = atof(argv[++a]);
+    else if (!strcmp(argv[a], "-q")) quiet = 1;
+    else if (!strcmp(argv[a], "-r")) show_reads = 1;
+    else if (!strcmp(argv[a], "-d") && a + 1 < argc) trace_name = argv[++a];
+    else if (!strcmp(argv[a], "-p") && a + 1 < argc) policy_name = argv[++a];
+    else if (!strcmp(argv[a], "-P") && a + 1 < argc) params_name = argv[++a];
+    else if (!strcmp(argv[a], "-a")) exact_contact = 1;
+    else {
+      Usage();
+      return 1;
+    }
+    a++;
+  }
+  if (argc - a < 2) {
+    Usage();
+    return 1;
+  }
+
+  const char *map_name = argv[a];
+  int fail_mode = (int)strtol(argv[a + 1], NULL, 10);
+  int comps[N_COMP];
+  int ncomps = 0;
+  for (int i = a + 2; i < argc && ncomps < N_COMP; i++)
+    comps[ncomps++] = (int)strtol(argv[i], NULL, 10);
+
+  LanderMap map;
+  LanderShape shape;
+  if (!Sim_Load_Map(map_name, &map)) {
+    fprintf(stderr, "Unable to open map image %s, please check name and path\n", map_name);
+    return 1;
+  }
+  if (!Sim_Load_Shape("lander.ppm", &shape)) {
+    fprintf(stderr, "Unable to load lander image. Ensure it is in the same directory\n");
+    return 1;
+  }
+
+  static LanderPolicy policy;
+  if (policy_name != NULL) {
+    if (!Policy_Map(policy_name, &policy)) return 1;
+    Default_Controller()->Set_Policy(&policy);
+  }
+  if (params_name != NULL) {
+    ControllerParams params;
+    Params_Default(&params);
+    if (!Params_Load(params_name, &params)) return 1;
+    Default_Controller()->Set_Params(&params);
+  }
+
+  Sim_Reset(&sim, &map, &shape, fail_mode, comps, ncomps, seed);
+  sim.max_time = max_time;
+  Sim_Set_Exact_Contact(&sim, exact_contact);
+  sim.verbose = !quiet;
+  PLAT_X = map.plat_x;
+  PLAT_Y = map.plat_y;
+
+  FlightRecorder rec;
+  if (trace_name != NULL && !Recorder_Init(&rec)) {
+    fprintf(stderr, "Out of memory allocating the flight recorder\n");
+    return 1;
+  }
+
+  clock_t t0 = clock();
+  while (sim.status == SIM_FLYING) {
+    MT_OK = sim.MT_OK;
+    RT_OK = sim.RT_OK;
+    LT_OK = sim.LT_OK;
+    memcpy(SONAR_DIST, sim.sonar, sizeof(SONAR_DIST));
+
+    Lander_Control();
+    Safety_Override();
+    if (trace_name != NULL) Recorder_Capture(&rec, &sim, Default_Controller());
+    Sim_Step(&sim);
+  }
+  double wall = (double)(clock() - t0) / CLOCKS_PER_SEC;
+
+  if (trace_name != NULL) {
+    if (sim.status == SIM_CRASHED && Recorder_Flush(&rec, &sim, map_name, seed, trace_name) && !quiet)
+      fprintf(stderr, "Flight trace written to %s\n", trace_name);
+    Recorder_Free(&rec);
+  }
+
+  if (!quiet) {
+    if (sim.status == SIM_LANDED) fprintf(stderr, "We have landing!\n");
+    else if (sim.status == SIM_CRASHED) fprintf(stderr, "The Lander Has Crashed!\n");
+    else if (sim.status == SIM_LOST) fprintf(stderr, "Elvis has left the building!\n");
+  }
+  printf("map=%s mode=%d seed=%ld status=%s time=%.3f vx=%.3f vy=%.3f angle=%.2f ticks=%ld wall_ms=%.3f\n",
+         map_name, fail_mode, seed, Sim_Status_Name(sim.status), sim.sim_time,
+         sim.td_vx, sim.td_vy, sim.td_angle, sim.ticks, wall * 1000);
+  if (show_reads) {
+    printf("reads/tick");
+    for (int i = 0; i < N_SENS; i++)
+      printf(" %s=%.2f", Sim_Sensor_Name(i), (double)sim.reads[i] / sim.ticks);
+    printf("\n");
+  }
+
+  Recorder_Wait();
+  Sim_Free_Map(&map);
+  return sim.status == SIM_LANDED ? 0 : 2;
+}
@@ -0,0 +1,114 @@
+/*
+	Fixed-window sensor history.
+
+	SensorHistory<N, Profile> keeps the last N samples of a signal in a
+	ring buffer together with running sums, so the weighted average,
+	mean, variance and trend are all O(1) per sample whatever the
+	window length. The weight profile is a compile-time choice:
+
+	  UniformWeights - every sample in the window counts the same
+	  LinearWeights  - newest sample weighs N, oldest weighs 1 (the
+	                   weighting of the original 5-sample filters)
+
+	The running sums are rebuilt from the buffer every RECOMPUTE
+	windows so rounding errors cannot build up over a long flight.
+*/
+
+#ifndef _LANDER_HISTORY_H
+#define _LANDER_HISTORY_H
+
+#include <math.h>
+
+struct UniformWeights {
+  static constexpr bool linear = false;
+};
+
+struct LinearWeights {
+  static constexpr bool linear = true;
+};
+
+template <int N, class Profile = LinearWeights>
+class SensorHistory {
+  static_assert(N > 1, "SensorHistory needs at least two samples");
+
+ public:
+  static constexpr int RECOMPUTE = 64;
+  static constexpr double WEIGHT_TOTAL = Profile::linear ? N * (N + 1) / 2.0 : N;
+
+  SensorHistory() { Reset(0); }
+
+  // Fill the whole window with one value
+  void Reset(double value) {
+    for (int i = 0; i < N; i++) buf[i] = value;
+    head = 0;
+    pushes = 0;
+    Recompute();
+  }
+
+  void Push(double x) {
+    double old = buf[head];
+    buf[head] = x;
+    head = head + 1 == N ? 0 : head + 1;
+
+    // Every sample already in the window loses one unit of weight, the
+    // oldest drops out with the last of it
+    wsum += N * x - sum;
+    sum += x - old;
+    sumsq += x * x - old * old;
+
+    if (++pushes >= RECOMPUTE * N) {
+      pushes = 0;
+      Recompute();
+    }
+  }
+
+  // Weighted average according to the profile
+  double Average() const {
+    return (Profile::linear ? wsum : sum) / WEIGHT_TOTAL;
+  }
+
+  double Mean() const { return sum / N; }
+
+  double Variance() const {
+    double v = (sumsq - sum * sum / N) / (N - 1);
+    return v > 0 ? v : 0;
+  }
+
+  // Least-squares slope of the window, per sample
+  double Trend() const {
+    // With samples indexed 0 (oldest) to N-1 (newest), wsum - sum is
+    // sum(i * x_i)
+    double sxy = (wsum - sum) - (N - 1) / 2.0 * sum;
+    return sxy / (N * ((double)N * N - 1) / 12);
+  }
+
+  // Newest sample, or the one k samples before it
+  double Latest(int k = 0) const {
+    int i = head - 1 - k;
+    while (i < 0) i += N;
+    return buf[i];
+  }
+
+  // True if x is more than k standard deviations from the average
+  bool Is_Outlier(double x, double k) const {
+    return fabs(x - Average()) > k * sqrt(Variance());
+  }
+
+ private:
+  void Recompute() {
+    sum = wsum = sumsq = 0;
+    for (int k = 0; k < N; k++) {
+      double x = Latest(k);
+      sum += x;
+      wsum += (N - k) * x;
+      sumsq += x * x;
+    }
+  }
+
+  double buf[N];
+  int head;
+  int pushes;
+  double sum, wsum, sumsq;
+};
+
+#endif
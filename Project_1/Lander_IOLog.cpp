@@ -0,0 +1,119 @@
+/*
+	Flight computer IO logs - see Lander_IOLog.h
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Lander_IOLog.h"
+
+const char *IOLog_Event_Name(int type) {
+  static const char *names[N_EV] = {
+    "Velocity_X", "Velocity_Y", "Position_X", "Position_Y", "Angle", "RangeDist",
+    "MT_OK", "RT_OK", "LT_OK", "PLAT_X", "PLAT_Y", "SONAR_DIST",
+    "Main_Thruster", "Left_Thruster", "Right_Thruster", "Rotate", "end of tick"
+  };
+  if (type < 0 || type >= N_EV) return "unknown";
+  return names[type];
+}
+
+/*
+  Files
+*/
+
+int IOLog_Save(const char *fname, const IOLogHeader *head, const std::vector<IOEvent> *events) {
+  FILE *f = fopen(fname, "wb");
+  if (f == NULL) {
+    fprintf(stderr, "Unable to open file %s for writing\n", fname);
+    return 0;
+  }
+  int ok = fwrite(head, sizeof(IOLogHeader), 1, f) == 1 &&
+           fwrite(events->data(), sizeof(IOEvent), events->size(), f) == events->size();
+  if (fclose(f) != 0) ok = 0;
+  if (!ok) fprintf(stderr, "Failed to write IO log %s\n", fname);
+  return ok;
+}
+
+int IOLog_Load(const char *fname, IOLogHeader *head, std::vector<IOEvent> *events) {
+  FILE *f = fopen(fname, "rb");
+  if (f == NULL) {
+    fprintf(stderr, "Unable to open file %s for reading, please check name and path\n", fname);
+    return 0;
+  }
+  if (fread(head, sizeof(IOLogHeader), 1, f) != 1 || memcmp(head->magic, "LIOL", 4) ||
+      head->version != IOLOG_VERSION || head->nevents < 0) {
+    fprintf(stderr, "%s is not an IO log of this version\n", fname);
+    fclose(f);
+    return 0;
+  }
+  head->map_name[sizeof(head->map_name) - 1] = '\0';
+  events->resize(head->nevents);
+  if (fread(events->data(), sizeof(IOEvent), head->nevents, f) != (size_t)head->nevents) {
+    fprintf(stderr, "Failed to read events from %s\n", fname);
+    fclose(f);
+    return 0;
+  }
+  fclose(f);
+  return 1;
+}
+
+/*
+  Recording
+*/
+
+double RecordIO::Log(int type, int index, double v) {
+  IOEvent e;
+  e.type = (short)type;
+  e.index = (short)index;
+  e.tick = tick;
+  e.v = v;
+  events->push_back(e);
+  return v;
+}
+
+const double *RecordIO::SONAR_DIST() {
+  const double *sonar = io->SONAR_DIST();
+  for (int i = 0; i < 36; i++) Log(EV_SONAR, i, sonar[i]);
+  return sonar;
+}
+
+/*
+  Replay
+*/
+
+void ReplayIO::Diverge(const char *what) {
+  if (diverged) return;
+  diverged = true;
+  const IOEvent *e = Finished() ? NULL : &(*events)[pos];
+  if (e == NULL) snprintf(why, sizeof(why), "tick %d: %s, but the log has ended", tick, what);
+  else if (e->type == EV_MAIN || e->type == EV_LEFT || e->type == EV_RIGHT || e->type == EV_ROTATE)
+    snprintf(why, sizeof(why), "tick %d: %s, the log has %s(%.17g)", tick, what, IOLog_Event_Name(e->type), e->v);
+  else snprintf(why, sizeof(why), "tick %d: %s, the log has %s", tick, what, IOLog_Event_Name(e->type));
+}
+
+double ReplayIO::Expect(int type, int index) {
+  if (diverged) return 0;
+  if (Finished() || (*events)[pos].type != type || (*events)[pos].index != index) {
+    char what[64];
+    snprintf(what, sizeof(what), "controller called %s", IOLog_Event_Name(type));
+    Diverge(what);
+    return 0;
+  }
+  return (*events)[pos++].v;
+}
+
+void ReplayIO::Command(int type, double v) {
+  if (diverged) return;
+  if (Finished() || (*events)[pos].type != type || memcmp(&(*events)[pos].v, &v, sizeof(double))) {
+    char what[96];
+    snprintf(what, sizeof(what), "controller called %s(%.17g)", IOLog_Event_Name(type), v);
+    Diverge(what);
+    return;
+  }
+  pos++;
+}
+
+const double *ReplayIO::SONAR_DIST() {
+  for (int i = 0; i < 36; i++) sonar[i] = Expect(EV_SONAR, i);
+  return sonar;
+}
@@ -0,0 +1,148 @@
+/*
+	Exact flight computer IO logs, for deterministic replay.
+
+	RecordIO sits between a controller and its real LanderIO and logs
+	every call the controller makes, in order, with the full double
+	value: each sensor reading, the flight computer variables, the sonar
+	array and each command. ReplayIO plays such a log back to a fresh
+	controller with no simulator behind it: sensor calls return the
+	logged values, command calls are compared bit for bit with the
+	logged commands. The first call that differs (a different command,
+	a different value, or a call the log does not have at that point)
+	ends the replay and is reported as the divergence.
+
+	So a landing recorded once can be replayed against any build of the
+	controller in milliseconds, and a controller change shows up as the
+	exact tick and call where its behaviour first departs from the log.
+*/
+
+#ifndef _LANDER_IOLOG_H
+#define _LANDER_IOLOG_H
+
+#include <vector>
+
+#include "Lander_Sim.h"
+
+#define IOLOG_VERSION 2
+
+// Event types. Sensors use their SENS_* number
+#define EV_MT_OK 6
+#define EV_RT_OK 7
+#define EV_LT_OK 8
+#define EV_PLAT_X 9
+#define EV_PLAT_Y 10
+#define EV_SONAR 11             // One event per beam, index is the beam
+#define EV_MAIN 12
+#define EV_LEFT 13
+#define EV_RIGHT 14
+#define EV_ROTATE 15
+#define EV_TICK 16              // End of a tick
+#define N_EV 17
+
+struct IOEvent {
+  short type;
+  short index;
+  int tick;
+  double v;
+};
+
+// Log file header, followed by nevents IOEvents
+struct IOLogHeader {
+  char magic[4];                // "LIOL"
+  int version;
+  char map_name[256];
+  int fail_mode;
+  int f_list[N_COMP];           // Mode 3 components, 1 = disabled
+  long seed;
+  double max_time;
+  int exact_contact;            // See Sim_Set_Exact_Contact
+  char policy_name[256];        // Policy table flown, empty for the velocity limits
+  unsigned long long policy_sum;  // FNV-1a of the table
+  ControllerParams params;      // Gains flown
+  int status;                   // How the recorded flight ended (SIM_*)
+  int ticks;
+  long nevents;
+};
+
+const char *IOLog_Event_Name(int type);
+
+int IOLog_Save(const char *fname, const IOLogHeader *head, const std::vector<IOEvent> *events);
+int IOLog_Load(const char *fname, IOLogHeader *head, std::vector<IOEvent> *events);
+
+// Logs every call made through it, then passes it on to io
+class RecordIO : public LanderIO {
+ public:
+  RecordIO(LanderIO *io, std::vector<IOEvent> *events) : io(io), events(events), tick(0) {}
+
+  // Marks the end of a tick, call after Safety_Override()
+  void End_Tick() { Log(EV_TICK, 0, 0); tick++; }
+
+  void Main_Thruster(double power) { Log(EV_MAIN, 0, power); io->Main_Thruster(power); }
+  void Left_Thruster(double power) { Log(EV_LEFT, 0, power); io->Left_Thruster(power); }
+  void Right_Thruster(double power) { Log(EV_RIGHT, 0, power); io->Right_Thruster(power); }
+  void Rotate(double angle) { Log(EV_ROTATE, 0, angle); io->Rotate(angle); }
+  double Velocity_X() { return Log(SENS_VEL_X, 0, io->Velocity_X()); }
+  double Velocity_Y() { return Log(SENS_VEL_Y, 0, io->Velocity_Y()); }
+  double Position_X() { return Log(SENS_POS_X, 0, io->Position_X()); }
+  double Position_Y() { return Log(SENS_POS_Y, 0, io->Position_Y()); }
+  double Angle() { return Log(SENS_ANGLE, 0, io->Angle()); }
+  double RangeDist() { return Log(SENS_RANGE, 0, io->RangeDist()); }
+  int MT_OK() { return (int)Log(EV_MT_OK, 0, io->MT_OK()); }
+  int RT_OK() { return (int)Log(EV_RT_OK, 0, io->RT_OK()); }
+  int LT_OK() { return (int)Log(EV_LT_OK, 0, io->LT_OK()); }
+  double PLAT_X() { return Log(EV_PLAT_X, 0, io->PLAT_X()); }
+  double PLAT_Y() { return Log(EV_PLAT_Y, 0, io->PLAT_Y()); }
+  const double *SONAR_DIST();
+
+ private:
+  double Log(int type, int index, double v);
+
+  LanderIO *io;
+  std::vector<IOEvent> *events;
+  int tick;
+};
+
+// Plays a log back and checks the commands against it
+class ReplayIO : public LanderIO {
+ public:
+  ReplayIO(const std::vector<IOEvent> *events) : events(events), pos(0), tick(0), diverged(false) { why[0] = '\0'; }
+
+  // Checks that the controller made no more calls this tick than the log
+  void End_Tick() { Expect(EV_TICK, 0); if (!diverged) tick++; }
+
+  bool Diverged() const { return diverged; }
+  const char *Divergence() const { return why; }
+  int Tick() const { return tick; }
+  bool Finished() const { return pos >= (long)events->size(); }
+
+  void Main_Thruster(double power) { Command(EV_MAIN, power); }
+  void Left_Thruster(double power) { Command(EV_LEFT, power); }
+  void Right_Thruster(double power) { Command(EV_RIGHT, power); }
+  void Rotate(double angle) { Command(EV_ROTATE, angle); }
+  double Velocity_X() { return Expect(SENS_VEL_X, 0); }
+  double Velocity_Y() { return Expect(SENS_VEL_Y, 0); }
+  double Position_X() { return Expect(SENS_POS_X, 0); }
+  double Position_Y() { return Expect(SENS_POS_Y, 0); }
+  double Angle() { return Expect(SENS_ANGLE, 0); }
+  double RangeDist() { return Expect(SENS_RANGE, 0); }
+  int MT_OK() { return (int)Expect(EV_MT_OK, 0); }
+  int RT_OK() { return (int)Expect(EV_RT_OK, 0); }
+  int LT_OK() { return (int)Expect(EV_LT_OK, 0); }
+  double PLAT_X() { return Expect(EV_PLAT_X, 0); }
+  double PLAT_Y() { return Expect(EV_PLAT_Y, 0); }
+  const double *SONAR_DIST();
+
+ private:
+  double Expect(int type, int index);
+  void Command(int type, double v);
+  void Diverge(const char *what);
+
+  const std::vector<IOEvent> *events;
+  long pos;
+  int tick;
+  bool diverged;
+  char why[256];
+  double sonar[36];
+};
+
+#endif
@@ -0,0 +1,222 @@
+/*
+	Lockstep decision kernels - see Lander_Kernel.h
+
+	The kernels themselves are in Lander_Kernel_Body.h, which is
+	compiled here three times: for AVX-512 and AVX2 (under a GCC target
+	pragma, so the rest of the program needs no special flags) and as
+	plain scalar code.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <immintrin.h>
+
+#include "Lander_Kernel.h"
+
+// Widest vector, in doubles. Lane arrays are padded to a multiple of it
+#define MAX_WIDTH 8
+
+// Horizontal clearance of the sector override: the distance limit
+// scaled by |vx| / KERNEL_HSPEED_REF, but not below KERNEL_HDIST_MIN of
+// it. LanderController no longer flies this override, so these are not
+// in ControllerParams
+#define KERNEL_HSPEED_REF 5.0
+#define KERNEL_HDIST_MIN .25
+
+/*
+  Scalar
+*/
+
+namespace scalar {
+typedef double V;
+typedef bool M;
+static const int W = 1;
+static inline V Load(const double *p) { return *p; }
+static inline void Store(double *p, V a) { *p = a; }
+static inline V Set(double a) { return a; }
+static inline V Add(V a, V b) { return a + b; }
+static inline V Sub(V a, V b) { return a - b; }
+static inline V Mul(V a, V b) { return a * b; }
+static inline V Div(V a, V b) { return a / b; }
+static inline V Abs(V a) { return fabs(a); }
+static inline V Min(V a, V b) { return a < b ? a : b; }
+static inline V Max(V a, V b) { return a > b ? a : b; }
+static inline M Gt(V a, V b) { return a > b; }
+static inline M Lt(V a, V b) { return a < b; }
+static inline M Ge(V a, V b) { return a >= b; }
+static inline M And(M a, M b) { return a && b; }
+static inline M Or(M a, M b) { return a || b; }
+static inline M Not(M a) { return !a; }
+static inline V Blend(M m, V a, V b) { return m ? a : b; }
+#include "Lander_Kernel_Body.h"
+}
+
+/*
+  AVX2
+*/
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+namespace avx2 {
+typedef __m256d V;
+typedef __m256d M;
+static const int W = 4;
+static inline V Load(const double *p) { return _mm256_loadu_pd(p); }
+static inline void Store(double *p, V a) { _mm256_storeu_pd(p, a); }
+static inline V Set(double a) { return _mm256_set1_pd(a); }
+static inline V Add(V a, V b) { return _mm256_add_pd(a, b); }
+static inline V Sub(V a, V b) { return _mm256_sub_pd(a, b); }
+static inline V Mul(V a, V b) { return _mm256_mul_pd(a, b); }
+static inline V Div(V a, V b) { return _mm256_div_pd(a, b); }
+static inline V Abs(V a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+static inline V Min(V a, V b) { return _mm256_min_pd(a, b); }
+static inline V Max(V a, V b) { return _mm256_max_pd(a, b); }
+static inline M Gt(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+static inline M Lt(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+static inline M Ge(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+static inline M And(M a, M b) { return _mm256_and_pd(a, b); }
+static inline M Or(M a, M b) { return _mm256_or_pd(a, b); }
+static inline M Not(M a) { return _mm256_xor_pd(a, _mm256_castsi256_pd(_mm256_set1_epi64x(-1))); }
+static inline V Blend(M m, V a, V b) { return _mm256_blendv_pd(b, a, m); }
+#include "Lander_Kernel_Body.h"
+}
+#pragma GCC pop_options
+
+/*
+  AVX-512
+*/
+
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+namespace avx512 {
+typedef __m512d V;
+typedef __mmask8 M;
+static const int W = 8;
+static inline V Load(const double *p) { return _mm512_loadu_pd(p); }
+static inline void Store(double *p, V a) { _mm512_storeu_pd(p, a); }
+static inline V Set(double a) { return _mm512_set1_pd(a); }
+static inline V Add(V a, V b) { return _mm512_add_pd(a, b); }
+static inline V Sub(V a, V b) { return _mm512_sub_pd(a, b); }
+static inline V Mul(V a, V b) { return _mm512_mul_pd(a, b); }
+static inline V Div(V a, V b) { return _mm512_div_pd(a, b); }
+static inline V Abs(V a) { return _mm512_abs_pd(a); }
+// Every lane of the masked forms is written, the zero source only keeps
+// GCC from warning about the undefined one the plain forms pass
+static inline V Min(V a, V b) { return _mm512_mask_min_pd(_mm512_setzero_pd(), (M)0xff, a, b); }
+static inline V Max(V a, V b) { return _mm512_mask_max_pd(_mm512_setzero_pd(), (M)0xff, a, b); }
+static inline M Gt(V a, V b) { return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ); }
+static inline M Lt(V a, V b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+static inline M Ge(V a, V b) { return _mm512_cmp_pd_mask(a, b, _CMP_GE_OQ); }
+static inline M And(M a, M b) { return a & b; }
+static inline M Or(M a, M b) { return a | b; }
+static inline M Not(M a) { return (M)~a; }
+static inline V Blend(M m, V a, V b) { return _mm512_mask_blend_pd(m, b, a); }
+#include "Lander_Kernel_Body.h"
+}
+#pragma GCC pop_options
+
+/*
+  Lane storage
+*/
+
+int Lanes_Alloc(LanderLanes *lanes, int n) {
+  memset(lanes, 0, sizeof(LanderLanes));
+  int cap = (n + MAX_WIDTH - 1) / MAX_WIDTH * MAX_WIDTH;
+  double **arrays[] = {
+    &lanes->px, &lanes->py, &lanes->vx, &lanes->vy, &lanes->angle,
+    &lanes->plat_x, &lanes->plat_y,
+    &lanes->sec_right, &lanes->sec_left, &lanes->sec_up, &lanes->sec_down,
+    &lanes->main_pw, &lanes->left_pw, &lanes->right_pw, &lanes->rotate, &lanes->rot_cmd
+  };
+  for (size_t k = 0; k < sizeof(arrays) / sizeof(arrays[0]); k++) {
+    *arrays[k] = (double *)aligned_alloc(MAX_WIDTH * sizeof(double), cap * sizeof(double));
+    if (*arrays[k] == NULL) {
+      Lanes_Free(lanes);
+      return 0;
+    }
+    memset(*arrays[k], 0, cap * sizeof(double));
+  }
+  lanes->n = n;
+  lanes->cap = cap;
+  return 1;
+}
+
+void Lanes_Free(LanderLanes *lanes) {
+  free(lanes->px); free(lanes->py); free(lanes->vx); free(lanes->vy); free(lanes->angle);
+  free(lanes->plat_x); free(lanes->plat_y);
+  free(lanes->sec_right); free(lanes->sec_left); free(lanes->sec_up); free(lanes->sec_down);
+  free(lanes->main_pw); free(lanes->left_pw); free(lanes->right_pw);
+  free(lanes->rotate); free(lanes->rot_cmd);
+  memset(lanes, 0, sizeof(LanderLanes));
+}
+
+void Lanes_Copy(LanderLanes *dst, const LanderLanes *src) {
+  size_t len = src->cap * sizeof(double);
+  memcpy(dst->px, src->px, len); memcpy(dst->py, src->py, len);
+  memcpy(dst->vx, src->vx, len); memcpy(dst->vy, src->vy, len);
+  memcpy(dst->angle, src->angle, len);
+  memcpy(dst->plat_x, src->plat_x, len); memcpy(dst->plat_y, src->plat_y, len);
+  memcpy(dst->sec_right, src->sec_right, len); memcpy(dst->sec_left, src->sec_left, len);
+  memcpy(dst->sec_up, src->sec_up, len); memcpy(dst->sec_down, src->sec_down, len);
+  memcpy(dst->main_pw, src->main_pw, len); memcpy(dst->left_pw, src->left_pw, len);
+  memcpy(dst->right_pw, src->right_pw, len);
+  memcpy(dst->rotate, src->rotate, len); memcpy(dst->rot_cmd, src->rot_cmd, len);
+}
+
+void Lanes_Begin_Tick(LanderLanes *lanes) {
+  memset(lanes->rot_cmd, 0, lanes->cap * sizeof(double));
+}
+
+void Lanes_Set_Sonar(LanderLanes *lanes, int i, const double *sonar) {
+  double dist[N_SECTOR];
+  int beam[N_SECTOR];
+  Sonar_Reduce(sonar, dist, beam);
+  lanes->sec_right[i] = dist[SECTOR_RIGHT];
+  lanes->sec_left[i] = dist[SECTOR_LEFT];
+  lanes->sec_up[i] = dist[SECTOR_UP];
+  lanes->sec_down[i] = dist[SECTOR_DOWN];
+}
+
+/*
+  Dispatch
+*/
+
+int Kernel_Best_ISA(void) {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) return KERNEL_AVX512;
+  if (__builtin_cpu_supports("avx2")) return KERNEL_AVX2;
+  return KERNEL_SCALAR;
+}
+
+const char *Kernel_ISA_Name(int isa) {
+  switch (isa) {
+    case KERNEL_AUTO: return Kernel_ISA_Name(Kernel_Best_ISA());
+    case KERNEL_SCALAR: return "scalar";
+    case KERNEL_AVX2: return "avx2";
+    case KERNEL_AVX512: return "avx512";
+  }
+  return "unknown";
+}
+
+int Kernel_Resolve_ISA(int isa) {
+  int best = Kernel_Best_ISA();
+  if (isa == KERNEL_AUTO || isa > best) return best;
+  return isa;
+}
+
+void Kernel_Control(LanderLanes *lanes, const ControllerParams *params, int isa) {
+  switch (Kernel_Resolve_ISA(isa)) {
+    case KERNEL_AVX512: avx512::Control_Lanes(lanes, params); break;
+    case KERNEL_AVX2: avx2::Control_Lanes(lanes, params); break;
+    default: scalar::Control_Lanes(lanes, params); break;
+  }
+}
+
+void Kernel_Safety(LanderLanes *lanes, const ControllerParams *params, int isa) {
+  switch (Kernel_Resolve_ISA(isa)) {
+    case KERNEL_AVX512: avx512::Safety_Lanes(lanes, params); break;
+    case KERNEL_AVX2: avx2::Safety_Lanes(lanes, params); break;
+    default: scalar::Safety_Lanes(lanes, params); break;
+  }
+}
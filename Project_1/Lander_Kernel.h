@@ -0,0 +1,81 @@
+/*
+	Vectorized flight computer decisions for many landers in lockstep.
+
+	LanderLanes holds one lane per lander in structure-of-arrays form.
+	Kernel_Control() and Kernel_Safety() apply the decision logic of
+	LanderController::Lander_Control() and Safety_Override() to every
+	lane at once, without branches: the velocity limit tiers, the
+	overshoot test that stops the descent, the thruster selection and
+	the rotate-first rule are all computed as lane masks and blends.
+	That is the logic of the nominal flight phases (Lander_Phase.h),
+	the thruster-out recovery phases and the climb without the sonar
+	have no kernel. Kernel_Safety() keeps the sector distance
+	thresholds the override had before it predicted the flight path
+	(Lander_Predict.h). The kernels model the base controller only,
+	they do not fly like LanderController does now.
+
+	The caller supplies the state estimates (and, for the safety
+	kernel, the nearest sonar return in each sector), the kernels
+	write the commands. Lanes whose controller holds its previous
+	command keep whatever is already in the output arrays.
+
+	Kernels exist for AVX-512, AVX2 and plain scalar code, the fastest
+	one the CPU supports is picked at run time.
+*/
+
+#ifndef _LANDER_KERNEL_H
+#define _LANDER_KERNEL_H
+
+#include "Lander_Sonar.h"
+#include "Lander_Params.h"
+
+// Instruction sets
+#define KERNEL_AUTO 0
+#define KERNEL_SCALAR 1
+#define KERNEL_AVX2 2
+#define KERNEL_AVX512 3
+
+struct LanderLanes {
+  int n;            // Landers in use
+  int cap;          // Allocated lanes, a multiple of the widest vector
+
+  // Inputs: state estimates (pixels, m/s, degrees) and platform
+  double *px, *py, *vx, *vy, *angle;
+  double *plat_x, *plat_y;
+
+  // Safety inputs: nearest sonar return per sector, SECTOR_CLEAR if none.
+  // right: beams 5-13, left: 22-31, up: 0-4 and 32-35, down: 14-21
+  double *sec_right, *sec_left, *sec_up, *sec_down;
+
+  // Outputs. rot_cmd is 1 where Rotate(rotate) was called this tick
+  double *main_pw, *left_pw, *right_pw;
+  double *rotate, *rot_cmd;
+};
+
+// Allocate and free the lane arrays, returns 0 on failure. All arrays
+// start zeroed
+int Lanes_Alloc(LanderLanes *lanes, int n);
+void Lanes_Free(LanderLanes *lanes);
+
+// Copy every array of src into dst, which must have the same capacity
+void Lanes_Copy(LanderLanes *dst, const LanderLanes *src);
+
+// Clear rot_cmd for a new tick
+void Lanes_Begin_Tick(LanderLanes *lanes);
+
+// Fill the four sector inputs of one lane from a 36 entry sonar array
+void Lanes_Set_Sonar(LanderLanes *lanes, int i, const double *sonar);
+
+// Run the decision kernels over all lanes, with the velocity limits,
+// overshoot, dist_floor and override_box of params (the other gains
+// belong to phases the kernels do not have). isa is one of KERNEL_*
+void Kernel_Control(LanderLanes *lanes, const ControllerParams *params, int isa);
+void Kernel_Safety(LanderLanes *lanes, const ControllerParams *params, int isa);
+
+// Best instruction set this CPU supports, and the one a request actually
+// runs with (the best available if the CPU lacks the one asked for)
+int Kernel_Best_ISA(void);
+int Kernel_Resolve_ISA(int isa);
+const char *Kernel_ISA_Name(int isa);
+
+#endif
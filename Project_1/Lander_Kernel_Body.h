@@ -0,0 +1,110 @@
+/*
+	Body of the lockstep decision kernels - see Lander_Kernel.h
+
+	No include guard on purpose: Lander_Kernel.cpp includes this file
+	once per instruction set, inside a namespace that provides
+
+	  V, M                  vector of W doubles and its lane mask
+	  Load, Store, Set      memory and broadcast
+	  Add, Sub, Mul, Div    arithmetic
+	  Abs, Min, Max         Min/Max return the second operand when the
+	                        first is NaN, like fmin/fmax with a constant
+	  Gt, Lt, Ge            ordered compares (false on NaN)
+	  And, Or, Not          mask logic
+	  Blend(m, a, b)        m ? a : b per lane
+
+	Expressions are kept in the same order as the scalar code in
+	Lander.cpp so every lane gets bit-identical results. Thresholds
+	come from the ControllerParams passed in, like the controller's.
+*/
+
+// Rotation that brings the lander back to zero degrees
+static inline V Rotate_Back(V ang) {
+  return Blend(Ge(ang, Set(180)), Sub(Set(360), ang), Sub(Set(0), ang));
+}
+
+static void Control_Lanes(LanderLanes *L, const ControllerParams *P) {
+  for (int i = 0; i < L->n; i += W) {
+    V xpr = Load(L->px + i);
+    V ypr = Load(L->py + i);
+    V xvr = Load(L->vx + i);
+    V yvr = Load(L->vy + i);
+    V ang = Load(L->angle + i);
+    V PX = Load(L->plat_x + i);
+    V PY = Load(L->plat_y + i);
+
+    // Velocity limit tiers
+    V dx = Abs(Sub(xpr, PX));
+    V VXlim = Blend(Gt(dx, Set(P->far_x)), Set(P->vx_far), Blend(Gt(dx, Set(P->mid_x)), Set(P->vx_mid), Set(P->vx_near)));
+    V dy = Sub(PY, ypr);
+    V VYlim = Blend(Gt(dy, Set(P->far_y)), Set(-P->vy_far), Blend(Gt(dy, Set(P->mid_y)), Set(-P->vy_mid), Set(-P->vy_near)));
+
+    // Hold the descent if we would land before reaching the platform
+    M over = Gt(Div(Abs(Sub(PX, xpr)), Abs(xvr)), Div(Mul(Set(P->overshoot), Abs(Sub(PY, ypr))), Abs(yvr)));
+    VYlim = Blend(over, Set(0), VYlim);
+
+    // Rotate first, tilted lanes leave the thrusters alone
+    M tilted = And(Gt(ang, Set(1)), Lt(ang, Set(359)));
+    Store(L->rotate + i, Blend(tilted, Rotate_Back(ang), Load(L->rotate + i)));
+    Store(L->rot_cmd + i, Blend(tilted, Set(1), Load(L->rot_cmd + i)));
+
+    // Horizontal thrusters. Right of the platform: push left with the
+    // right thruster, or brake with the left one past the limit
+    V brake = Abs(Sub(VXlim, xvr));
+    M a_ok = Gt(xvr, Sub(Set(0), VXlim));
+    V rA = Blend(a_ok, Div(Add(VXlim, Min(xvr, Set(0))), VXlim), Set(0));
+    V lA = Blend(a_ok, Set(0), brake);
+    M b_ok = Lt(xvr, VXlim);
+    V lB = Blend(b_ok, Div(Sub(VXlim, Max(xvr, Set(0))), VXlim), Set(0));
+    V rB = Blend(b_ok, Set(0), brake);
+    M right_of = Gt(xpr, PX);
+    V left = Blend(right_of, lA, lB);
+    V right = Blend(right_of, rA, rB);
+    V main = Blend(Lt(yvr, VYlim), Set(1), Set(0));
+
+    Store(L->left_pw + i, Blend(tilted, Load(L->left_pw + i), left));
+    Store(L->right_pw + i, Blend(tilted, Load(L->right_pw + i), right));
+    Store(L->main_pw + i, Blend(tilted, Load(L->main_pw + i), main));
+  }
+}
+
+static void Safety_Lanes(LanderLanes *L, const ControllerParams *P) {
+  for (int i = 0; i < L->n; i += W) {
+    V px = Load(L->px + i);
+    V py = Load(L->py + i);
+    V vx = Load(L->vx + i);
+    V vy = Load(L->vy + i);
+    V ang = Load(L->angle + i);
+    V PX = Load(L->plat_x + i);
+    V PY = Load(L->plat_y + i);
+
+    V DistLimit = Max(Add(Mul(vx, vx), Mul(vy, vy)), Set(P->dist_floor));
+
+    // Close to the platform the control policy is trusted
+    M near = And(Lt(Abs(Sub(PX, px)), Set(P->override_box)), Lt(Abs(Sub(PY, py)), Set(P->override_box)));
+    M active = Not(near);
+
+    // Horizontal direction
+    V dmin_h = Blend(Gt(vx, Set(0)), Load(L->sec_right + i), Load(L->sec_left + i));
+    V hlim = Mul(DistLimit, Max(Min(Div(Abs(vx), Set(KERNEL_HSPEED_REF)), Set(1)), Set(KERNEL_HDIST_MIN)));
+    M close_h = And(active, Lt(dmin_h, hlim));
+    M tilted_h = And(Gt(ang, Set(1)), Lt(ang, Set(359)));
+    M rot_h = And(close_h, tilted_h);
+    M thr_h = And(close_h, Not(tilted_h));
+    M pos = Gt(vx, Set(0));
+    Store(L->right_pw + i, Blend(thr_h, Blend(pos, Set(1.0), Set(0.0)), Load(L->right_pw + i)));
+    Store(L->left_pw + i, Blend(thr_h, Blend(pos, Set(0.0), Set(1.0)), Load(L->left_pw + i)));
+
+    // Vertical direction, skipped by lanes that had to rotate above
+    V dmin_v = Blend(Gt(vy, Set(5)), Load(L->sec_up + i), Load(L->sec_down + i));
+    M close_v = And(And(active, Not(rot_h)), Lt(dmin_v, DistLimit));
+    M tilted_v = Or(Gt(ang, Set(1)), Gt(ang, Set(359)));
+    M rot_v = And(close_v, tilted_v);
+    M thr_v = And(close_v, Not(tilted_v));
+    Store(L->main_pw + i, Blend(thr_v, Blend(Gt(vy, Set(2.0)), Set(0.0), Set(1.0)), Load(L->main_pw + i)));
+
+    M rot = Or(rot_h, rot_v);
+    Store(L->rotate + i, Blend(rot, Rotate_Back(ang), Load(L->rotate + i)));
+    Store(L->rot_cmd + i, Blend(rot, Set(1), Load(L->rot_cmd + i)));
+  }
+}
@@ -0,0 +1,237 @@
+/*
+	Lockstep driver for the vectorized decision kernels.
+
+	Flies N landers side by side on one core. Every tick each lander's
+	sensors are read into its StateEstimator, the estimates are laid
+	out in a LanderLanes and one call to Kernel_Control() and
+	Kernel_Safety() decides the commands for all of them (see
+	Lander_Kernel.h). The RangeDist() rays and the sonar beams of all
+	the landers are cast in one batch each (see Lander_Raycast.h), with
+	the same instruction set. Reports the outcomes and the throughput
+	in lander-ticks per second, end to end and for the kernels alone,
+	and the time per lander-tick spent stepping the simulations and
+	casting the RangeDist() rays.
+
+	Usage: Lander_Lockstep [-n N] [-s seed] [-t max_time] [-k isa] [-x] [-P params] MapName FailMode [component1] ...
+
+	isa is auto, scalar, avx2 or avx512. -x also runs the scalar kernel
+	on every tick and counts lanes where its commands differ. -P flies
+	with the gains in a parameter file (see Lander_Params.h) instead of
+	the defaults, the kernels and the estimators alike.
+
+	The kernels fly the base controller: the nominal phases and the
+	sector distance override, without the thruster-out recovery, the
+	climb without the sonar or the predicted-path override of
+	LanderController (see Lander_Kernel.h). Commands are also re-sent
+	every tick (the actuator noise is drawn again even where the
+	controller holds its previous command). So neither individual
+	flights nor the landing rates match Lander_Batch, most of all under
+	thruster failures. This driver measures kernel throughput, and -x
+	checks the instruction sets against each other, not against
+	LanderController.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+
+#include "Lander_Sim.h"
+#include "Lander_Estimator.h"
+#include "Lander_Kernel.h"
+#include "Lander_Raycast.h"
+
+static double Now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Lanes where the commands of a and b differ
+static int Compare_Lanes(const LanderLanes *a, const LanderLanes *b) {
+  int bad = 0;
+  for (int i = 0; i < a->n; i++) {
+    if (memcmp(&a->main_pw[i], &b->main_pw[i], sizeof(double)) ||
+        memcmp(&a->left_pw[i], &b->left_pw[i], sizeof(double)) ||
+        memcmp(&a->right_pw[i], &b->right_pw[i], sizeof(double)) ||
+        a->rot_cmd[i] != b->rot_cmd[i] ||
+        (a->rot_cmd[i] != 0 && a->rotate[i] != b->rotate[i]))
+      bad++;
+  }
+  return bad;
+}
+
+static void Usage(void) {
+  fprintf(stderr, "Usage: Lander_Lockstep [-n N] [-s seed] [-t max_time] [-k isa] [-x] [-P params] MapName FailMode [component1] ... [component9]\n");
+  fprintf(stderr, "  isa is auto, scalar, avx2 or avx512\n");
+}
+
+int main(int argc, char *argv[]) {
+  int n = 1024;
+  long seed = 1;
+  double max_time = 300;
+  int isa = KERNEL_AUTO;
+  int check = 0;
+  ControllerParams params;
+  Params_Default(&params);
+
+  int a = 1;
+  while (a < argc && argv[a][0] == '-') {
+    if (!strcmp(argv[a], "-n") && a + 1 < argc) n = (int)strtol(argv[++a], NULL, 10);
+    else if (!strcmp(argv[a], "-s") && a + 1 < argc) seed = strtol(argv[++a], NULL, 10);
+    else if (!strcmp(argv[a], "-t") && a + 1 < argc) max_time = atof(argv[++a]);
+    else if (!strcmp(argv[a], "-x")) check = 1;
+    else if (!strcmp(argv[a], "-P") && a + 1 < argc) {
+      if (!Params_Load(argv[++a], &params)) return 1;
+    }
+    else if (!strcmp(argv[a], "-k") && a + 1 < argc) {
+      a++;
+      if (!strcmp(argv[a], "auto")) isa = KERNEL_AUTO;
+      else if (!strcmp(argv[a], "scalar")) isa = KERNEL_SCALAR;
+      else if (!strcmp(argv[a], "avx2")) isa = KERNEL_AVX2;
+      else if (!strcmp(argv[a], "avx512")) isa = KERNEL_AVX512;
+      else {
+        Usage();
+        return 1;
+      }
+    }
+    else {
+      Usage();
+      return 1;
+    }
+    a++;
+  }
+  if (argc - a < 2 || n < 1) {
+    Usage();
+    return 1;
+  }
+
+  const char *map_name = argv[a];
+  int fail_mode = (int)strtol(argv[a + 1], NULL, 10);
+  int comps[N_COMP];
+  int ncomps = 0;
+  for (int i = a + 2; i < argc && ncomps < N_COMP; i++)
+    comps[ncomps++] = (int)strtol(argv[i], NULL, 10);
+
+  static LanderMap map;
+  static LanderShape shape;
+  if (!Sim_Load_Map(map_name, &map)) return 1;
+  if (!Sim_Load_Shape("lander.ppm", &shape)) {
+    fprintf(stderr, "Unable to load lander image. Ensure it is in the same directory\n");
+    return 1;
+  }
+
+  std::vector<LanderSim> sims(n);
+  std::vector<StateEstimator> est(n);
+  std::vector<double> range(n);
+  LanderLanes lanes, ref;
+  RayBatch rays;
+  if (!Lanes_Alloc(&lanes, n) || (check && !Lanes_Alloc(&ref, n)) || !Rays_Alloc(&rays, 36 * n)) {
+    fprintf(stderr, "Out of memory\n");
+    return 1;
+  }
+  for (int i = 0; i < n; i++) {
+    Sim_Reset(&sims[i], &map, &shape, fail_mode, comps, ncomps, seed + i);
+    sims[i].max_time = max_time;
+    est[i].Set_Limits(params.gate, params.var_limit, params.bias_limit);
+  }
+
+  isa = Kernel_Resolve_ISA(isa);
+  long lander_ticks = 0;
+  long kernel_lane_ticks = 0;
+  long mismatches = 0;
+  double kernel_time = 0;
+  double ray_time = 0;      // Raycast_Step and Raycast_RangeDist
+  double t0 = Now();
+  int flying = n;
+  while (flying > 0) {
+    // Sense
+    double r0 = Now();
+    Raycast_RangeDist(sims.data(), n, &rays, range.data(), isa);
+    ray_time += Now() - r0;
+    for (int i = 0; i < n; i++) {
+      LanderSim *sim = &sims[i];
+      if (sim->status != SIM_FLYING) continue;
+      SensorSnapshot snap;
+      snap.vx = Sim_Velocity_X(sim);
+      snap.vy = Sim_Velocity_Y(sim);
+      snap.px = Sim_Position_X(sim);
+      snap.py = Sim_Position_Y(sim);
+      snap.angle = Sim_Angle(sim);
+      snap.range = range[i];
+      memcpy(snap.sonar, sim->sonar, sizeof(snap.sonar));
+      snap.MT_OK = sim->MT_OK;
+      snap.RT_OK = sim->RT_OK;
+      snap.LT_OK = sim->LT_OK;
+      snap.plat_x = map.plat_x;
+      snap.plat_y = map.plat_y;
+      est[i].Update(&snap);
+
+      lanes.px[i] = est[i].Position_X();
+      lanes.py[i] = est[i].Position_Y();
+      lanes.vx[i] = est[i].Velocity_X();
+      lanes.vy[i] = est[i].Velocity_Y();
+      lanes.angle[i] = est[i].Angle();
+      lanes.plat_x[i] = snap.plat_x;
+      lanes.plat_y[i] = snap.plat_y;
+      Lanes_Set_Sonar(&lanes, i, snap.sonar);
+    }
+
+    // Decide, for every lane at once
+    Lanes_Begin_Tick(&lanes);
+    if (check) Lanes_Copy(&ref, &lanes);
+    double k0 = Now();
+    Kernel_Control(&lanes, &params, isa);
+    Kernel_Safety(&lanes, &params, isa);
+    kernel_time += Now() - k0;
+    kernel_lane_ticks += lanes.n;
+    if (check) {
+      Kernel_Control(&ref, &params, KERNEL_SCALAR);
+      Kernel_Safety(&ref, &params, KERNEL_SCALAR);
+      mismatches += Compare_Lanes(&lanes, &ref);
+    }
+
+    // Act
+    for (int i = 0; i < n; i++) {
+      LanderSim *sim = &sims[i];
+      if (sim->status != SIM_FLYING) continue;
+      Sim_Main_Thruster(sim, lanes.main_pw[i]);
+      Sim_Left_Thruster(sim, lanes.left_pw[i]);
+      Sim_Right_Thruster(sim, lanes.right_pw[i]);
+      est[i].Command_Main(lanes.main_pw[i]);
+      est[i].Command_Left(lanes.left_pw[i]);
+      est[i].Command_Right(lanes.right_pw[i]);
+      if (lanes.rot_cmd[i] != 0) {
+        Sim_Rotate(sim, lanes.rotate[i]);
+        est[i].Command_Rotate(lanes.rotate[i]);
+      }
+      lander_ticks++;
+    }
+    double s0 = Now();
+    Raycast_Step(sims.data(), n, &rays, isa);
+    ray_time += Now() - s0;
+    flying = 0;
+    for (int i = 0; i < n; i++)
+      if (sims[i].status == SIM_FLYING) flying++;
+  }
+  double wall = Now() - t0;
+
+  int count[SIM_TIMEOUT + 1] = {0};
+  for (int i = 0; i < n; i++) count[sims[i].status]++;
+  printf("map=%s mode=%d landers=%d isa=%s", map_name, fail_mode, n, Kernel_ISA_Name(isa));
+  for (int s = SIM_LANDED; s <= SIM_TIMEOUT; s++) printf(" %s=%d", Sim_Status_Name(s), count[s]);
+  printf("\n");
+  printf("lander_ticks=%ld wall_s=%.3f lander_ticks_per_s=%.0f kernel_lander_ticks_per_s=%.0f (one core)\n",
+         lander_ticks, wall, lander_ticks / wall, kernel_lane_ticks / kernel_time);
+  printf("sim steps and RangeDist, rays batched: %.0f ns per lander-tick, %.1f%% of the wall time\n",
+         ray_time * 1e9 / lander_ticks, 100 * ray_time / wall);
+  if (check) printf("scalar check: %ld mismatched lane-ticks\n", mismatches);
+
+  Lanes_Free(&lanes);
+  Rays_Free(&rays);
+  if (check) Lanes_Free(&ref);
+  Sim_Free_Map(&map);
+  return check && mismatches ? 2 : 0;
+}
@@ -0,0 +1,336 @@
+/*
+	Microbenchmarks for the flight computer hot path.
+
+	Drives LanderController::Lander_Control() and Safety_Override(),
+	the StateEstimator update and the SensorHistory window on their own
+	against canned sensor streams. No simulator, map or GL library is
+	linked: the streams are synthetic descents computed up front, and
+	commands go nowhere, so every run sees exactly the same inputs and
+	the numbers only move when the code does.
+
+	Streams (STREAM_TICKS ticks each):
+	  nominal   - a descent onto the platform with NP1 sensor noise and
+	              sonar returns from the ground below, refreshed once
+	              per sweep as the simulator does
+	  no_sonar  - the same descent with every sonar reading at -1
+	  failure   - the nominal descent where the X position and Y
+	              velocity sensors start returning garbage half way
+
+	Usage: Lander_MicroBench [-r reps] [case ...]
+
+	For each case the stream is replayed reps times (default 7), and the
+	median and fastest ns/tick are reported. Where perf_event_open is
+	allowed, instructions and branch misses per tick are counted too.
+	Cases can be selected by name prefix, e.g. "tick" or "estimator/fail".
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "Lander_Controller.h"
+
+#define STREAM_TICKS 4000
+#define SWEEP_TICKS 50          // Sonar sweep period of the simulator
+#define MAX_REPS 64
+
+// Where the synthetic descents end
+#define BENCH_PLAT_X 494.0
+#define BENCH_PLAT_Y 897.0
+
+/*
+  Canned streams
+*/
+
+struct CannedTick {
+  double vx, vy, px, py, angle, range;
+  double sonar[36];
+  int MT_OK, RT_OK, LT_OK;
+};
+
+// Small deterministic generator, the streams must not depend on libc
+static double Bench_Rand(unsigned long long *s) {
+  *s = *s * 6364136223846793005ULL + 1442695040888963407ULL;
+  return (*s >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double Noisy(unsigned long long *s, double v) {
+  return v + (Bench_Rand(s) - .5) * NP1 * v;
+}
+
+static void Make_Stream(std::vector<CannedTick> *stream, bool sonar, bool failure) {
+  unsigned long long s = 12345;
+  stream->resize(STREAM_TICKS);
+  double x0 = 250, y0 = 80;
+  for (int k = 0; k < STREAM_TICKS; k++) {
+    CannedTick *c = &(*stream)[k];
+    double t = k * T_STEP;
+
+    // Exponential approach to the platform, velocities in m/s (vy up)
+    double ex = exp(-t / 6);
+    double x = BENCH_PLAT_X + (x0 - BENCH_PLAT_X) * ex;
+    double y = BENCH_PLAT_Y - 40 + (y0 - BENCH_PLAT_Y + 40) * ex;
+    double vx = -(x0 - BENCH_PLAT_X) * ex / 6 / S_SCALE;
+    double vy = (y0 - BENCH_PLAT_Y + 40) * ex / 6 / S_SCALE;
+    double ang = 2 * sin(t * 3);
+    if (ang < 0) ang += 360;
+
+    c->vx = Noisy(&s, vx);
+    c->vy = Noisy(&s, vy);
+    c->px = Noisy(&s, x);
+    c->py = Noisy(&s, y);
+    c->angle = ang + (Bench_Rand(&s) - .5) * NP1 * 180 / PI;
+    c->range = BENCH_PLAT_Y - y - 19;
+    if (failure && k >= STREAM_TICKS / 2) {
+      c->px = Bench_Rand(&s) * 1024;
+      c->vy = Bench_Rand(&s) * 50 - 25;
+    }
+    c->MT_OK = c->RT_OK = c->LT_OK = 1;
+
+    // Ground returns below the lander, walls far off to the sides
+    if (k % SWEEP_TICKS != 0) {
+      memcpy(c->sonar, (*stream)[k - 1].sonar, sizeof(c->sonar));
+      continue;
+    }
+    for (int i = 0; i < 36; i++) {
+      double a = i * 10 * PI / 180;
+      double down = -cos(a);
+      double r = -1;
+      if (down > .2) r = (BENCH_PLAT_Y - y) / down;
+      else if (fabs(sin(a)) > .5) r = 300 / fabs(sin(a));
+      c->sonar[i] = sonar && r < 400 ? Noisy(&s, r) : -1;
+    }
+  }
+}
+
+class CannedIO : public LanderIO {
+ public:
+  CannedIO(const std::vector<CannedTick> *stream) : stream(stream), k(0), sink(0) {}
+
+  void Next_Tick() { k++; }
+  void Rewind() { k = 0; }
+
+  void Main_Thruster(double power) { sink += power; }
+  void Left_Thruster(double power) { sink += power; }
+  void Right_Thruster(double power) { sink += power; }
+  void Rotate(double angle) { sink += angle; }
+  double Velocity_X() { return (*stream)[k].vx; }
+  double Velocity_Y() { return (*stream)[k].vy; }
+  double Position_X() { return (*stream)[k].px; }
+  double Position_Y() { return (*stream)[k].py; }
+  double Angle() { return (*stream)[k].angle; }
+  double RangeDist() { return (*stream)[k].range; }
+  int MT_OK() { return (*stream)[k].MT_OK; }
+  int RT_OK() { return (*stream)[k].RT_OK; }
+  int LT_OK() { return (*stream)[k].LT_OK; }
+  double PLAT_X() { return BENCH_PLAT_X; }
+  double PLAT_Y() { return BENCH_PLAT_Y; }
+  const double *SONAR_DIST() { return (*stream)[k].sonar; }
+
+  const std::vector<CannedTick> *stream;
+  int k;
+  double sink;              // Keeps the commands from being optimized out
+};
+
+/*
+  Hardware counters
+*/
+
+struct PerfCounters {
+  int fd_instr, fd_branch;
+};
+
+static int Perf_Open(unsigned long long config, int group) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = config;
+  attr.disabled = group < 0;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+static void Perf_Init(PerfCounters *pc) {
+  pc->fd_instr = Perf_Open(PERF_COUNT_HW_INSTRUCTIONS, -1);
+  pc->fd_branch = pc->fd_instr >= 0 ? Perf_Open(PERF_COUNT_HW_BRANCH_MISSES, pc->fd_instr) : -1;
+  if (pc->fd_branch < 0 && pc->fd_instr >= 0) {
+    close(pc->fd_instr);
+    pc->fd_instr = -1;
+  }
+}
+
+static void Perf_Start(const PerfCounters *pc) {
+  if (pc->fd_instr < 0) return;
+  ioctl(pc->fd_instr, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(pc->fd_instr, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+// Instructions and branch misses since Perf_Start, 0 if unavailable
+static int Perf_Stop(const PerfCounters *pc, double *instr, double *branch) {
+  if (pc->fd_instr < 0) return 0;
+  ioctl(pc->fd_instr, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+  long long vi, vb;
+  if (read(pc->fd_instr, &vi, sizeof(vi)) != sizeof(vi) ||
+      read(pc->fd_branch, &vb, sizeof(vb)) != sizeof(vb))
+    return 0;
+  *instr = (double)vi;
+  *branch = (double)vb;
+  return 1;
+}
+
+/*
+  Cases. Each runs one pass over its stream and returns the ticks done
+*/
+
+static std::vector<CannedTick> streams[3];
+static const char *stream_names[3] = {"nominal", "no_sonar", "failure"};
+
+static long Case_Tick(int st) {
+  static LanderController *controllers[3];
+  static CannedIO *ios[3];
+  if (ios[st] == NULL) {
+    ios[st] = new CannedIO(&streams[st]);
+    controllers[st] = new LanderController(ios[st]);
+  }
+  CannedIO *io = ios[st];
+  LanderController *ctl = controllers[st];
+  io->Rewind();
+  ctl->Reset();
+  for (int k = 0; k < STREAM_TICKS; k++) {
+    ctl->Lander_Control();
+    ctl->Safety_Override();
+    io->Next_Tick();
+  }
+  return STREAM_TICKS;
+}
+
+static long Case_Estimator(int st) {
+  static StateEstimator est;
+  static SensorSnapshot snap;
+  est.Reset();
+  snap.plat_x = BENCH_PLAT_X;
+  snap.plat_y = BENCH_PLAT_Y;
+  snap.MT_OK = snap.RT_OK = snap.LT_OK = 1;
+  for (int k = 0; k < STREAM_TICKS; k++) {
+    const CannedTick *c = &streams[st][k];
+    snap.vx = c->vx;
+    snap.vy = c->vy;
+    snap.px = c->px;
+    snap.py = c->py;
+    snap.angle = c->angle;
+    snap.range = c->range;
+    est.Command_Main(.5);
+    est.Update(&snap);
+  }
+  return STREAM_TICKS;
+}
+
+static volatile double history_sink;
+
+static long Case_History(int st) {
+  static SensorHistory<INNOV_WINDOW, UniformWeights> h;
+  h.Reset(0);
+  double acc = 0;
+  for (int k = 0; k < STREAM_TICKS; k++) {
+    double x = streams[st][k].px;
+    if (!h.Is_Outlier(x, 5)) acc += h.Mean();
+    h.Push(x);
+  }
+  history_sink = acc;
+  return STREAM_TICKS;
+}
+
+struct BenchCase {
+  char name[64];
+  long (*run)(int);
+  int stream;
+};
+
+static double Now_Ns(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static void Usage(void) {
+  fprintf(stderr, "Usage: Lander_MicroBench [-r reps] [case ...]\n");
+}
+
+int main(int argc, char *argv[]) {
+  int reps = 7;
+  int a = 1;
+  while (a < argc && argv[a][0] == '-') {
+    if (!strcmp(argv[a], "-r") && a + 1 < argc) reps = (int)strtol(argv[++a], NULL, 10);
+    else {
+      Usage();
+      return 1;
+    }
+    a++;
+  }
+  if (reps < 1 || reps > MAX_REPS) {
+    Usage();
+    return 1;
+  }
+
+  Make_Stream(&streams[0], true, false);
+  Make_Stream(&streams[1], false, false);
+  Make_Stream(&streams[2], true, true);
+
+  std::vector<BenchCase> cases;
+  const char *kinds[3] = {"tick", "estimator", "history"};
+  long (*runs[3])(int) = {Case_Tick, Case_Estimator, Case_History};
+  for (int c = 0; c < 3; c++) {
+    for (int st = 0; st < 3; st++) {
+      BenchCase bc;
+      snprintf(bc.name, sizeof(bc.name), "%s/%s", kinds[c], stream_names[st]);
+      bc.run = runs[c];
+      bc.stream = st;
+      bool selected = a >= argc;
+      for (int i = a; i < argc; i++)
+        if (!strncmp(bc.name, argv[i], strlen(argv[i]))) selected = true;
+      if (selected) cases.push_back(bc);
+    }
+  }
+
+  PerfCounters pc;
+  Perf_Init(&pc);
+  printf("%-22s %12s %10s %12s %14s\n", "case", "ns/tick p50", "min", "instr/tick", "br-miss/tick");
+  for (size_t c = 0; c < cases.size(); c++) {
+    const BenchCase *bc = &cases[c];
+    bc->run(bc->stream);      // Warm up
+
+    double ns[MAX_REPS];
+    double instr = 0, branch = 0;
+    long ticks = 0;
+    int have_perf = 1;
+    for (int r = 0; r < reps; r++) {
+      double vi = 0, vb = 0;
+      Perf_Start(&pc);
+      double t0 = Now_Ns();
+      long n = bc->run(bc->stream);
+      double t1 = Now_Ns();
+      have_perf &= Perf_Stop(&pc, &vi, &vb);
+      ns[r] = (t1 - t0) / n;
+      instr += vi;
+      branch += vb;
+      ticks += n;
+    }
+    std::sort(ns, ns + reps);
+    printf("%-22s %12.1f %10.1f", bc->name, ns[reps / 2], ns[0]);
+    if (have_perf) printf(" %12.0f %14.2f\n", instr / ticks, branch / ticks);
+    else printf(" %12s %14s\n", "n/a", "n/a");
+  }
+  if (pc.fd_instr < 0) printf("(hardware counters unavailable: perf_event_open refused)\n");
+  return 0;
+}
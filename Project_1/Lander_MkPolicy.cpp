@@ -0,0 +1,390 @@
+/*
+	Policy table solver.
+
+	Computes the control policy tables described in Lander_Policy.h by
+	value iteration. The value of a state is the expected flight time
+	until a safe touchdown on the platform, or CRASH_COST if the lander
+	would come down anywhere else, too fast or tilted. Each decision
+	holds its commands for one step (or as long as a rotation takes),
+	the dynamics are those of the simulator with the constants of
+	Lander_Control.h, and thruster powers are the mean delivered power
+	(.95 of the command plus .025). Values between grid points are
+	interpolated, as the flight computer interpolates the commands.
+
+	The solver knows nothing about the terrain besides the platform, so
+	like the hand-coded controller it is told to stay high until it is
+	close to the platform: flying below LOW_DY away from it costs
+	LOW_COST extra per second. Safety_Override() still watches the sonar.
+
+	Usage: Lander_MkPolicy [-g ndx,ndy,nvx,nvy] [-t step] [-i max_sweeps] [-o policy.lpol]
+
+	The default grid solves in under two minutes on one core.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include <vector>
+
+#include "Lander_Control.h"
+#include "Lander_Policy.h"
+
+// Touchdown: the legs reach 19.5 pixels below the lander's center and
+// the platform top is about 2 pixels above PLAT_Y
+#define TOUCH_DY 21.0
+#define LAND_DX 8.0               // Farthest from the platform center to land (pixels)
+#define LAND_VY 8.0               // Fastest descent to land (m/s), the limit is 10
+#define LAND_ANGLE 15.0           // Most tilt to land (degrees)
+
+#define LOW_DY 120.0
+#define LOW_DX 60.0
+#define LOW_COST 4.0
+#define CRASH_COST 1000.0
+
+#define CONVERGED .001            // Largest value change (s) in a sweep to stop at
+
+// Delivered power for a command of 0 or 1
+#define PW_OFF .025
+#define PW_ON .975
+
+struct Action {
+  int main, left, right;          // Commanded off or full
+  int to;                         // Attitude after the step
+  double dt;
+};
+
+// Interpolation of the successors along one pair of axes: the first of
+// four grid points and their weights
+struct Step {
+  long off;
+  float w[4];
+  unsigned char flag;             // X: close enough to land, Y: touched down
+  unsigned char soft;             // Y: slow enough to land
+};
+
+// Attitudes worth flying with a thruster combination, see Lander_Policy.h
+static int Combo_Attitudes(int combo, float *att) {
+  int mt = combo & 1, lt = combo & 2, rt = combo & 4;
+  int n = 0;
+  att[n++] = 0;
+  if (mt) {
+    if (!lt || !rt) {
+      att[n++] = 20;
+      att[n++] = 340;
+    }
+  }
+  else if (rt) {
+    att[n++] = 60;
+    att[n++] = 90;
+    att[n++] = 120;
+  }
+  else if (lt) {
+    att[n++] = 240;
+    att[n++] = 270;
+    att[n++] = 300;
+  }
+  return n;
+}
+
+static double Angle_Between(double a, double b) {
+  return fabs(fmod(a - b + 540, 360) - 180);
+}
+
+// Successor interpolation for one axis pair (position p in pixels,
+// velocity v) under constant acceleration acc for dt. sp and sv are the
+// strides of the two axes
+static void Make_Step(const PolicyAxis *pa, const PolicyAxis *va, long sp, long sv,
+                      double p, double v, double acc, double dt, Step *st, double *p1, double *v1) {
+  *p1 = p + S_SCALE * (v * dt + .5 * acc * dt * dt);
+  *v1 = v + acc * dt;
+  int kp, kv;
+  double fp, fv;
+  Policy_Axis_Find(pa, *p1, &kp, &fp);
+  Policy_Axis_Find(va, *v1, &kv, &fv);
+  st->off = kp * sp + kv * sv;
+  st->w[0] = (float)((1 - fp) * (1 - fv));
+  st->w[1] = (float)((1 - fp) * fv);
+  st->w[2] = (float)(fp * (1 - fv));
+  st->w[3] = (float)(fp * fv);
+}
+
+struct ComboSolver {
+  PolicyHeader h;
+  int combo;
+  int n_att;
+  long grid;
+  long s0, s1, s2, s3;
+  std::vector<float> V;
+  std::vector<Action> act[POLICY_MAX_ATT];
+  std::vector<Step> xs[POLICY_MAX_ATT], ys[POLICY_MAX_ATT];   // Per action, then grid points
+  std::vector<double> dx, dy, vx, vy;
+};
+
+static void Setup(ComboSolver *cs, const PolicyHeader *h, int combo) {
+  cs->h = *h;
+  cs->combo = combo;
+  cs->n_att = h->n_att[combo];
+  const PolicyAxis *ax = h->axis;
+  int ndx = ax[PAX_DX].n, ndy = ax[PAX_DY].n, nvx = ax[PAX_VX].n, nvy = ax[PAX_VY].n;
+  cs->s3 = 1;
+  cs->s2 = nvy;
+  cs->s1 = (long)nvx * nvy;
+  cs->s0 = (long)ndy * nvx * nvy;
+  cs->grid = Policy_Grid_Cells(h);
+  for (int k = 0; k < ndx; k++) cs->dx.push_back(Policy_Axis_Value(&ax[PAX_DX], k));
+  for (int k = 0; k < ndy; k++) cs->dy.push_back(Policy_Axis_Value(&ax[PAX_DY], k));
+  for (int k = 0; k < nvx; k++) cs->vx.push_back(Policy_Axis_Value(&ax[PAX_VX], k));
+  for (int k = 0; k < nvy; k++) cs->vy.push_back(Policy_Axis_Value(&ax[PAX_VY], k));
+
+  int mt = combo & 1, lt = (combo >> 1) & 1, rt = (combo >> 2) & 1;
+  for (int a = 0; a < cs->n_att; a++) {
+    double th = h->att[combo][a] * PI / 180;
+    double s = sin(th), c = cos(th);
+
+    // Thrust with the attitude held, or a coasting rotation to another one
+    std::vector<Action> *acts = &cs->act[a];
+    for (int m = 0; m <= mt; m++) {
+      for (int side = 0; side < 3; side++) {
+        if ((side == 1 && !lt) || (side == 2 && !rt)) continue;
+        Action ac = {m, side == 1, side == 2, a, h->step};
+        acts->push_back(ac);
+      }
+    }
+    for (int b = 0; b < cs->n_att; b++) {
+      if (b == a) continue;
+      double ticks = Angle_Between(h->att[combo][a], h->att[combo][b]) * PI / 180 / MAX_ROT_RATE;
+      Action ac = {0, 0, 0, b, fmax(h->step, ceil(ticks) * T_STEP)};
+      acts->push_back(ac);
+    }
+
+    for (size_t n = 0; n < acts->size(); n++) {
+      const Action *ac = &(*acts)[n];
+      double mp = mt ? (ac->main ? PW_ON : PW_OFF) : 0;
+      double lp = lt ? (ac->left ? PW_ON : PW_OFF) : 0;
+      double rp = rt ? (ac->right ? PW_ON : PW_OFF) : 0;
+      double accx = MT_ACCEL * mp * s + LT_ACCEL * lp * c - RT_ACCEL * rp * c;
+      double accy = -G_ACCEL + MT_ACCEL * mp * c - LT_ACCEL * lp * s + RT_ACCEL * rp * s;
+      bool upright = Angle_Between(h->att[combo][ac->to], 0) < LAND_ANGLE;
+
+      for (int i = 0; i < ndx; i++) {
+        for (int k = 0; k < nvx; k++) {
+          Step st;
+          double p1, v1;
+          Make_Step(&ax[PAX_DX], &ax[PAX_VX], cs->s0, cs->s2, cs->dx[i], cs->vx[k], accx, ac->dt, &st, &p1, &v1);
+          st.flag = fabs(p1) <= LAND_DX && upright;
+          st.soft = 0;
+          cs->xs[a].push_back(st);
+        }
+      }
+      for (int j = 0; j < ndy; j++) {
+        for (int l = 0; l < nvy; l++) {
+          Step st;
+          double p1, v1;
+          // dy grows as the lander climbs, like vy
+          Make_Step(&ax[PAX_DY], &ax[PAX_VY], cs->s1, cs->s3, cs->dy[j], cs->vy[l], accy, ac->dt, &st, &p1, &v1);
+          st.flag = p1 <= TOUCH_DY;
+          st.soft = v1 > -LAND_VY;
+          cs->ys[a].push_back(st);
+        }
+      }
+    }
+  }
+
+  // Start from the crash cost everywhere, values only come down from there
+  cs->V.assign(cs->grid * cs->n_att, (float)CRASH_COST);
+  for (int a = 0; a < cs->n_att; a++) {
+    bool upright = Angle_Between(h->att[combo][a], 0) < LAND_ANGLE;
+    for (int i = 0; i < ndx; i++)
+      for (int j = 0; j < ndy; j++)
+        for (int k = 0; k < nvx; k++)
+          for (int l = 0; l < nvy; l++)
+            if (cs->dy[j] <= TOUCH_DY && upright && fabs(cs->dx[i]) <= LAND_DX && cs->vy[l] > -LAND_VY)
+              cs->V[a * cs->grid + i * cs->s0 + j * cs->s1 + k * cs->s2 + l] = 0;
+  }
+}
+
+// Best action and its value at one grid point
+static double Best(const ComboSolver *cs, int a, int i, int j, int k, int l, int *best) {
+  int ndy = cs->h.axis[PAX_DY].n, nvx = cs->h.axis[PAX_VX].n, nvy = cs->h.axis[PAX_VY].n;
+  int ndx = cs->h.axis[PAX_DX].n;
+  const long xo[4] = {0, cs->s2, cs->s0, cs->s0 + cs->s2};
+  const long yo[4] = {0, cs->s3, cs->s1, cs->s1 + cs->s3};
+  double rate = 1 + (cs->dy[j] < LOW_DY && fabs(cs->dx[i]) > LOW_DX ? LOW_COST : 0);
+
+  double vbest = 1e30;
+  int nact = (int)cs->act[a].size();
+  for (int n = 0; n < nact; n++) {
+    const Action *ac = &cs->act[a][n];
+    const Step *x = &cs->xs[a][(long)n * ndx * nvx + i * nvx + k];
+    const Step *y = &cs->ys[a][(long)n * ndy * nvy + j * nvy + l];
+    double q = ac->dt * rate;
+    if (y->flag) q += x->flag && y->soft ? 0 : CRASH_COST;
+    else {
+      const float *v = &cs->V[ac->to * cs->grid + x->off + y->off];
+      double sum = 0;
+      for (int cx = 0; cx < 4; cx++)
+        for (int cy = 0; cy < 4; cy++)
+          sum += x->w[cx] * y->w[cy] * v[xo[cx] + yo[cy]];
+      q += sum;
+    }
+    if (q < vbest) {
+      vbest = q;
+      *best = n;
+    }
+  }
+  return vbest;
+}
+
+// One Gauss-Seidel sweep, forward or backward. Returns the largest change
+static double Sweep(ComboSolver *cs, bool forward) {
+  int ndx = cs->h.axis[PAX_DX].n, ndy = cs->h.axis[PAX_DY].n;
+  int nvx = cs->h.axis[PAX_VX].n, nvy = cs->h.axis[PAX_VY].n;
+  double change = 0;
+  for (int a = 0; a < cs->n_att; a++) {
+    for (int ii = 0; ii < ndx; ii++) {
+      int i = forward ? ii : ndx - 1 - ii;
+      for (int jj = 0; jj < ndy; jj++) {
+        int j = forward ? jj : ndy - 1 - jj;
+        if (cs->dy[j] <= TOUCH_DY) continue;    // Touched down already
+        for (int kk = 0; kk < nvx; kk++) {
+          int k = forward ? kk : nvx - 1 - kk;
+          for (int ll = 0; ll < nvy; ll++) {
+            int l = forward ? ll : nvy - 1 - ll;
+            int best;
+            double v = fmin(Best(cs, a, i, j, k, l, &best), CRASH_COST);
+            float *p = &cs->V[a * cs->grid + i * cs->s0 + j * cs->s1 + k * cs->s2 + l];
+            change = fmax(change, fabs(v - *p));
+            *p = (float)v;
+          }
+        }
+      }
+    }
+  }
+  return change;
+}
+
+static void Store(const ComboSolver *cs, LanderPolicy *pol) {
+  int ndx = cs->h.axis[PAX_DX].n, ndy = cs->h.axis[PAX_DY].n;
+  int nvx = cs->h.axis[PAX_VX].n, nvy = cs->h.axis[PAX_VY].n;
+  PolicyCell *out = (PolicyCell *)pol->cells[cs->combo];
+  for (int a = 0; a < cs->n_att; a++)
+    for (int i = 0; i < ndx; i++)
+      for (int j = 0; j < ndy; j++)
+        for (int k = 0; k < nvx; k++)
+          for (int l = 0; l < nvy; l++) {
+            int best;
+            Best(cs, a, i, j, k, l, &best);
+            const Action *ac = &cs->act[a][best];
+            PolicyCell *c = &out[a * cs->grid + i * cs->s0 + j * cs->s1 + k * cs->s2 + l];
+            c->main = ac->main ? 255 : 0;
+            c->left = ac->left ? 255 : 0;
+            c->right = ac->right ? 255 : 0;
+            c->att = (unsigned char)ac->to;
+          }
+}
+
+// Interpolated value of a state, for the report
+static double Value_At(const ComboSolver *cs, int a, double dx, double dy, double vx, double vy) {
+  const PolicyAxis *ax = cs->h.axis;
+  int k[N_PAX];
+  double f[N_PAX];
+  Policy_Axis_Find(&ax[PAX_DX], dx, &k[0], &f[0]);
+  Policy_Axis_Find(&ax[PAX_DY], dy, &k[1], &f[1]);
+  Policy_Axis_Find(&ax[PAX_VX], vx, &k[2], &f[2]);
+  Policy_Axis_Find(&ax[PAX_VY], vy, &k[3], &f[3]);
+  const long s[N_PAX] = {cs->s0, cs->s1, cs->s2, cs->s3};
+  double v = 0;
+  for (int c = 0; c < 16; c++) {
+    double w = 1;
+    long off = a * cs->grid;
+    for (int d = 0; d < N_PAX; d++) {
+      int bit = (c >> (3 - d)) & 1;
+      w *= bit ? f[d] : 1 - f[d];
+      off += (k[d] + bit) * s[d];
+    }
+    v += w * cs->V[off];
+  }
+  return v;
+}
+
+static void Usage(void) {
+  fprintf(stderr, "Usage: Lander_MkPolicy [-g ndx,ndy,nvx,nvy] [-t step] [-i max_sweeps] [-o policy.lpol]\n");
+}
+
+int main(int argc, char *argv[]) {
+  const char *out_name = "lander.lpol";
+  int n[N_PAX] = {25, 25, 17, 17};
+  double step = .1;
+  int max_sweeps = 1500;
+
+  for (int a = 1; a < argc; a++) {
+    if (!strcmp(argv[a], "-g") && a + 1 < argc) {
+      if (sscanf(argv[++a], "%d,%d,%d,%d", &n[0], &n[1], &n[2], &n[3]) != 4) {
+        Usage();
+        return 1;
+      }
+    }
+    else if (!strcmp(argv[a], "-t") && a + 1 < argc) step = atof(argv[++a]);
+    else if (!strcmp(argv[a], "-i") && a + 1 < argc) max_sweeps = (int)strtol(argv[++a], NULL, 10);
+    else if (!strcmp(argv[a], "-o") && a + 1 < argc) out_name = argv[++a];
+    else {
+      Usage();
+      return 1;
+    }
+  }
+  for (int d = 0; d < N_PAX; d++) {
+    if (n[d] < 3 || n[d] > 1023 || n[d] % 2 == 0) {
+      fprintf(stderr, "Grid sizes must be odd, from 3 to 1023\n");
+      return 1;
+    }
+  }
+  if (step < T_STEP || max_sweeps < 1) {
+    Usage();
+    return 1;
+  }
+
+  PolicyHeader h;
+  memset(&h, 0, sizeof(h));
+  const float lo[N_PAX] = {-960, -240, -40, -40};
+  const float hi[N_PAX] = {960, 960, 40, 30};
+  for (int d = 0; d < N_PAX; d++) {
+    h.axis[d].n = n[d];
+    h.axis[d].lo = lo[d];
+    h.axis[d].hi = hi[d];
+  }
+  h.step = (float)step;
+  h.touch_dy = (float)TOUCH_DY;
+  for (int c = 0; c < POLICY_COMBOS; c++) h.n_att[c] = Combo_Attitudes(c, h.att[c]);
+
+  LanderPolicy pol;
+  if (!Policy_Alloc(&h, &pol)) return 1;
+
+  clock_t t0 = clock();
+  for (int c = 0; c < POLICY_COMBOS; c++) {
+    static ComboSolver cs;
+    cs = ComboSolver();
+    Setup(&cs, pol.head, c);
+    int sweeps = 0;
+    double change = 0;
+    if (c != 0) {                           // Nothing to steer with
+      do change = Sweep(&cs, sweeps % 2 == 0);
+      while (++sweeps < max_sweeps && change > CONVERGED);
+    }
+    Store(&cs, &pol);
+
+    printf("MT %d LT %d RT %d: %d attitude%s, %d sweeps, last change %.4f s, "
+           "value from (300, 800, 0, -5) upright %.1f s\n",
+           c & 1, (c >> 1) & 1, (c >> 2) & 1, cs.n_att, cs.n_att == 1 ? "" : "s", sweeps, change,
+           Value_At(&cs, 0, 300, 800, 0, -5));
+    fflush(stdout);
+  }
+
+  if (!Policy_Save(out_name, &pol)) return 1;
+  printf("%s: %zu bytes, grid %dx%dx%dx%d, step %.3f s, solved in %.1f s\n", out_name, pol.file.len,
+         n[0], n[1], n[2], n[3], step, (double)(clock() - t0) / CLOCKS_PER_SEC);
+  Policy_Free(&pol);
+  return 0;
+}
@@ -0,0 +1,47 @@
+/*
+	Distance field build step.
+
+	Converts terrain maps into .sdf files (see Lander_SDF.h), written
+	next to each map. Sim_Load_Map picks them up instead of rebuilding
+	the fields, and offline tools can read them with Sdf_Load.
+
+	Usage: Lander_MkSDF map1.ppm [map2.ppm ...]
+*/
+
+#include <stdio.h>
+#include <time.h>
+
+#include "Lander_SDF.h"
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: Lander_MkSDF map1.ppm [map2.ppm ...]\n");
+    return 1;
+  }
+
+  for (int a = 1; a < argc; a++) {
+    LanderMap map;
+    if (!Sim_Load_Map(argv[a], &map)) return 1;
+
+    // Always rebuild, whatever Sim_Load_Map found on disk
+    LanderSDF sdf;
+    clock_t t0 = clock();
+    if (!Sdf_Build(&map, &sdf)) return 1;
+    double ms = (double)(clock() - t0) * 1000 / CLOCKS_PER_SEC;
+
+    char name[1024];
+    Sdf_File_Name(argv[a], name, sizeof(name));
+    if (!Sdf_Save(name, &sdf)) return 1;
+
+    // Summary: deepest terrain, clearance at the platform centre
+    float dmin = 0;
+    for (int k = 0; k < sdf.sx * sdf.sy; k++)
+      if (sdf.dist[k] < dmin) dmin = sdf.dist[k];
+    printf("%s -> %s (%dx%d, built in %.1f ms, deepest solid %.1f px, platform at %.0f,%.0f)\n",
+           argv[a], name, sdf.sx, sdf.sy, ms, -dmin, map.plat_x, map.plat_y);
+
+    Sdf_Free(&sdf);
+    Sim_Free_Map(&map);
+  }
+  return 0;
+}
@@ -0,0 +1,79 @@
+/*
+	Packed terrain build step.
+
+	Converts .ppm terrain maps into .ltm files (see Lander_Terrain.h),
+	written next to each map. Sim_Load_Map maps them instead of parsing
+	the .ppm, so every simulator process starts without reading the
+	image and shares one copy of the terrain.
+
+	Usage: Lander_MkTerrain [-h] map1.ppm [map2.ppm ...]
+
+	-h adds the heightfield, which nothing reads yet (see
+	Lander_Terrain.h).
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "Lander_Sim.h"
+
+static double Elapsed_Ms(clock_t t0) {
+  return (double)(clock() - t0) * 1000 / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char *argv[]) {
+  int flags = 0;
+  int a = 1;
+  if (a < argc && !strcmp(argv[a], "-h")) {
+    flags = TERRAIN_HEIGHT;
+    a++;
+  }
+  if (a >= argc) {
+    fprintf(stderr, "Usage: Lander_MkTerrain [-h] map1.ppm [map2.ppm ...]\n");
+    return 1;
+  }
+
+  for (; a < argc; a++) {
+    clock_t t0 = clock();
+    LanderTerrain ter;
+    if (!Sim_Read_Map(argv[a], flags, &ter)) return 1;
+    double parse_ms = Elapsed_Ms(t0);
+
+    char name[1024];
+    Terrain_File_Name(argv[a], name, sizeof(name));
+    if (!Terrain_Save(name, &ter)) return 1;
+
+    // Map the file back and check it holds the same cells
+    LanderTerrain back;
+    t0 = clock();
+    if (!Terrain_Map(name, &back)) {
+      fprintf(stderr, "Unable to map terrain file %s after writing it\n", name);
+      return 1;
+    }
+    double map_ms = Elapsed_Ms(t0);
+    const TerrainHeader *h = ter.head;
+    int solid = 0, plat = 0;
+    for (int j = 0; j < h->sy; j++) {
+      for (int i = 0; i < h->sx; i++) {
+        int s = Terrain_Solid(&ter, i, j);
+        int p = Terrain_Platform(&ter, i, j);
+        if (s != Terrain_Solid(&back, i, j) || p != Terrain_Platform(&back, i, j)) {
+          fprintf(stderr, "Terrain file %s does not match %s\n", name, argv[a]);
+          return 1;
+        }
+        solid += s;
+        plat += p;
+      }
+    }
+
+    printf("%s -> %s (%dx%d, %zu bytes%s, %d solid, %d platform cells in %d..%d,%d..%d, "
+           "parsed in %.1f ms, mapped in %.3f ms)\n",
+           argv[a], name, h->sx, h->sy, ter.file.len, ter.height != NULL ? " with heightfield" : "",
+           solid, plat, h->plat_x0, h->plat_x1, h->plat_y0, h->plat_y1, parse_ms, map_ms);
+
+    Terrain_Free(&back);
+    Terrain_Free(&ter);
+  }
+  return 0;
+}
@@ -0,0 +1,133 @@
+/*
+	Controller gains - see Lander_Params.h
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#include "Lander_Params.h"
+
+// Where each parameter lives in ControllerParams
+static const size_t param_offset[] = {
+  offsetof(ControllerParams, far_x),
+  offsetof(ControllerParams, mid_x),
+  offsetof(ControllerParams, vx_far),
+  offsetof(ControllerParams, vx_mid),
+  offsetof(ControllerParams, vx_near),
+  offsetof(ControllerParams, far_y),
+  offsetof(ControllerParams, mid_y),
+  offsetof(ControllerParams, vy_far),
+  offsetof(ControllerParams, vy_mid),
+  offsetof(ControllerParams, vy_near),
+  offsetof(ControllerParams, overshoot),
+  offsetof(ControllerParams, dist_floor),
+  offsetof(ControllerParams, override_box),
+  offsetof(ControllerParams, pred_horizon),
+  offsetof(ControllerParams, pred_clear),
+  offsetof(ControllerParams, gate),
+  offsetof(ControllerParams, var_limit),
+  offsetof(ControllerParams, bias_limit),
+};
+
+static const ParamInfo param_info[] = {
+  // name           default  lo     hi
+  {"far_x",         200,     100,   400},
+  {"mid_x",         100,     30,    200},
+  {"vx_far",        25,      5,     40},
+  {"vx_mid",        15,      3,     30},
+  {"vx_near",       5,       1,     15},
+  {"far_y",         200,     100,   400},
+  {"mid_y",         100,     30,    200},
+  {"vy_far",        20,      5,     40},
+  {"vy_mid",        10,      3,     20},
+  {"vy_near",       4,       1,     9},
+  {"overshoot",     1.25,    .5,    3},
+  {"dist_floor",    75,      20,    200},
+  {"override_box",  150,     50,    300},
+  {"pred_horizon",  1,       .3,    2.5},
+  {"pred_clear",    40,      32,    80},
+  {"gate",          5,       2,     10},
+  {"var_limit",     4,       1.5,   10},
+  {"bias_limit",    .5,      .2,    2},
+};
+
+#define N_PARAMS (int)(sizeof(param_info) / sizeof(param_info[0]))
+
+// Parameters nothing reads any more. Files tuned while they were live
+// still load, with these skipped
+static const char *retired[] = {"hdist_min", "hspeed_ref"};
+
+static int Retired(const char *name) {
+  for (size_t i = 0; i < sizeof(retired) / sizeof(retired[0]); i++)
+    if (!strcmp(name, retired[i])) return 1;
+  return 0;
+}
+
+int Params_Count(void) {
+  return N_PARAMS;
+}
+
+const ParamInfo *Params_Info(int i) {
+  return &param_info[i];
+}
+
+double Params_Get(const ControllerParams *p, int i) {
+  return *(const double *)((const char *)p + param_offset[i]);
+}
+
+void Params_Set(ControllerParams *p, int i, double v) {
+  *(double *)((char *)p + param_offset[i]) = v;
+}
+
+void Params_Default(ControllerParams *p) {
+  for (int i = 0; i < N_PARAMS; i++) Params_Set(p, i, param_info[i].def);
+}
+
+int Params_Load(const char *fname, ControllerParams *p) {
+  FILE *f = fopen(fname, "r");
+  if (f == NULL) {
+    fprintf(stderr, "Unable to open file %s for reading, please check name and path\n", fname);
+    return 0;
+  }
+
+  char line[256];
+  int lineno = 0;
+  int ok = 1;
+  while (ok && fgets(line, sizeof(line), f) != NULL) {
+    lineno++;
+    char *hash = strchr(line, '#');
+    if (hash != NULL) *hash = '\0';
+    char name[64];
+    double v;
+    int got = sscanf(line, "%63s %lf", name, &v);
+    if (got <= 0 || (got == 2 && Retired(name))) continue;
+
+    int i = 0;
+    while (i < N_PARAMS && strcmp(name, param_info[i].name)) i++;
+    if (got != 2 || i == N_PARAMS) {
+      fprintf(stderr, "%s:%d: expected a parameter name and value\n", fname, lineno);
+      ok = 0;
+    }
+    else Params_Set(p, i, v);
+  }
+  fclose(f);
+  return ok;
+}
+
+int Params_Save(const char *fname, const ControllerParams *p, const char *note) {
+  FILE *f = fopen(fname, "w");
+  if (f == NULL) {
+    fprintf(stderr, "Unable to open file %s for writing\n", fname);
+    return 0;
+  }
+  if (note != NULL) fputs(note, f);
+  for (int i = 0; i < N_PARAMS; i++)
+    fprintf(f, "%-14s %.6g\n", param_info[i].name, Params_Get(p, i));
+  if (fclose(f) != 0) {
+    fprintf(stderr, "Failed to write parameters %s\n", fname);
+    return 0;
+  }
+  return 1;
+}
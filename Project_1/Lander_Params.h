@@ -0,0 +1,79 @@
+/*
+	Controller gains.
+
+	The thresholds and limits Lander_Control() and Safety_Override()
+	fly by, and the estimator's sensor consistency limits, gathered in
+	one struct so they can be tuned (Lander_Tune searches them by batch
+	simulation) and loaded from a file instead of being edited in the
+	code.
+
+	A parameter file is text, one "name value" pair per line, with '#'
+	starting a comment. Parameters not in the file keep their defaults,
+	which are the hand-picked values the controller has always used.
+
+	The default controller (Lander_Default.cpp, behind the global
+	Lander_Control() and Safety_Override()) loads the file named by the
+	LANDER_PARAMS environment variable at startup, or, when that is not
+	set, lander.params from the working directory if there is one. The
+	lanes kernels (Lander_Kernel.h) are passed the struct too, and fly
+	by the gains of the phases they have.
+*/
+
+#ifndef _LANDER_PARAMS_H
+#define _LANDER_PARAMS_H
+
+#define PARAMS_FILE "lander.params"
+
+struct ControllerParams {
+  // Lander_Control() velocity limits. Horizontal distance to the
+  // platform beyond far_x (pixels) allows vx_far (m/s), beyond mid_x
+  // vx_mid, else vx_near; likewise for height and descent speed
+  double far_x, mid_x;
+  double vx_far, vx_mid, vx_near;
+  double far_y, mid_y;
+  double vy_far, vy_mid, vy_near;
+
+  // Hold altitude while the platform is more than overshoot times as
+  // far away (in time) horizontally as vertically
+  double overshoot;
+
+  // Sonar clearance below which the thruster-out recovery phases stop
+  // and climb: at least dist_floor pixels and at least the squared speed
+  double dist_floor;
+
+  // Safety_Override() stays out within override_box pixels of the
+  // platform. Elsewhere it flies the path pred_horizon seconds ahead
+  // and keeps it pred_clear pixels from the terrain (Lander_Predict.h)
+  double override_box;
+  double pred_horizon, pred_clear;
+
+  // Estimator (Lander_Estimator.h): innovation gate in standard
+  // deviations, and the variance and bias of the innovation window
+  // that fail a sensor
+  double gate, var_limit, bias_limit;
+};
+
+// Name, default and search range of each parameter, in struct order
+struct ParamInfo {
+  const char *name;
+  double def, lo, hi;
+};
+
+int Params_Count(void);
+const ParamInfo *Params_Info(int i);
+
+// Parameter i as a number, for searches over all of them
+double Params_Get(const ControllerParams *p, int i);
+void Params_Set(ControllerParams *p, int i, double v);
+
+void Params_Default(ControllerParams *p);
+
+// Read a parameter file over p. Returns 0, with a message, if the file
+// cannot be read or names an unknown parameter
+int Params_Load(const char *fname, ControllerParams *p);
+
+// Write every parameter, preceded by the comment lines in note (may be
+// NULL). Returns 0 on failure
+int Params_Save(const char *fname, const ControllerParams *p, const char *note);
+
+#endif
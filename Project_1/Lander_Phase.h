@@ -0,0 +1,77 @@
+/*
+	Flight phases.
+
+	Lander_Control() flies the mission as a sequence of phases, and
+	each tick runs only the active one. While every thruster works:
+
+	  stabilize  - the lander is more than a degree off upright: rotate
+	               back, nothing else (the thrusters hold)
+	  cruise     - more than mid_x from the platform horizontally:
+	               close the distance at the far/mid speed limits
+	  descend    - over the platform area, more than mid_y above it:
+	               come down at the far/mid descent limits
+	  final      - within mid_y: near limits down to touchdown
+
+	Entry and exit conditions are those the velocity limit tiers always
+	had, so these phases fly exactly as the hand-coded controller did.
+	Once the sonar is isolated nothing shows the terrain ahead, and
+	cruise is flown at constant height from the top of the map:
+
+	  climb      - more than mid_x from the platform and below the
+	               ceiling: stop and climb straight up to it
+
+	Once a thruster is lost (its OK flag drops, or the fault detector
+	isolates it) the lander flies on whatever is left, with the thrust
+	pointed by tilting the lander:
+
+	  vector     - steer toward the platform on the lift thruster: the
+	               main thruster if it works, else a side thruster
+	               with the lander lying on its side
+	  hover      - a side thruster is lifting: hold over the platform
+	               at drop height
+	  drop       - turn upright with every thruster off and fall the
+	               last few pixels onto the platform
+	  ballistic  - no thruster left, keep upright and hope
+
+	A lost thruster does not come back, so the recovery phases are never
+	left for the nominal ones, and drop is never left at all. Policy
+	flight (Lander_Policy.h) is a phase of its own.
+
+	The controller keeps the phase of the current tick, the ticks spent
+	in each phase and the last PHASE_LOG transitions.
+*/
+
+#ifndef _LANDER_PHASE_H
+#define _LANDER_PHASE_H
+
+#define PHASE_STABILIZE 0
+#define PHASE_CRUISE 1
+#define PHASE_DESCEND 2
+#define PHASE_FINAL 3
+#define PHASE_VECTOR 4
+#define PHASE_HOVER 5
+#define PHASE_DROP 6
+#define PHASE_BALLISTIC 7
+#define PHASE_POLICY 8
+#define PHASE_CLIMB 9
+#define N_PHASE 10
+
+#define PHASE_RECOVERY(p) ((p) >= PHASE_VECTOR && (p) <= PHASE_BALLISTIC)
+
+// Transitions kept, the oldest are dropped first
+#define PHASE_LOG 64
+
+static const char *const phase_name[N_PHASE] = {
+  "stabilize", "cruise", "descend", "final", "vector", "hover", "drop", "ballistic", "policy", "climb"
+};
+
+struct PhaseTimeline {
+  long ticks[N_PHASE];      // Ticks spent in each phase
+  long changes;             // Transitions so far
+  // The last min(changes, PHASE_LOG) transitions in a ring, entry k at
+  // k % PHASE_LOG: the tick and the phase entered
+  long tick[PHASE_LOG];
+  unsigned char phase[PHASE_LOG];
+};
+
+#endif
@@ -0,0 +1,163 @@
+/*
+	Precomputed control policy tables - see Lander_Policy.h
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "Lander_Policy.h"
+
+// Point the combination pointers at the storage in pol->file
+static void Attach(LanderPolicy *pol) {
+  const unsigned char *base = (const unsigned char *)pol->file.base;
+  pol->head = (const PolicyHeader *)base;
+  for (int c = 0; c < POLICY_COMBOS; c++) pol->cells[c] = (const PolicyCell *)(base + pol->head->offset[c]);
+}
+
+/*
+  Files
+*/
+
+int Policy_Alloc(const PolicyHeader *head, LanderPolicy *pol) {
+  memset(pol, 0, sizeof(LanderPolicy));
+  PolicyHeader h = *head;
+  memcpy(h.magic, "LPOL", 4);
+  h.version = POLICY_VERSION;
+
+  unsigned long long grid = Policy_Grid_Cells(&h) * sizeof(PolicyCell);
+  unsigned long long at = Section_Align(sizeof(PolicyHeader));
+  for (int c = 0; c < POLICY_COMBOS; c++) {
+    h.offset[c] = at;
+    at = Section_Align(at + grid * h.n_att[c]);
+  }
+  h.size = at;
+
+  if (!Section_Alloc(h.size, &pol->file)) {
+    fprintf(stderr, "Out of memory for a %llu byte policy table\n", h.size);
+    return 0;
+  }
+  memcpy(pol->file.base, &h, sizeof(h));
+  Attach(pol);
+  return 1;
+}
+
+int Policy_Save(const char *fname, const LanderPolicy *pol) {
+  return Section_Save(fname, &pol->file, "policy");
+}
+
+// The grid and offset checks, so a truncated or foreign file cannot
+// send the lookups out of bounds
+static int Valid_Header(const SectionFile *sf) {
+  const PolicyHeader *h = (const PolicyHeader *)sf->base;
+  if (!Section_Check(sf, "LPOL", POLICY_VERSION, h->size))
+    return 0;
+  for (int a = 0; a < N_PAX; a++)
+    if (h->axis[a].n < 3 || h->axis[a].n > 1023 || h->axis[a].n % 2 == 0 ||
+        !(h->axis[a].lo < 0) || !(h->axis[a].hi > 0))
+      return 0;
+  unsigned long long grid = Policy_Grid_Cells(h) * sizeof(PolicyCell);
+  for (int c = 0; c < POLICY_COMBOS; c++) {
+    if (h->n_att[c] < 1 || h->n_att[c] > POLICY_MAX_ATT || h->offset[c] % SECTION_ALIGN ||
+        h->offset[c] < sizeof(PolicyHeader) || h->offset[c] + grid * h->n_att[c] > sf->len)
+      return 0;
+  }
+  return 1;
+}
+
+int Policy_Map(const char *fname, LanderPolicy *pol) {
+  memset(pol, 0, sizeof(LanderPolicy));
+  int r = Section_Map(fname, sizeof(PolicyHeader), &pol->file);
+  if (r == SECTION_MISSING) {
+    fprintf(stderr, "Unable to open file %s for reading, please check name and path\n", fname);
+    return 0;
+  }
+  if (r != SECTION_OK || !Valid_Header(&pol->file)) {
+    Section_Free(&pol->file);
+    fprintf(stderr, "%s is not a policy table of this version\n", fname);
+    return 0;
+  }
+  Attach(pol);
+  return 1;
+}
+
+void Policy_Free(LanderPolicy *pol) {
+  Section_Free(&pol->file);
+  memset(pol, 0, sizeof(LanderPolicy));
+}
+
+/*
+  Lookup
+*/
+
+double Policy_Axis_Value(const PolicyAxis *a, int k) {
+  double t = 2.0 * k / (a->n - 1) - 1;
+  return t * fabs(t) * (t < 0 ? -a->lo : a->hi);
+}
+
+void Policy_Axis_Find(const PolicyAxis *a, double v, int *k, double *frac) {
+  double u = v < 0 ? v / -a->lo : v / a->hi;
+  u = fmin(fmax(u, -1), 1);
+  double t = u < 0 ? -sqrt(-u) : sqrt(u);
+  double f = (t + 1) * .5 * (a->n - 1);
+  int i = (int)f;
+  if (i > a->n - 2) i = a->n - 2;
+  *k = i;
+  *frac = fmin(fmax(f - i, 0), 1);
+}
+
+int Policy_Attitude(const LanderPolicy *pol, int combo, double angle) {
+  const PolicyHeader *h = pol->head;
+  int best = 0;
+  double dbest = 360;
+  for (int a = 0; a < h->n_att[combo]; a++) {
+    double d = fabs(fmod(angle - h->att[combo][a] + 540, 360) - 180);
+    if (d < dbest) {
+      dbest = d;
+      best = a;
+    }
+  }
+  return best;
+}
+
+void Policy_Lookup(const LanderPolicy *pol, int combo, int att, double dx, double dy,
+                   double vx, double vy, PolicyCommand *cmd) {
+  const PolicyHeader *h = pol->head;
+  int k[N_PAX];
+  double f[N_PAX];
+  Policy_Axis_Find(&h->axis[PAX_DX], dx, &k[PAX_DX], &f[PAX_DX]);
+  Policy_Axis_Find(&h->axis[PAX_DY], dy, &k[PAX_DY], &f[PAX_DY]);
+  Policy_Axis_Find(&h->axis[PAX_VX], vx, &k[PAX_VX], &f[PAX_VX]);
+  Policy_Axis_Find(&h->axis[PAX_VY], vy, &k[PAX_VY], &f[PAX_VY]);
+
+  long s3 = 1;
+  long s2 = h->axis[PAX_VY].n;
+  long s1 = s2 * h->axis[PAX_VX].n;
+  long s0 = s1 * h->axis[PAX_DY].n;
+  const PolicyCell *grid = pol->cells[combo] + (long)att * Policy_Grid_Cells(h);
+  const PolicyCell *base = grid + k[0] * s0 + k[1] * s1 + k[2] * s2 + k[3] * s3;
+
+  double m = 0, l = 0, r = 0, wbest = -1;
+  int abest = 0;
+  for (int c = 0; c < 16; c++) {
+    double w = 1;
+    long off = 0;
+    w *= (c & 8) ? f[0] : 1 - f[0]; off += (c & 8) ? s0 : 0;
+    w *= (c & 4) ? f[1] : 1 - f[1]; off += (c & 4) ? s1 : 0;
+    w *= (c & 2) ? f[2] : 1 - f[2]; off += (c & 2) ? s2 : 0;
+    w *= (c & 1) ? f[3] : 1 - f[3]; off += (c & 1) ? s3 : 0;
+    const PolicyCell *p = base + off;
+    m += w * p->main;
+    l += w * p->left;
+    r += w * p->right;
+    if (w > wbest) {
+      wbest = w;
+      abest = p->att;
+    }
+  }
+  cmd->main_pw = m / 255;
+  cmd->left_pw = l / 255;
+  cmd->right_pw = r / 255;
+  cmd->att = abest;
+  cmd->angle = h->att[combo][abest];
+}
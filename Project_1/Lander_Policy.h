@@ -0,0 +1,121 @@
+/*
+	Precomputed control policy tables.
+
+	A policy table gives the thruster commands and the attitude to fly
+	for every state on a grid over
+
+	  dx  lander x minus PLAT_X (pixels)
+	  dy  height above PLAT_Y, PLAT_Y minus lander y (pixels)
+	  vx  horizontal velocity (m/s)
+	  vy  vertical velocity (m/s, up is positive)
+
+	with one grid per flight attitude, for each combination of working
+	thrusters (MT_OK, LT_OK, RT_OK). The attitudes of a combination are
+	the ones worth flying with those thrusters: upright always (landing
+	needs it), a slight tilt either way when a side thruster is out, and
+	the side thruster lifting straight up or at +-30 degrees off it when the
+	main thruster is out.
+
+	Lander_MkPolicy solves for the tables offline by value iteration on
+	the flight dynamics and constants of Lander_Control.h; this file only
+	reads them. Grid points along each axis are spaced quadratically,
+	densest around zero, where landing needs the precision.
+
+	The file is laid out as it is used (a section file, see
+	Lander_Section.h), so Policy_Map() maps it read-only and any number
+	of controllers can share one copy. Policy_Lookup()
+	is O(1): it interpolates the commands of the 16 grid points around
+	the state, and takes the attitude from the nearest one.
+*/
+
+#ifndef _LANDER_POLICY_H
+#define _LANDER_POLICY_H
+
+#include <stddef.h>
+
+#include "Lander_Section.h"
+
+#define POLICY_VERSION 1
+
+// State axes
+#define PAX_DX 0
+#define PAX_DY 1
+#define PAX_VX 2
+#define PAX_VY 3
+#define N_PAX 4
+
+// Thruster combinations, Policy_Combo() of the OK flags
+#define POLICY_COMBOS 8
+#define POLICY_MAX_ATT 4
+
+// Grid point k of an axis of n points (n odd) sits at t = 2k / (n - 1) - 1,
+// value t * |t| * hi for t >= 0 and t * |t| * -lo below
+struct PolicyAxis {
+  int n;
+  float lo, hi;
+};
+
+// Commands at one grid point. Powers are in 1/255ths, att indexes the
+// attitudes of the combination
+struct PolicyCell {
+  unsigned char main, left, right, att;
+};
+
+struct PolicyHeader {
+  char magic[4];                  // "LPOL"
+  int version;
+  PolicyAxis axis[N_PAX];
+  float step;                     // Decision period the solver used (s)
+  float touch_dy;                 // dy at which the lander touches down
+  int n_att[POLICY_COMBOS];
+  float att[POLICY_COMBOS][POLICY_MAX_ATT];   // Degrees clockwise from upright
+  unsigned long long offset[POLICY_COMBOS];   // First cell of each combination
+  unsigned long long size;        // Whole file
+};
+
+struct LanderPolicy {
+  const PolicyHeader *head;
+  const PolicyCell *cells[POLICY_COMBOS];
+  SectionFile file;
+};
+
+// What to do in one state
+struct PolicyCommand {
+  double main_pw, left_pw, right_pw;
+  int att;                        // Attitude to fly, index and degrees
+  double angle;
+};
+
+static inline int Policy_Combo(int mt_ok, int lt_ok, int rt_ok) {
+  return (mt_ok ? 1 : 0) | (lt_ok ? 2 : 0) | (rt_ok ? 4 : 0);
+}
+
+// Cells in one attitude's grid
+static inline long Policy_Grid_Cells(const PolicyHeader *h) {
+  return (long)h->axis[0].n * h->axis[1].n * h->axis[2].n * h->axis[3].n;
+}
+
+// Allocate a zeroed table for the header's axes and attitudes, filling
+// in the offsets and size. Returns 0 on failure
+int Policy_Alloc(const PolicyHeader *head, LanderPolicy *pol);
+
+// Map a .lpol file read-only. Returns 0, with a message, if the file is
+// missing, has another version or is malformed
+int Policy_Map(const char *fname, LanderPolicy *pol);
+void Policy_Free(LanderPolicy *pol);
+
+int Policy_Save(const char *fname, const LanderPolicy *pol);
+
+// Value of grid point k on an axis, and the point at or below value v
+// with the fraction of the way to the next one
+double Policy_Axis_Value(const PolicyAxis *a, int k);
+void Policy_Axis_Find(const PolicyAxis *a, double v, int *k, double *frac);
+
+// Attitude of the combination nearest to angle (degrees)
+int Policy_Attitude(const LanderPolicy *pol, int combo, double angle);
+
+// Commands for a state, flying attitude att of the combination
+void Policy_Lookup(const LanderPolicy *pol, int combo, int att, double dx, double dy,
+                   double vx, double vy, PolicyCommand *cmd);
+
+#endif
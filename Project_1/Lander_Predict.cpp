@@ -0,0 +1,130 @@
+/*
+	Short-horizon collision prediction - see Lander_Predict.h
+*/
+
+#include <math.h>
+
+#include "Lander_Control.h"
+#include "Lander_Predict.h"
+
+#define DEG2RAD (PI/180.0)
+
+// Fastest the lander can pick up speed in any direction (m/s^2)
+#define MAX_ACCEL (G_ACCEL + MT_ACCEL + LT_ACCEL)
+
+// Thrust settings tried besides the commanded one: main off, half or
+// full, with no side thrust or either side thruster at half or full
+static const double candidate[PRED_CANDIDATES - 1][3] = {
+  {0, 0, 0}, {0, .5, 0}, {0, 1, 0}, {0, 0, .5}, {0, 0, 1},
+  {.5, 0, 0}, {.5, .5, 0}, {.5, 1, 0}, {.5, 0, .5}, {.5, 0, 1},
+  {1, 0, 0}, {1, .5, 0}, {1, 1, 0}, {1, 0, .5}, {1, 0, 1},
+};
+
+static const double max_accel[3] = {MT_ACCEL, LT_ACCEL, RT_ACCEL};
+
+void CollisionPredictor::Reset() {
+  tick = 0;
+  tests = 0;
+  for (int i = 0; i < 36; i++) {
+    last[i] = -1;
+    seen[i] = -1;
+  }
+}
+
+void CollisionPredictor::Update(const double *sonar, double px, double py) {
+  for (int i = 0; i < 36; i++) {
+    if (sonar[i] >= 0 && sonar[i] != last[i]) {
+      ox[i] = px + sonar[i] * sin(i * 10 * DEG2RAD);
+      oy[i] = py - sonar[i] * cos(i * 10 * DEG2RAD);
+      seen[i] = tick;
+    }
+    else if (seen[i] >= 0 && tick - seen[i] > PRED_AGE) seen[i] = -1;
+    last[i] = sonar[i];
+  }
+  tick++;
+}
+
+// Flies thrust pw (as delivered: about 95% of the request plus a small
+// leak) over the horizon, returns the closest the lander comes to any
+// of the near points
+double CollisionPredictor::Fly(const PredictState *s, const double *pw, double horizon, const int *near, int n_near) {
+  double sn = sin(s->angle * DEG2RAD);
+  double cs = cos(s->angle * DEG2RAD);
+  double p[3];
+  for (int j = 0; j < 3; j++) p[j] = s->ok[j] ? pw[j] * .95 + .025 : 0;
+  double ax = MT_ACCEL * p[0] * sn + LT_ACCEL * p[1] * cs - RT_ACCEL * p[2] * cs;
+  double ay = -G_ACCEL + MT_ACCEL * p[0] * cs - LT_ACCEL * p[1] * sn + RT_ACCEL * p[2] * sn;
+
+  double dt = horizon / PRED_STEPS;
+  double x = s->px, y = s->py, vx = s->vx, vy = s->vy;
+  double closest = 1e30;
+  for (int k = 0; k < PRED_STEPS; k++) {
+    vx += ax * dt;
+    vy += ay * dt;
+    x += vx * dt * S_SCALE;
+    y -= vy * dt * S_SCALE;
+    for (int n = 0; n < n_near; n++) {
+      double dx = ox[near[n]] - x;
+      double dy = oy[near[n]] - y;
+      closest = fmin(closest, dx * dx + dy * dy);
+    }
+  }
+  tests += PRED_STEPS * n_near;
+  return sqrt(closest);
+}
+
+bool CollisionPredictor::Choose(const PredictState *s, const double *cmd, double horizon, double clearance, double *out) {
+  tests = 0;
+
+  // Points within reach, and how close the nearest is now
+  double v = sqrt(s->vx * s->vx + s->vy * s->vy);
+  double reach = (v * horizon + .5 * MAX_ACCEL * horizon * horizon) * S_SCALE + clearance;
+  int near[36];
+  int n_near = 0;
+  double now = 1e30;
+  for (int i = 0; i < 36; i++) {
+    if (seen[i] < 0) continue;
+    double d = hypot(ox[i] - s->px, oy[i] - s->py);
+    if (d > reach) continue;
+    near[n_near++] = i;
+    now = fmin(now, d);
+  }
+  if (n_near == 0) return false;
+
+  // Within the clearance already, a path must not get any closer
+  double limit = fmin(clearance, now - 1);
+  double best = Fly(s, cmd, horizon, near, n_near);
+  if (best >= limit) return false;
+
+  // Candidates by how much they change the acceleration, least first.
+  // More main thrust is free: the controller holds height and leaves
+  // the climb over a ridge to the override
+  int order[PRED_CANDIDATES - 1];
+  double cost[PRED_CANDIDATES - 1];
+  for (int c = 0; c < PRED_CANDIDATES - 1; c++) {
+    cost[c] = 0;
+    for (int j = 0; j < 3; j++) {
+      double d = (s->ok[j] ? candidate[c][j] : 0) - cmd[j];
+      if (j > 0 || d < 0) cost[c] += max_accel[j] * fabs(d);
+    }
+    int k = c;
+    while (k > 0 && cost[order[k - 1]] > cost[c]) {
+      order[k] = order[k - 1];
+      k--;
+    }
+    order[k] = c;
+  }
+
+  bool changed = false;
+  for (int k = 0; k < PRED_CANDIDATES - 1 && tests + PRED_STEPS * n_near <= PRED_BUDGET; k++) {
+    const double *pw = candidate[order[k]];
+    double d = Fly(s, pw, horizon, near, n_near);
+    if (d > best) {
+      best = d;
+      for (int j = 0; j < 3; j++) out[j] = s->ok[j] ? pw[j] : 0;
+      changed = true;
+    }
+    if (d >= limit) break;
+  }
+  return changed;
+}
@@ -0,0 +1,77 @@
+/*
+	Short-horizon collision prediction for Safety_Override().
+
+	CollisionPredictor keeps a local obstacle map: for each sonar beam,
+	the point where its latest return hit, placed in map coordinates
+	from the lander's estimated position when the return came in. A
+	point is forgotten PRED_AGE ticks after its beam last returned, so
+	the map holds the last two sweeps or so.
+
+	Each tick Choose() flies the lander forward from its estimated state
+	for a short horizon under the thrust the controller has commanded,
+	at the current attitude, and checks the path against the map. If the
+	lander would come within the clearance of a point (or closer than it
+	already is, if it is within it now), the candidate thrust settings
+	are tried in order of how much they change the commanded
+	acceleration, and the first one that keeps clear is taken: the least
+	intervention that avoids the terrain. If none does, the one that
+	stays farthest away is. Adding main thrust is not counted as a
+	change, so when the way ahead is blocked the override climbs rather
+	than just stopping there.
+
+	Only points the lander could reach within the horizon are checked,
+	and the work per tick is capped at PRED_BUDGET point tests: the
+	candidates not tried by then are not considered.
+*/
+
+#ifndef _LANDER_PREDICT_H
+#define _LANDER_PREDICT_H
+
+// Steps the horizon is flown in
+#define PRED_STEPS 20
+
+// Point tests per tick, at most
+#define PRED_BUDGET 4096
+
+// Ticks a sonar return stays in the obstacle map
+#define PRED_AGE 100
+
+// Thrust settings tried, the commanded one included
+#define PRED_CANDIDATES 16
+
+struct PredictState {
+  double px, py;            // Position (pixels, y down)
+  double vx, vy;            // Velocity (m/s, vy up)
+  double angle;             // Degrees clockwise from upright
+  bool ok[3];               // Main, left and right thruster work
+};
+
+class CollisionPredictor {
+ public:
+  CollisionPredictor() { Reset(); }
+
+  void Reset();
+
+  // Book this tick's sonar readings, taken at the estimated position
+  // (px, py)
+  void Update(const double *sonar, double px, double py);
+
+  // Checks the commanded thrust (main, left, right powers) over horizon
+  // seconds. Returns false if it keeps clearance pixels from every
+  // point, else true with the thrust to use instead in out
+  bool Choose(const PredictState *s, const double *cmd, double horizon, double clearance, double *out);
+
+  // Point tests made by the last Choose()
+  int Tests() const { return tests; }
+
+ private:
+  double Fly(const PredictState *s, const double *pw, double horizon, const int *near, int n_near);
+
+  long tick;
+  double last[36];          // Readings on the previous update
+  double ox[36], oy[36];    // Obstacle points (pixels)
+  long seen[36];            // Tick each point was placed, -1 for none
+  int tests;
+};
+
+#endif
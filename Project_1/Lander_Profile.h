@@ -0,0 +1,202 @@
+/*
+	Hot-path latency profiling.
+
+	PROF_SCOPE(stage) times the rest of the enclosing block and adds the
+	duration to a latency histogram for that stage. Each thread has its
+	own histograms, written only by that thread with plain relaxed
+	stores, so recording takes no locks and no atomic read-modify-write:
+	one timestamp read at each end of the scope and one counter bump.
+
+	Timestamps are TSC cycles on x86 (converted to nanoseconds against
+	steady_clock when reported) and steady_clock elsewhere. Buckets are
+	log-linear with 8 steps per power of two, so percentiles are good to
+	about 6%; the maximum is kept exactly.
+
+	The merged histograms of all threads are printed to stderr at exit,
+	and whenever the process gets SIGUSR1 (by the next thread to finish
+	a scope, the signal handler only raises a flag):
+
+	  stage           calls      p50 ns     p99 ns     max ns
+
+	Profiling is compiled in only with -DLANDER_PROFILE, for example
+
+	  make clean; make CPPFLAGS=-DLANDER_PROFILE headless
+
+	Without it PROF_SCOPE expands to nothing and this header declares
+	nothing else.
+*/
+
+#ifndef _LANDER_PROFILE_H
+#define _LANDER_PROFILE_H
+
+// Stages
+#define PROF_CONTROL 0          // Lander_Control(), all of it
+#define PROF_READ 1             // Reading the sensors into the snapshot
+#define PROF_ESTIMATE 2         // State estimator update
+#define PROF_DECIDE 3           // Lander_Control() after the sensors are in
+#define PROF_SAFETY 4           // Safety checks, within Lander_Control() when it runs
+#define PROF_SIM 5              // Sim_Step()
+#define N_PROF 6
+
+#ifndef LANDER_PROFILE
+
+#define PROF_SCOPE(stage)
+
+#else
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define PROF_BUCKETS 512
+
+struct ProfThread {
+  std::atomic<unsigned long long> count[N_PROF][PROF_BUCKETS];
+  std::atomic<unsigned long long> max[N_PROF];
+  ProfThread *next;
+};
+
+// Every thread that has recorded anything. Entries are never freed, so
+// a dump still sees threads that have exited
+inline std::atomic<ProfThread *> prof_threads(nullptr);
+inline std::atomic<int> prof_dump_requested(0);
+
+static inline unsigned long long Prof_Now(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+static inline double Prof_Clock_Ns(void) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Bucket of a duration: exact below 16 ticks, 8 steps per power of two above
+static inline int Prof_Bucket(unsigned long long t) {
+  if (t < 16) return (int)t;
+  int e = 63 - __builtin_clzll(t);
+  int b = 16 + (e - 4) * 8 + (int)((t >> (e - 3)) & 7);
+  return b < PROF_BUCKETS ? b : PROF_BUCKETS - 1;
+}
+
+// Middle of a bucket, in ticks
+static inline double Prof_Bucket_Mid(int b) {
+  if (b < 16) return b;
+  int e = (b - 16) / 8 + 4;
+  double lo = (double)(8 + (b - 16) % 8) * (double)(1ULL << (e - 3));
+  return lo + (double)(1ULL << (e - 3)) / 2;
+}
+
+// Ticks per nanosecond, measured from the first call to the latest one
+inline double Prof_Ticks_Per_Ns(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  static const unsigned long long t0 = Prof_Now();
+  static const double c0 = Prof_Clock_Ns();
+  double dc = Prof_Clock_Ns() - c0;
+  if (dc < 1e6) return 1;
+  return (double)(Prof_Now() - t0) / dc;
+#else
+  return 1;
+#endif
+}
+
+inline void Prof_Dump(void) {
+  static std::mutex lock;
+  std::lock_guard<std::mutex> hold(lock);
+  static const char *names[N_PROF] = {"control", "read", "estimate", "decide", "safety", "sim_step"};
+
+  double per_ns = Prof_Ticks_Per_Ns();
+  int nthreads = 0;
+  for (ProfThread *t = prof_threads.load(); t != nullptr; t = t->next) nthreads++;
+  fprintf(stderr, "latency profile, %d thread%s\n", nthreads, nthreads == 1 ? "" : "s");
+  fprintf(stderr, "  %-12s %10s %10s %10s %10s\n", "stage", "calls", "p50 ns", "p99 ns", "max ns");
+
+  static unsigned long long merged[PROF_BUCKETS];
+  for (int s = 0; s < N_PROF; s++) {
+    unsigned long long n = 0, mx = 0;
+    for (int b = 0; b < PROF_BUCKETS; b++) merged[b] = 0;
+    for (ProfThread *t = prof_threads.load(); t != nullptr; t = t->next) {
+      for (int b = 0; b < PROF_BUCKETS; b++) merged[b] += t->count[s][b].load(std::memory_order_relaxed);
+      unsigned long long m = t->max[s].load(std::memory_order_relaxed);
+      if (m > mx) mx = m;
+    }
+    for (int b = 0; b < PROF_BUCKETS; b++) n += merged[b];
+    if (n == 0) continue;
+
+    double p50 = 0, p99 = 0;
+    unsigned long long seen = 0;
+    for (int b = 0; b < PROF_BUCKETS; b++) {
+      if (merged[b] == 0) continue;
+      if (seen < (n + 1) / 2 && seen + merged[b] >= (n + 1) / 2) p50 = Prof_Bucket_Mid(b);
+      if (seen < n - n / 100 && seen + merged[b] >= n - n / 100) p99 = Prof_Bucket_Mid(b);
+      seen += merged[b];
+    }
+    fprintf(stderr, "  %-12s %10llu %10.0f %10.0f %10.0f\n", names[s], n,
+            p50 / per_ns, p99 / per_ns, mx / per_ns);
+  }
+}
+
+static inline void Prof_Signal(int) {
+  prof_dump_requested.store(1, std::memory_order_relaxed);
+}
+
+// Histograms of the calling thread, registered on first use. The first
+// registration also installs the exit and SIGUSR1 dumps
+inline ProfThread *Prof_This_Thread(void) {
+  thread_local ProfThread *self = nullptr;
+  if (self != nullptr) return self;
+
+  static std::once_flag setup;
+  std::call_once(setup, []() {
+    Prof_Ticks_Per_Ns();
+    atexit(Prof_Dump);
+    signal(SIGUSR1, Prof_Signal);
+  });
+
+  self = new ProfThread();
+  for (int s = 0; s < N_PROF; s++) {
+    for (int b = 0; b < PROF_BUCKETS; b++) self->count[s][b].store(0, std::memory_order_relaxed);
+    self->max[s].store(0, std::memory_order_relaxed);
+  }
+  self->next = prof_threads.load();
+  while (!prof_threads.compare_exchange_weak(self->next, self)) {}
+  return self;
+}
+
+class ProfScope {
+ public:
+  ProfScope(int stage) : stage(stage), t0(Prof_Now()) {}
+
+  ~ProfScope() {
+    unsigned long long t = Prof_Now() - t0;
+    ProfThread *pt = Prof_This_Thread();
+    std::atomic<unsigned long long> *c = &pt->count[stage][Prof_Bucket(t)];
+    c->store(c->load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (t > pt->max[stage].load(std::memory_order_relaxed)) pt->max[stage].store(t, std::memory_order_relaxed);
+    if (prof_dump_requested.load(std::memory_order_relaxed) && prof_dump_requested.exchange(0)) Prof_Dump();
+  }
+
+ private:
+  int stage;
+  unsigned long long t0;
+};
+
+#define PROF_JOIN2(a, b) a##b
+#define PROF_JOIN(a, b) PROF_JOIN2(a, b)
+#define PROF_SCOPE(stage) ProfScope PROF_JOIN(prof_scope_, __LINE__)(stage)
+
+#endif
+
+#endif
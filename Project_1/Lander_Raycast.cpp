@@ -0,0 +1,232 @@
+/*
+	Ray casting - see Lander_Raycast.h
+
+	The batch caster runs four rays per AVX2 vector in lockstep: every
+	round each live lane rounds its sample to a cell, gathers the field
+	value there, and either hits, skips ahead or runs out of range, and
+	the vector is done when no lane is live. Rounding is done exactly
+	as round() does it (halves away from zero) and the sample positions
+	with the same multiply and add as Ray_March(), so both find the same
+	hits. AVX-512 requests run the AVX2 caster: a gather is the bulk of
+	each round either way.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <immintrin.h>
+
+#include "Lander_Raycast.h"
+#include "Lander_Kernel.h"
+
+// Rays cast together, two vectors of four. Batches are padded to a
+// multiple of it
+#define RAY_WIDTH 8
+
+/*
+  Scalar
+*/
+
+static void Cast_Scalar(const LanderMap *map, RayBatch *rays) {
+  for (int k = 0; k < rays->n; k++)
+    rays->hit[k] = Ray_March(map, rays->x[k], rays->y[k], rays->dx[k], rays->dy[k], rays->r0[k], rays->r1[k]);
+}
+
+/*
+  AVX2
+*/
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+namespace avx2 {
+
+// round(), halves away from zero. v - trunc(v) is exact
+static inline __m256d Round(__m256d v) {
+  __m256d t = _mm256_round_pd(v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+  __m256d f = _mm256_sub_pd(v, t);
+  __m256d one = _mm256_set1_pd(1);
+  __m256d up = _mm256_and_pd(_mm256_cmp_pd(f, _mm256_set1_pd(.5), _CMP_GE_OQ), one);
+  __m256d down = _mm256_and_pd(_mm256_cmp_pd(f, _mm256_set1_pd(-.5), _CMP_LE_OQ), one);
+  return _mm256_sub_pd(_mm256_add_pd(t, up), down);
+}
+
+// Four rays in flight
+struct Lanes {
+  __m256d x, y, dx, dy;
+  __m256d r, r1;
+  __m256d hit, live;
+};
+
+static inline void Load(Lanes *l, const RayBatch *rays, int k) {
+  l->x = _mm256_loadu_pd(rays->x + k);
+  l->y = _mm256_loadu_pd(rays->y + k);
+  l->dx = _mm256_loadu_pd(rays->dx + k);
+  l->dy = _mm256_loadu_pd(rays->dy + k);
+  l->r = _mm256_loadu_pd(rays->r0 + k);
+  l->r1 = _mm256_loadu_pd(rays->r1 + k);
+  l->hit = _mm256_set1_pd(-1);
+  l->live = _mm256_cmp_pd(l->r, l->r1, _CMP_LT_OQ);
+}
+
+// One round: every live lane looks at its current sample
+static inline void Advance(Lanes *l, const LanderMap *map) {
+  const LanderSDF *sdf = map->sdf;
+  const __m256d zero = _mm256_setzero_pd();
+  const __m256d one = _mm256_set1_pd(1);
+  __m256d ci = Round(_mm256_add_pd(l->x, _mm256_mul_pd(l->r, l->dx)));
+  __m256d cj = Round(_mm256_add_pd(l->y, _mm256_mul_pd(l->r, l->dy)));
+  __m256d in = _mm256_and_pd(_mm256_and_pd(_mm256_cmp_pd(ci, zero, _CMP_GE_OQ), _mm256_cmp_pd(cj, zero, _CMP_GE_OQ)),
+                             _mm256_and_pd(_mm256_cmp_pd(ci, _mm256_set1_pd(map->sx), _CMP_LT_OQ),
+                                           _mm256_cmp_pd(cj, _mm256_set1_pd(map->sy), _CMP_LT_OQ)));
+  ci = _mm256_min_pd(_mm256_max_pd(ci, zero), _mm256_set1_pd(sdf->sx - 1));
+  cj = _mm256_min_pd(_mm256_max_pd(cj, zero), _mm256_set1_pd(sdf->sy - 1));
+  __m128i idx = _mm256_cvttpd_epi32(_mm256_add_pd(ci, _mm256_mul_pd(cj, _mm256_set1_pd(sdf->sx))));
+  __m128i bytes = _mm_i32gather_epi32((const int *)sdf->clear8, idx, 1);
+  __m256d d = _mm256_cvtepi32_pd(_mm_and_si128(bytes, _mm_set1_epi32(0xff)));
+
+  __m256d found = _mm256_and_pd(l->live, _mm256_and_pd(_mm256_cmp_pd(d, zero, _CMP_LE_OQ), in));
+  l->hit = _mm256_blendv_pd(l->hit, l->r, found);
+  l->live = _mm256_andnot_pd(found, l->live);
+  __m256d skip = _mm256_max_pd(_mm256_sub_pd(d, _mm256_set1_pd(2)), one);
+  l->r = _mm256_blendv_pd(l->r, _mm256_add_pd(l->r, skip), l->live);
+  l->live = _mm256_and_pd(l->live, _mm256_cmp_pd(l->r, l->r1, _CMP_LT_OQ));
+}
+
+// Two vectors at a time, so that one's gather is under way while the
+// other's waits
+static void Cast(const LanderMap *map, RayBatch *rays) {
+  for (int k = 0; k < rays->n; k += RAY_WIDTH) {
+    Lanes a, b;
+    Load(&a, rays, k);
+    Load(&b, rays, k + 4);
+    while (_mm256_movemask_pd(_mm256_or_pd(a.live, b.live))) {
+      Advance(&a, map);
+      Advance(&b, map);
+    }
+    _mm256_storeu_pd(rays->hit + k, a.hit);
+    _mm256_storeu_pd(rays->hit + k + 4, b.hit);
+  }
+}
+
+}
+#pragma GCC pop_options
+
+/*
+  Ray storage
+*/
+
+int Rays_Alloc(RayBatch *rays, int n) {
+  memset(rays, 0, sizeof(RayBatch));
+  return Rays_Reserve(rays, n);
+}
+
+int Rays_Reserve(RayBatch *rays, int n) {
+  if (n <= rays->cap) return 1;
+  int cap = (n + RAY_WIDTH - 1) / RAY_WIDTH * RAY_WIDTH;
+  double **arrays[] = {&rays->x, &rays->y, &rays->dx, &rays->dy, &rays->r0, &rays->r1, &rays->hit};
+  for (int a = 0; a < 7; a++) {
+    double *p = (double *)realloc(*arrays[a], cap * sizeof(double));
+    if (p == NULL) return 0;
+    memset(p + rays->cap, 0, (cap - rays->cap) * sizeof(double));
+    *arrays[a] = p;
+  }
+  rays->cap = cap;
+  return 1;
+}
+
+void Rays_Free(RayBatch *rays) {
+  free(rays->x);
+  free(rays->y);
+  free(rays->dx);
+  free(rays->dy);
+  free(rays->r0);
+  free(rays->r1);
+  free(rays->hit);
+  memset(rays, 0, sizeof(RayBatch));
+}
+
+/*
+  Casting
+*/
+
+void Ray_Cast(const LanderMap *map, RayBatch *rays, int isa) {
+  // Padding rays sample nothing
+  for (int k = rays->n; k < rays->cap && k % RAY_WIDTH; k++) {
+    rays->x[k] = rays->y[k] = rays->dx[k] = rays->dy[k] = 0;
+    rays->r0[k] = rays->r1[k] = 0;
+  }
+  if (map->sdf != NULL && Kernel_Resolve_ISA(isa) >= KERNEL_AVX2) avx2::Cast(map, rays);
+  else Cast_Scalar(map, rays);
+}
+
+// The map every flying lander of sims[0..n) is on. NULL if none is
+// flying, or if they are not all on one map
+static const LanderMap *Shared_Map(const LanderSim *sims, int n) {
+  const LanderMap *map = NULL;
+  for (int k = 0; k < n; k++) {
+    if (sims[k].status != SIM_FLYING) continue;
+    if (map != NULL && sims[k].map != map) return NULL;
+    map = sims[k].map;
+  }
+  return map;
+}
+
+void Raycast_Step(LanderSim *sims, int n, RayBatch *rays, int isa) {
+  const LanderMap *map = Shared_Map(sims, n);
+  if (map == NULL || !Rays_Reserve(rays, 36 * n)) {
+    for (int k = 0; k < n; k++) Sim_Step(&sims[k]);
+    return;
+  }
+
+  // Move every lander and line up the beams that march this step
+  rays->n = 0;
+  for (int k = 0; k < n; k++) {
+    LanderSim *sim = &sims[k];
+    if (sim->status != SIM_FLYING) continue;
+    Sim_Step_Move(sim);
+    for (int i = 0; i < 36; i++) {
+      int j = rays->n;
+      if (!Sim_Beam(sim, i, &rays->dx[j], &rays->dy[j], &rays->r0[j], &rays->r1[j])) continue;
+      rays->x[j] = sim->x;
+      rays->y[j] = sim->y;
+      rays->n++;
+    }
+  }
+  Ray_Cast(map, rays, isa);
+
+  // Hand the returns back in the same order and finish the steps
+  int j = 0;
+  double dx, dy, r0, r1;
+  for (int k = 0; k < n; k++) {
+    LanderSim *sim = &sims[k];
+    if (sim->status != SIM_FLYING) continue;
+    for (int i = 0; i < 36; i++)
+      if (Sim_Beam(sim, i, &dx, &dy, &r0, &r1)) Sim_Sonar_Return(sim, i, rays->hit[j++]);
+    Sim_Step_Finish(sim);
+  }
+}
+
+void Raycast_RangeDist(LanderSim *sims, int n, RayBatch *rays, double *range, int isa) {
+  const LanderMap *map = Shared_Map(sims, n);
+  if (map == NULL || !Rays_Reserve(rays, n)) {
+    for (int k = 0; k < n; k++) range[k] = sims[k].status == SIM_FLYING ? Sim_RangeDist(&sims[k]) : -1;
+    return;
+  }
+
+  rays->n = 0;
+  for (int k = 0; k < n; k++) {
+    LanderSim *sim = &sims[k];
+    if (sim->status != SIM_FLYING) continue;
+    int j = rays->n++;
+    Sim_Range_Ray(sim, &rays->dx[j], &rays->dy[j]);
+    rays->x[j] = sim->x;
+    rays->y[j] = sim->y;
+    rays->r0[j] = 0;
+    rays->r1[j] = MAP_SIZE;
+  }
+  Ray_Cast(map, rays, isa);
+
+  int j = 0;
+  for (int k = 0; k < n; k++)
+    range[k] = sims[k].status == SIM_FLYING ? Sim_Range_Return(&sims[k], rays->hit[j++]) : -1;
+}
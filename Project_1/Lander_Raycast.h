@@ -0,0 +1,89 @@
+/*
+	Ray casting against a terrain map.
+
+	A ray samples the map at r0, r0 + 1, ... up to (not including) r1
+	pixels from its origin along a unit direction, rounding each sample
+	to the nearest cell, and hits at the first sample that lands on a
+	solid cell. Cells off the map are open. This is how the sonar beams
+	and the RangeDist() ray of Lander_Sim have always been marched, one
+	pixel at a time.
+
+	With the map's distance field (Lander_SDF.h) the march skips ahead
+	instead: a sample whose cell is d pixels from the nearest solid cell
+	cannot be followed by a solid cell for the next d - sqrt(2) samples
+	(the rounding moves each sample by at most sqrt(2)/2), so those are
+	not looked at. The byte copy of the field is used, with d rounded
+	down, so that the field of a whole map stays in cache. A hit is the
+	same sample the pixel march finds, only reached in a handful of
+	lookups.
+
+	Ray_March() casts one ray. Ray_Cast() casts a batch of them in
+	structure-of-arrays form, several rays per vector instruction, and
+	Raycast_Step() and Raycast_RangeDist() use it to cast the sonar
+	beams and RangeDist() rays of many landers at once.
+*/
+
+#ifndef _LANDER_RAYCAST_H
+#define _LANDER_RAYCAST_H
+
+#include <math.h>
+
+#include "Lander_Sim.h"
+#include "Lander_SDF.h"
+
+struct RayBatch {
+  int n;                  // Rays in use
+  int cap;                // Allocated rays, a multiple of the widest vector
+  double *x, *y;          // Origin (pixels)
+  double *dx, *dy;        // Direction, unit length
+  double *r0, *r1;        // Sampled distances, r0 <= r < r1
+  double *hit;            // Output: distance of the first solid sample, -1 if none
+};
+
+// Allocate and free the ray arrays, returns 0 on failure. Rays_Reserve
+// grows a batch to hold at least n rays, keeping its contents
+int Rays_Alloc(RayBatch *rays, int n);
+int Rays_Reserve(RayBatch *rays, int n);
+void Rays_Free(RayBatch *rays);
+
+// Cast every ray of the batch. isa is one of KERNEL_* (Lander_Kernel.h),
+// every instruction set gives the same hits
+void Ray_Cast(const LanderMap *map, RayBatch *rays, int isa);
+
+// Sim_Step() for every flying lander of sims[0..n), with the sonar beams
+// of all of them cast as one batch. A batch casts against one map, so
+// landers that are not all on one map are stepped one at a time
+// instead. rays is scratch space
+void Raycast_Step(LanderSim *sims, int n, RayBatch *rays, int isa);
+
+// Sim_RangeDist() for every flying lander of sims[0..n), cast as one
+// batch when they are all on one map, like Raycast_Step(). Landers that
+// are not flying read -1
+void Raycast_RangeDist(LanderSim *sims, int n, RayBatch *rays, double *range, int isa);
+
+// Cast one ray
+static inline double Ray_March(const LanderMap *map, double x, double y, double dx, double dy, double r0, double r1) {
+  const LanderSDF *sdf = map->sdf;
+  for (double r = r0; r < r1;) {
+    int ci = (int)round(x + r * dx);
+    int cj = (int)round(y + r * dy);
+    int in = ci >= 0 && cj >= 0 && ci < map->sx && cj < map->sy;
+    if (sdf == NULL) {
+      if (in && Terrain_Solid(&map->terrain, ci, cj)) return r;
+      r += 1;
+      continue;
+    }
+
+    // Off the map the nearest border cell can only under-estimate the
+    // clearance, a solid border cell just means one step. With d whole,
+    // d - 2 samples are clear
+    ci = ci < 0 ? 0 : (ci >= sdf->sx ? sdf->sx - 1 : ci);
+    cj = cj < 0 ? 0 : (cj >= sdf->sy ? sdf->sy - 1 : cj);
+    int d = sdf->clear8[ci + cj * sdf->sx];
+    if (d == 0 && in) return r;
+    r += d > 3 ? d - 2 : 1;
+  }
+  return -1;
+}
+
+#endif
@@ -0,0 +1,214 @@
+/*
+	Flight recorder - see Lander_Recorder.h
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "Lander_Recorder.h"
+
+/*
+  Capture
+*/
+
+int Recorder_Init(FlightRecorder *rec) {
+  rec->frames = (FlightFrame *)malloc(REC_FRAMES * sizeof(FlightFrame));
+  rec->count = 0;
+  rec->flushed = 0;
+  return rec->frames != NULL;
+}
+
+void Recorder_Free(FlightRecorder *rec) {
+  free(rec->frames);
+  rec->frames = NULL;
+}
+
+static short Sonar_Short(double r) {
+  if (r < 0) return -1;
+  return r > 32767 ? 32767 : (short)lround(r);
+}
+
+void Frame_Capture(FlightFrame *f, const LanderSim *sim, const LanderController *ctl) {
+  const SensorSnapshot *snap = ctl->Snapshot();
+  const StateEstimator *est = ctl->Estimator();
+  const IssuedCommands *cmd = ctl->Commands();
+
+  f->tick = (int)sim->ticks;
+  f->flags = (snap->MT_OK ? FRAME_MT_OK : 0) | (snap->LT_OK ? FRAME_LT_OK : 0) |
+             (snap->RT_OK ? FRAME_RT_OK : 0) | (cmd->rotated ? FRAME_ROTATED : 0);
+  f->phase = (unsigned char)(ctl->Phase() < 0 ? 0 : ctl->Phase());
+  f->failed = 0;
+  for (int i = 0; i < N_SENS; i++)
+    if (est->Failed(i)) f->failed |= 1 << i;
+  for (int i = 0; i < 36; i++) f->sonar[i] = Sonar_Short(snap->sonar[i]);
+
+  f->x = sim->x;
+  f->y = sim->y;
+  f->vx = sim->vx;
+  f->vy = sim->vy;
+  f->theta = sim->theta;
+  f->s_vx = snap->vx;
+  f->s_vy = snap->vy;
+  f->s_px = snap->px;
+  f->s_py = snap->py;
+  f->s_angle = snap->angle;
+  f->s_range = snap->range;
+  f->e_px = est->Position_X();
+  f->e_py = est->Position_Y();
+  f->e_vx = est->Velocity_X();
+  f->e_vy = est->Velocity_Y();
+  f->e_angle = est->Angle();
+  f->main_pw = cmd->main_pw;
+  f->left_pw = cmd->left_pw;
+  f->right_pw = cmd->right_pw;
+  f->rotate = cmd->rotate;
+  f->d_main = sim->main_pw;
+  f->d_left = sim->left_pw;
+  f->d_right = sim->right_pw;
+}
+
+void Recorder_Capture(FlightRecorder *rec, const LanderSim *sim, const LanderController *ctl) {
+  Frame_Capture(&rec->frames[rec->count % REC_FRAMES], sim, ctl);
+  rec->count++;
+}
+
+/*
+  Flushing. Each flush owns a copy of the frames and queues it for one
+  writer thread, started by the first flush and stopped by
+  Recorder_Wait()
+*/
+
+struct PendingTrace {
+  char *fname;                  // NULL tells the writer to stop
+  TraceHeader *head;
+  FlightFrame *frames;
+};
+
+static std::mutex flush_lock;
+static std::condition_variable flush_ready;
+static std::deque<PendingTrace> flush_queue;
+static std::thread writer;
+
+static void Write_Trace(char *fname, TraceHeader *head, FlightFrame *frames) {
+  FILE *f = fopen(fname, "wb");
+  if (f == NULL) fprintf(stderr, "Unable to open file %s for writing\n", fname);
+  else {
+    int ok = fwrite(head, sizeof(TraceHeader), 1, f) == 1 &&
+             fwrite(frames, sizeof(FlightFrame), head->nframes, f) == (size_t)head->nframes;
+    if (fclose(f) != 0) ok = 0;
+    if (!ok) fprintf(stderr, "Failed to write flight trace %s\n", fname);
+  }
+  free(fname);
+  free(head);
+  free(frames);
+}
+
+static void Writer(void) {
+  for (;;) {
+    PendingTrace t;
+    {
+      std::unique_lock<std::mutex> g(flush_lock);
+      flush_ready.wait(g, [] { return !flush_queue.empty(); });
+      t = flush_queue.front();
+      flush_queue.pop_front();
+    }
+    if (t.fname == NULL) return;
+    Write_Trace(t.fname, t.head, t.frames);
+  }
+}
+
+static void Enqueue(PendingTrace t) {
+  {
+    std::lock_guard<std::mutex> g(flush_lock);
+    if (!writer.joinable()) writer = std::thread(Writer);
+    flush_queue.push_back(t);
+  }
+  flush_ready.notify_one();
+}
+
+int Recorder_Flush(FlightRecorder *rec, const LanderSim *sim, const char *map_name,
+                   long seed, const char *fname) {
+  if (rec->flushed) return 1;
+  rec->flushed = 1;
+
+  int n = rec->count < REC_FRAMES ? (int)rec->count : REC_FRAMES;
+  TraceHeader *head = (TraceHeader *)calloc(1, sizeof(TraceHeader));
+  FlightFrame *frames = (FlightFrame *)malloc((n > 0 ? n : 1) * sizeof(FlightFrame));
+  char *name = strdup(fname);
+  if (head == NULL || frames == NULL || name == NULL) {
+    fprintf(stderr, "Out of memory flushing flight trace %s\n", fname);
+    free(head);
+    free(frames);
+    free(name);
+    return 0;
+  }
+
+  memcpy(head->magic, "LTRC", 4);
+  head->version = TRACE_VERSION;
+  snprintf(head->map_name, sizeof(head->map_name), "%s", map_name);
+  head->fail_mode = sim->fail_mode;
+  memcpy(head->f_list, sim->f_list, sizeof(head->f_list));
+  head->seed = seed;
+  head->status = sim->status;
+  head->nframes = n;
+  head->time = sim->sim_time;
+  head->td_vx = sim->td_vx;
+  head->td_vy = sim->td_vy;
+  head->td_angle = sim->td_angle;
+
+  // Oldest frame first
+  long first = rec->count - n;
+  for (int k = 0; k < n; k++) frames[k] = rec->frames[(first + k) % REC_FRAMES];
+
+  PendingTrace t = {name, head, frames};
+  Enqueue(t);
+  return 1;
+}
+
+void Recorder_Wait(void) {
+  {
+    std::lock_guard<std::mutex> g(flush_lock);
+    if (!writer.joinable()) return;
+  }
+  PendingTrace stop = {NULL, NULL, NULL};
+  Enqueue(stop);
+  writer.join();
+}
+
+/*
+  Reading traces
+*/
+
+int Trace_Load(const char *fname, TraceHeader *head, FlightFrame **frames) {
+  *frames = NULL;
+  FILE *f = fopen(fname, "rb");
+  if (f == NULL) {
+    fprintf(stderr, "Unable to open file %s for reading, please check name and path\n", fname);
+    return 0;
+  }
+  if (fread(head, sizeof(TraceHeader), 1, f) != 1 || memcmp(head->magic, "LTRC", 4) ||
+      head->version != TRACE_VERSION || head->nframes < 0 || head->nframes > REC_FRAMES) {
+    fprintf(stderr, "%s is not a flight trace of this version\n", fname);
+    fclose(f);
+    return 0;
+  }
+  head->map_name[sizeof(head->map_name) - 1] = '\0';
+  *frames = (FlightFrame *)malloc((head->nframes > 0 ? head->nframes : 1) * sizeof(FlightFrame));
+  if (*frames == NULL ||
+      fread(*frames, sizeof(FlightFrame), head->nframes, f) != (size_t)head->nframes) {
+    fprintf(stderr, "Failed to read frames from %s\n", fname);
+    free(*frames);
+    *frames = NULL;
+    fclose(f);
+    return 0;
+  }
+  fclose(f);
+  return 1;
+}
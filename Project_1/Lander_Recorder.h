@@ -0,0 +1,92 @@
+/*
+	Flight recorder.
+
+	Keeps the last REC_FRAMES ticks of a flight in a fixed ring of
+	compact frames: the true lander state, every sensor reading the
+	flight computer took, its estimates and failed-sensor flags, and
+	the commands it gave. Capturing a frame is a copy of a few hundred
+	bytes, so the recorder can run on every episode of a batch.
+
+	When a flight ends badly the ring is flushed once, as a small .ltr
+	trace (about 350 KB for a full ring) queued for a single background
+	writer thread. Images are only made when someone asks for them:
+	Lander_Trace prints a trace or renders any range of its frames over
+	the map.
+*/
+
+#ifndef _LANDER_RECORDER_H
+#define _LANDER_RECORDER_H
+
+#include "Lander_Sim.h"
+
+#define TRACE_VERSION 2
+
+// Ring size, 2048 ticks is the last 10 seconds of flight
+#define REC_FRAMES 2048
+
+// Flag bits in FlightFrame::flags
+#define FRAME_MT_OK 1           // Thruster status as the controller saw it
+#define FRAME_LT_OK 2
+#define FRAME_RT_OK 4
+#define FRAME_ROTATED 8         // Rotate() was called this tick
+
+// One tick, captured after the flight computer has acted and before
+// the simulation steps
+struct FlightFrame {
+  int tick;
+  unsigned char flags;          // FRAME_*
+  unsigned char failed;         // Bit per SENS_* flagged failed by the estimator
+  unsigned char phase;          // Flight phase (PHASE_*, see Lander_Phase.h)
+  short sonar[36];              // Sonar readings (pixels, rounded), -1 for none
+
+  float x, y, vx, vy, theta;    // True state (pixels, m/s, radians)
+  float s_vx, s_vy, s_px, s_py, s_angle, s_range;  // Sensor readings
+  float e_px, e_py, e_vx, e_vy, e_angle;           // Estimates
+  float main_pw, left_pw, right_pw, rotate;        // Commands given
+  float d_main, d_left, d_right;                   // Power actually delivered
+};
+
+// Trace file header, followed by nframes FlightFrames oldest first
+struct TraceHeader {
+  char magic[4];                // "LTRC"
+  int version;
+  char map_name[256];
+  int fail_mode;
+  int f_list[N_COMP];           // Mode 3 components, 1 = disabled
+  long seed;
+  int status;                   // How the flight ended (SIM_*)
+  int nframes;
+  double time;                  // Simulated time at the end
+  double td_vx, td_vy, td_angle;
+};
+
+struct FlightRecorder {
+  FlightFrame *frames;
+  long count;                   // Frames captured so far
+  int flushed;
+};
+
+// Allocate and free the ring, Recorder_Init returns 0 on failure
+int Recorder_Init(FlightRecorder *rec);
+void Recorder_Free(FlightRecorder *rec);
+
+// Fill a frame with the current tick
+void Frame_Capture(FlightFrame *f, const LanderSim *sim, const LanderController *ctl);
+
+// Record the current tick
+void Recorder_Capture(FlightRecorder *rec, const LanderSim *sim, const LanderController *ctl);
+
+// Write the ring to fname in the background. Only the first call per
+// recorder writes anything, later calls return at once. The ring may be
+// reused or freed as soon as this returns
+int Recorder_Flush(FlightRecorder *rec, const LanderSim *sim, const char *map_name,
+                   long seed, const char *fname);
+
+// Wait for every queued flush to be written and stop the writer. Call
+// before exiting, once no more flushes are coming
+void Recorder_Wait(void);
+
+// Read a trace back. *frames is malloc'd, returns 0 on failure
+int Trace_Load(const char *fname, TraceHeader *head, FlightFrame **frames);
+
+#endif
@@ -0,0 +1,195 @@
+/*
+	Record and replay landings.
+
+	Recording flies one seeded landing in the headless simulator and
+	writes every call the flight computer made to an IO log (see
+	Lander_IOLog.h). Replaying feeds a log back through a fresh
+	LanderController's Lander_Control() and Safety_Override(), without
+	a simulator, and checks that every command it gives is bit-identical
+	to the logged one.
+
+	Usage: Lander_Replay -r log [-s seed] [-t max_time] [-p policy] [-P params] [-a] MapName FailMode [component1] ...
+	       Lander_Replay log1 [log2 ...]
+
+	-p, -P and -a are those of Lander_Batch. The log keeps them: the
+	replay flies the recorded gains, and maps the recorded policy table
+	and checks that it is the one recorded with.
+
+	Because the simulator's randomness is counter-based streams keyed by
+	the seed (see Lander_Sim.h), a seed that fails in Lander_Batch fails
+	the same way here, given the same options. To bisect a regression, record the failing seed
+	with a good build, then replay the log with each candidate build: a
+	bad build reports the first tick and call where it departs from the
+	log. The exit status is 0 if every log replayed identically, 2 if
+	one diverged.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Lander_IOLog.h"
+
+static void Usage(void) {
+  fprintf(stderr, "Usage: Lander_Replay -r log [-s seed] [-t max_time] [-p policy] [-P params] [-a] MapName FailMode [component1] ... [component9]\n");
+  fprintf(stderr, "       Lander_Replay log1 [log2 ...]\n");
+}
+
+// FNV-1a over a policy table, so a replay can tell it maps the same one
+static unsigned long long Policy_Sum(const LanderPolicy *pol) {
+  const unsigned char *p = (const unsigned char *)pol->file.base;
+  unsigned long long h = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < pol->file.len; i++) h = (h ^ p[i]) * 0x100000001b3ULL;
+  return h;
+}
+
+// What to fly besides the scenario, as Lander_Batch takes it
+struct RecordOptions {
+  const char *policy_name;      // NULL for the velocity limits
+  const char *params_name;      // NULL for the defaults
+  int exact_contact;
+};
+
+static int Record(const char *log_name, long seed, double max_time, const RecordOptions *opt, int argc, char *argv[]) {
+  const char *map_name = argv[0];
+  int fail_mode = (int)strtol(argv[1], NULL, 10);
+  int comps[N_COMP];
+  int ncomps = 0;
+  for (int i = 2; i < argc && ncomps < N_COMP; i++)
+    comps[ncomps++] = (int)strtol(argv[i], NULL, 10);
+
+  static LanderMap map;
+  static LanderShape shape;
+  if (!Sim_Load_Map(map_name, &map)) return 1;
+  if (!Sim_Load_Shape("lander.ppm", &shape)) {
+    fprintf(stderr, "Unable to load lander image. Ensure it is in the same directory\n");
+    return 1;
+  }
+
+  static LanderPolicy policy;
+  if (opt->policy_name != NULL && !Policy_Map(opt->policy_name, &policy)) return 1;
+  ControllerParams params;
+  Params_Default(&params);
+  if (opt->params_name != NULL && !Params_Load(opt->params_name, &params)) return 1;
+
+  static LanderSim sim;
+  Sim_Reset(&sim, &map, &shape, fail_mode, comps, ncomps, seed);
+  sim.max_time = max_time;
+  Sim_Set_Exact_Contact(&sim, opt->exact_contact);
+  SimIO io(&sim);
+  std::vector<IOEvent> events;
+  RecordIO rec(&io, &events);
+  LanderController controller(&rec);
+  controller.Set_Params(&params);
+  if (opt->policy_name != NULL) controller.Set_Policy(&policy);
+  while (sim.status == SIM_FLYING) {
+    controller.Lander_Control();
+    controller.Safety_Override();
+    rec.End_Tick();
+    Sim_Step(&sim);
+  }
+
+  IOLogHeader head;
+  memset(&head, 0, sizeof(head));
+  memcpy(head.magic, "LIOL", 4);
+  head.version = IOLOG_VERSION;
+  snprintf(head.map_name, sizeof(head.map_name), "%s", map_name);
+  head.fail_mode = fail_mode;
+  memcpy(head.f_list, sim.f_list, sizeof(head.f_list));
+  head.seed = seed;
+  head.max_time = max_time;
+  head.exact_contact = opt->exact_contact;
+  if (opt->policy_name != NULL) {
+    snprintf(head.policy_name, sizeof(head.policy_name), "%s", opt->policy_name);
+    head.policy_sum = Policy_Sum(&policy);
+  }
+  head.params = params;
+  head.status = sim.status;
+  head.ticks = (int)sim.ticks;
+  head.nevents = (long)events.size();
+  if (!IOLog_Save(log_name, &head, &events)) return 1;
+
+  printf("%s: map=%s mode=%d seed=%ld status=%s time=%.3f ticks=%d events=%ld\n",
+         log_name, map_name, fail_mode, seed, Sim_Status_Name(sim.status), sim.sim_time,
+         head.ticks, head.nevents);
+  if (opt->policy_name != NULL) Policy_Free(&policy);
+  Sim_Free_Map(&map);
+  return 0;
+}
+
+// Returns 1 if the log replayed identically
+static int Replay(const char *log_name) {
+  IOLogHeader head;
+  std::vector<IOEvent> events;
+  if (!IOLog_Load(log_name, &head, &events)) return 0;
+
+  // Fly what was recorded
+  LanderPolicy policy;
+  if (head.policy_name[0] != '\0') {
+    if (!Policy_Map(head.policy_name, &policy)) return 0;
+    if (Policy_Sum(&policy) != head.policy_sum) {
+      fprintf(stderr, "%s: policy table %s is not the one recorded with\n", log_name, head.policy_name);
+      Policy_Free(&policy);
+      return 0;
+    }
+  }
+
+  clock_t t0 = clock();
+  ReplayIO io(&events);
+  LanderController controller(&io);
+  controller.Set_Params(&head.params);
+  if (head.policy_name[0] != '\0') controller.Set_Policy(&policy);
+  while (!io.Finished() && !io.Diverged()) {
+    controller.Lander_Control();
+    controller.Safety_Override();
+    io.End_Tick();
+  }
+  double ms = (double)(clock() - t0) * 1000 / CLOCKS_PER_SEC;
+
+  printf("%s: map=%s mode=%d seed=%ld%s%s%s status=%s: ", log_name, head.map_name, head.fail_mode,
+         head.seed, head.policy_name[0] != '\0' ? " policy=" : "", head.policy_name,
+         head.exact_contact ? " exact" : "", Sim_Status_Name(head.status));
+  if (io.Diverged()) printf("DIVERGED at %s\n", io.Divergence());
+  else printf("%d ticks replayed, commands bit-identical (%.1f ms)\n", io.Tick(), ms);
+  if (head.policy_name[0] != '\0') Policy_Free(&policy);
+  return !io.Diverged();
+}
+
+int main(int argc, char *argv[]) {
+  const char *record = NULL;
+  long seed = 1;
+  double max_time = 300;
+  RecordOptions opt = {NULL, NULL, 0};
+
+  int a = 1;
+  while (a < argc && argv[a][0] == '-') {
+    if (!strcmp(argv[a], "-r") && a + 1 < argc) record = argv[++a];
+    else if (!strcmp(argv[a], "-s") && a + 1 < argc) seed = strtol(argv[++a], NULL, 10);
+    else if (!strcmp(argv[a], "-t") && a + 1 < argc) max_time = atof(argv[++a]);
+    else if (!strcmp(argv[a], "-p") && a + 1 < argc) opt.policy_name = argv[++a];
+    else if (!strcmp(argv[a], "-P") && a + 1 < argc) opt.params_name = argv[++a];
+    else if (!strcmp(argv[a], "-a")) opt.exact_contact = 1;
+    else {
+      Usage();
+      return 1;
+    }
+    a++;
+  }
+
+  if (record != NULL) {
+    if (argc - a < 2) {
+      Usage();
+      return 1;
+    }
+    return Record(record, seed, max_time, &opt, argc - a, argv + a);
+  }
+
+  if (a >= argc) {
+    Usage();
+    return 1;
+  }
+  int same = 1;
+  for (; a < argc; a++) same &= Replay(argv[a]);
+  return same ? 0 : 2;
+}
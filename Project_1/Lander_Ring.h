@@ -0,0 +1,52 @@
+/*
+	Lock-free single producer, single consumer ring.
+
+	One thread fills slots, one other thread drains them, with no locks
+	and no waiting on either side: when the ring is full the producer
+	is told so and carries on (the item is dropped), when it is empty
+	the consumer is. Items are written and read in place, so publishing
+	one costs a copy into the slot and one release store.
+
+	N must be a power of two.
+*/
+
+#ifndef _LANDER_RING_H
+#define _LANDER_RING_H
+
+#include <atomic>
+
+template <typename T, int N>
+class SpscRing {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "ring size must be a power of two");
+
+ public:
+  SpscRing() : head(0), tail(0) {}
+
+  // Producer: the slot to fill next, NULL if the ring is full. The item
+  // becomes visible to the consumer on Publish()
+  T *Claim() {
+    unsigned long h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) >= (unsigned long)N) return NULL;
+    return &slot[h & (N - 1)];
+  }
+  void Publish() { head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+  // Consumer: the oldest item, NULL if the ring is empty. The slot stays
+  // valid until Release()
+  const T *Peek() {
+    unsigned long t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) return NULL;
+    return &slot[t & (N - 1)];
+  }
+  void Release() { tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+ private:
+  T slot[N];
+
+  // Items published and released so far. Kept on separate cache lines,
+  // each is written by one side only
+  alignas(64) std::atomic<unsigned long> head;
+  alignas(64) std::atomic<unsigned long> tail;
+};
+
+#endif
@@ -0,0 +1,235 @@
+/*
+	Terrain distance fields - see Lander_SDF.h
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Lander_SDF.h"
+
+#define SDF_INF 1e20
+
+/*
+  Distance transform
+*/
+
+// Squared distance transform of a sampled function along one line
+// (Felzenszwalb & Huttenlocher). f and d have n entries, v and z are
+// scratch space of n and n + 1 entries
+static void EDT_1D(const double *f, double *d, int n, int *v, double *z) {
+  int k = 0;
+  v[0] = 0;
+  z[0] = -SDF_INF;
+  z[1] = SDF_INF;
+  for (int q = 1; q < n; q++) {
+    double s = ((f[q] + (double)q * q) - (f[v[k]] + (double)v[k] * v[k])) / (2.0 * (q - v[k]));
+    while (s <= z[k]) {
+      k--;
+      s = ((f[q] + (double)q * q) - (f[v[k]] + (double)v[k] * v[k])) / (2.0 * (q - v[k]));
+    }
+    k++;
+    v[k] = q;
+    z[k] = s;
+    z[k + 1] = SDF_INF;
+  }
+  k = 0;
+  for (int q = 0; q < n; q++) {
+    while (z[k + 1] < q) k++;
+    double dq = q - v[k];
+    d[q] = dq * dq + f[v[k]];
+  }
+}
+
+// Distance from every cell to the nearest cell where target is set.
+// out receives plain (not squared) distances
+static int EDT_2D(const unsigned char *target, int sx, int sy, float *out) {
+  if (sx <= 0 || sy <= 0) return 0;
+  int n = sx > sy ? sx : sy;
+  double *g = (double *)malloc((size_t)sx * sy * sizeof(double));
+  double *f = (double *)malloc(n * sizeof(double));
+  double *d = (double *)malloc(n * sizeof(double));
+  double *z = (double *)malloc((n + 1) * sizeof(double));
+  int *v = (int *)malloc(n * sizeof(int));
+  if (g == NULL || f == NULL || d == NULL || z == NULL || v == NULL) {
+    free(g); free(f); free(d); free(z); free(v);
+    return 0;
+  }
+
+  // Columns, then rows
+  for (int i = 0; i < sx; i++) {
+    for (int j = 0; j < sy; j++) f[j] = target[i + j * sx] ? 0 : SDF_INF;
+    EDT_1D(f, d, sy, v, z);
+    for (int j = 0; j < sy; j++) g[i + j * sx] = d[j];
+  }
+  for (int j = 0; j < sy; j++) {
+    EDT_1D(g + (size_t)j * sx, d, sx, v, z);
+    for (int i = 0; i < sx; i++) out[i + j * sx] = (float)sqrt(d[i]);
+  }
+
+  free(g); free(f); free(d); free(z); free(v);
+  return 1;
+}
+
+/*
+  Fields
+*/
+
+unsigned long long Sdf_Map_Hash(const LanderMap *map) {
+  // FNV-1a
+  unsigned long long h = 1469598103934665603ULL;
+  for (int j = 0; j < map->sy; j++) {
+    for (int i = 0; i < map->sx; i++) {
+      h ^= Map_Cell(map, i, j);
+      h *= 1099511628211ULL;
+    }
+  }
+  return h;
+}
+
+// Fills clear8 from dist, returns 0 if out of memory. Three bytes of
+// padding let a gather read whole words at the last cell
+static int Sdf_Derive(LanderSDF *sdf) {
+  size_t n = (size_t)sdf->sx * sdf->sy;
+  sdf->clear8 = (unsigned char *)calloc(n + 3, 1);
+  if (sdf->clear8 == NULL) return 0;
+  for (size_t k = 0; k < n; k++) {
+    float d = sdf->dist[k];
+    sdf->clear8[k] = d <= 0 ? 0 : (d >= 255 ? 255 : (unsigned char)d);
+  }
+  return 1;
+}
+
+int Sdf_Build(const LanderMap *map, LanderSDF *sdf) {
+  int n = map->sx * map->sy;
+  memset(sdf, 0, sizeof(LanderSDF));
+  if (n <= 0) {
+    fprintf(stderr, "Empty map, no distance field to build\n");
+    return 0;
+  }
+  sdf->dist = (float *)malloc(n * sizeof(float));
+  sdf->plat = (float *)malloc(n * sizeof(float));
+  float *inside = (float *)malloc(n * sizeof(float));
+  unsigned char *cells = (unsigned char *)malloc(n);
+  unsigned char *mask = (unsigned char *)malloc(n);
+  if (sdf->dist == NULL || sdf->plat == NULL || inside == NULL || cells == NULL || mask == NULL) {
+    fprintf(stderr, "Out of memory building distance field\n");
+    free(inside);
+    free(cells);
+    free(mask);
+    Sdf_Free(sdf);
+    return 0;
+  }
+  sdf->sx = map->sx;
+  sdf->sy = map->sy;
+
+  // Unpack the cells once, the masks are all made from them
+  for (int j = 0; j < map->sy; j++)
+    for (int i = 0; i < map->sx; i++) cells[i + j * map->sx] = Map_Cell(map, i, j);
+
+  // Stop at the first transform that fails, the fields are only
+  // combined once all three are there
+  int ok;
+  for (int k = 0; k < n; k++) mask[k] = cells[k] != CELL_OPEN;
+  ok = EDT_2D(mask, map->sx, map->sy, sdf->dist);
+  if (ok) {
+    for (int k = 0; k < n; k++) mask[k] = cells[k] == CELL_OPEN;
+    ok = EDT_2D(mask, map->sx, map->sy, inside);
+  }
+  if (ok) {
+    for (int k = 0; k < n; k++) mask[k] = cells[k] == CELL_PLATFORM;
+    ok = EDT_2D(mask, map->sx, map->sy, sdf->plat);
+  }
+  if (ok)
+    for (int k = 0; k < n; k++)
+      if (cells[k] != CELL_OPEN) sdf->dist[k] = -inside[k];
+
+  free(inside);
+  free(cells);
+  free(mask);
+  if (!ok || !Sdf_Derive(sdf)) {
+    fprintf(stderr, "Out of memory building distance field\n");
+    Sdf_Free(sdf);
+    return 0;
+  }
+  sdf->hash = Sdf_Map_Hash(map);
+  return 1;
+}
+
+void Sdf_Free(LanderSDF *sdf) {
+  free(sdf->dist);
+  free(sdf->plat);
+  free(sdf->clear8);
+  sdf->dist = NULL;
+  sdf->plat = NULL;
+  sdf->clear8 = NULL;
+}
+
+/*
+  Files: "LSDF", version, sx, sy, map hash, then the dist and plat
+  fields as row-major floats
+*/
+
+void Sdf_File_Name(const char *map_name, char *out, int len) {
+  snprintf(out, len, "%s", map_name);
+  char *ext = strrchr(out, '.');
+  if (ext != NULL && strchr(ext, '/') == NULL) *ext = '\0';
+  int n = strlen(out);
+  snprintf(out + n, len - n, ".sdf");
+}
+
+int Sdf_Save(const char *fname, const LanderSDF *sdf) {
+  FILE *f = fopen(fname, "wb");
+  if (f == NULL) {
+    fprintf(stderr, "Unable to open file %s for writing\n", fname);
+    return 0;
+  }
+  int head[3] = {SDF_VERSION, sdf->sx, sdf->sy};
+  size_t n = (size_t)sdf->sx * sdf->sy;
+  int ok = fwrite("LSDF", 4, 1, f) == 1 &&
+           fwrite(head, sizeof(head), 1, f) == 1 &&
+           fwrite(&sdf->hash, sizeof(sdf->hash), 1, f) == 1 &&
+           fwrite(sdf->dist, sizeof(float), n, f) == n &&
+           fwrite(sdf->plat, sizeof(float), n, f) == n;
+  if (fclose(f) != 0) ok = 0;
+  if (!ok) fprintf(stderr, "Failed to write distance field %s\n", fname);
+  return ok;
+}
+
+int Sdf_Load(const char *fname, const LanderMap *map, LanderSDF *sdf) {
+  memset(sdf, 0, sizeof(LanderSDF));
+  FILE *f = fopen(fname, "rb");
+  if (f == NULL) return 0;
+
+  char magic[4];
+  int head[3];
+  unsigned long long hash;
+  if (fread(magic, 4, 1, f) != 1 || memcmp(magic, "LSDF", 4) ||
+      fread(head, sizeof(head), 1, f) != 1 || head[0] != SDF_VERSION ||
+      head[1] <= 0 || head[2] <= 0 ||
+      fread(&hash, sizeof(hash), 1, f) != 1 ||
+      (map != NULL && (head[1] != map->sx || head[2] != map->sy || hash != Sdf_Map_Hash(map)))) {
+    fclose(f);
+    return 0;
+  }
+
+  size_t n = (size_t)head[1] * head[2];
+  sdf->dist = (float *)malloc(n * sizeof(float));
+  sdf->plat = (float *)malloc(n * sizeof(float));
+  if (sdf->dist == NULL || sdf->plat == NULL ||
+      fread(sdf->dist, sizeof(float), n, f) != n ||
+      fread(sdf->plat, sizeof(float), n, f) != n) {
+    fclose(f);
+    Sdf_Free(sdf);
+    return 0;
+  }
+  fclose(f);
+  sdf->sx = head[1];
+  sdf->sy = head[2];
+  sdf->hash = hash;
+  if (!Sdf_Derive(sdf)) {
+    Sdf_Free(sdf);
+    return 0;
+  }
+  return 1;
+}
@@ -0,0 +1,72 @@
+/*
+	Signed distance field of a terrain map.
+
+	For every map cell the field stores the Euclidean distance (in
+	pixels, centre to centre) to the nearest cell of the other kind:
+	positive in open space (distance to the nearest solid cell),
+	negative inside terrain or platform (distance to the nearest open
+	cell). A second field holds the distance to the nearest platform
+	cell, so a query can tell whether the closest solid is the platform.
+
+	Clearance and contact tests at any position are then one lookup
+	instead of a walk over terrain pixels. The fields are built with
+	the exact linear-time distance transform of Felzenszwalb and
+	Huttenlocher, and can be saved to a .sdf file by Lander_MkSDF so
+	offline tools do not have to rebuild them.
+*/
+
+#ifndef _LANDER_SDF_H
+#define _LANDER_SDF_H
+
+#include <math.h>
+
+#include "Lander_Sim.h"
+
+#define SDF_VERSION 1
+
+struct LanderSDF {
+  int sx, sy;
+  float *dist;            // Signed distance to solid, >0 in open space
+  float *plat;            // Distance to the nearest platform cell
+  unsigned char *clear8;  // dist rounded down and capped at 255, 0 on
+                          // solid cells: a quarter of the size, for ray
+                          // casting (Lander_Raycast.h). Not saved
+  unsigned long long hash;  // Hash of the map cells it was built from
+};
+
+// Build the fields for a loaded map, returns 0 on failure
+int Sdf_Build(const LanderMap *map, LanderSDF *sdf);
+void Sdf_Free(LanderSDF *sdf);
+
+// Save and load .sdf files. Loading fails (returns 0) if the file is
+// missing, has another version, or was built from different map cells
+// (pass map = NULL to skip that check)
+int Sdf_Save(const char *fname, const LanderSDF *sdf);
+int Sdf_Load(const char *fname, const LanderMap *map, LanderSDF *sdf);
+
+// Name of the .sdf file that goes with a map: the map name with its
+// extension replaced
+void Sdf_File_Name(const char *map_name, char *out, int len);
+
+// Hash of a map's cells, stored with the field to detect stale files
+unsigned long long Sdf_Map_Hash(const LanderMap *map);
+
+// Field value at a position in pixels. Positions off the map use the
+// nearest border cell, which can only under-estimate the clearance
+static inline int Sdf_Index(const LanderSDF *sdf, double x, double y) {
+  int i = (int)round(x);
+  int j = (int)round(y);
+  i = i < 0 ? 0 : (i >= sdf->sx ? sdf->sx - 1 : i);
+  j = j < 0 ? 0 : (j >= sdf->sy ? sdf->sy - 1 : j);
+  return i + j * sdf->sx;
+}
+
+static inline double Sdf_Clearance(const LanderSDF *sdf, double x, double y) {
+  return sdf->dist[Sdf_Index(sdf, x, y)];
+}
+
+static inline double Sdf_Platform_Distance(const LanderSDF *sdf, double x, double y) {
+  return sdf->plat[Sdf_Index(sdf, x, y)];
+}
+
+#endif
@@ -0,0 +1,66 @@
+/*
+	Section files - see Lander_Section.h
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "Lander_Section.h"
+
+int Section_Alloc(size_t len, SectionFile *sf) {
+  memset(sf, 0, sizeof(SectionFile));
+  sf->base = calloc(1, len);
+  if (sf->base == NULL) return 0;
+  sf->len = len;
+  return 1;
+}
+
+int Section_Map(const char *fname, size_t min_len, SectionFile *sf) {
+  memset(sf, 0, sizeof(SectionFile));
+  int fd = open(fname, O_RDONLY);
+  if (fd < 0) return SECTION_MISSING;
+
+  struct stat st;
+  void *base = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size >= (off_t)min_len)
+    base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) return SECTION_SHORT;
+
+  sf->base = base;
+  sf->len = st.st_size;
+  sf->mapped = 1;
+  return SECTION_OK;
+}
+
+void Section_Free(SectionFile *sf) {
+  if (sf->base != NULL) {
+    if (sf->mapped) munmap(sf->base, sf->len);
+    else free(sf->base);
+  }
+  memset(sf, 0, sizeof(SectionFile));
+}
+
+int Section_Save(const char *fname, const SectionFile *sf, const char *what) {
+  FILE *f = fopen(fname, "wb");
+  if (f == NULL) {
+    fprintf(stderr, "Unable to open file %s for writing\n", fname);
+    return 0;
+  }
+  int ok = fwrite(sf->base, sf->len, 1, f) == 1;
+  if (fclose(f) != 0) ok = 0;
+  if (!ok) fprintf(stderr, "Failed to write %s %s\n", what, fname);
+  return ok;
+}
+
+int Section_Check(const SectionFile *sf, const char *magic, int version, unsigned long long size) {
+  const unsigned char *base = (const unsigned char *)sf->base;
+  int v;
+  memcpy(&v, base + 4, sizeof(v));
+  return !memcmp(base, magic, 4) && v == version && size == sf->len;
+}
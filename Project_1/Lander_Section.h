@@ -0,0 +1,55 @@
+/*
+	Section files.
+
+	Packed terrain (Lander_Terrain.h) and policy tables (Lander_Policy.h)
+	are stored the way they are used: a versioned header followed by
+	sections at SECTION_ALIGN byte offsets. Loading one maps the file
+	read-only, so it costs no parsing and every process that maps the
+	same file shares one copy in the page cache. One built in memory
+	lives in a zeroed malloc'd buffer of the same layout, and the code
+	reading it does not care which it got.
+
+	SectionFile is that storage. Each format supplies its own header and
+	its own checks on it; the magic, version and size checks every
+	header needs are in Section_Check().
+*/
+
+#ifndef _LANDER_SECTION_H
+#define _LANDER_SECTION_H
+
+#include <stddef.h>
+
+// Section alignment in the file (and so in memory)
+#define SECTION_ALIGN 64
+
+// Section_Map() results
+#define SECTION_OK 1
+#define SECTION_MISSING 0       // Could not be opened
+#define SECTION_SHORT -1        // Shorter than a header, or could not be mapped
+
+struct SectionFile {
+  void *base;                   // Storage, mapped or malloc'd
+  size_t len;
+  int mapped;
+};
+
+static inline unsigned long long Section_Align(unsigned long long n) {
+  return (n + SECTION_ALIGN - 1) / SECTION_ALIGN * SECTION_ALIGN;
+}
+
+// A zeroed buffer of len bytes. Returns 0 if out of memory
+int Section_Alloc(size_t len, SectionFile *sf);
+
+// Map fname read-only, if it holds at least min_len bytes. Prints
+// nothing, returns one of SECTION_*
+int Section_Map(const char *fname, size_t min_len, SectionFile *sf);
+void Section_Free(SectionFile *sf);
+
+// Write the storage to fname, what names the contents in messages
+int Section_Save(const char *fname, const SectionFile *sf, const char *what);
+
+// The checks every header needs: it starts with magic (4 bytes) and
+// version, and the size it records is the size of the storage
+int Section_Check(const SectionFile *sf, const char *magic, int version, unsigned long long size);
+
+#endif
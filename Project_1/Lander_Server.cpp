@@ -0,0 +1,490 @@
+/*
+	Episode server.
+
+	A long running headless worker that keeps maps, policy tables and
+	the lander footprint loaded, and flies the landings it is sent on a
+	pool of worker threads. Scripts that fly thousands of short
+	episodes pay for loading once, not once per episode.
+
+	Usage: Lander_Server [-j threads] [-P params] [-u socket]
+
+	Requests are JSON objects, one per line, read from stdin or, with
+	-u, from any number of clients connected to a Unix domain socket
+	at the given path. Each asks for one episode:
+
+	  {"id": 7, "map": "hard.ppm", "mode": 3, "comps": [1, 5], "seed": 42,
+	   "max_time": 300, "exact": true, "policy": "lander.lpol",
+	   "params": {"vy_near": 3.5, "gate": 6}}
+
+	Only "map" is required. "mode" defaults to 0, "seed" to 1,
+	"max_time" to 300, "exact" (exact contact, see
+	Sim_Set_Exact_Contact) to false. "params" overrides single gains
+	(see Lander_Params.h) on top of the -P file or the defaults. "id"
+	is any number or string and is echoed back, so a client can send a
+	whole batch before reading anything.
+
+	Results come back one JSON line per episode, on stdout or the
+	client's connection, in the order the episodes finish:
+
+	  {"id": 7, "status": "landed", "time": 13.175, "td_vx": 0.050,
+	   "td_vy": -4.058, "td_angle": 0.14, "ticks": 2635}
+
+	A request that cannot be flown is answered {"id": ..., "error": "..."}.
+	Maps and policy tables are loaded on first use and kept until the
+	server exits.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Lander_Episode.h"
+
+#define MAX_LINE 65536
+
+/*
+  Resident maps and policy tables
+*/
+
+static LanderShape shape;
+static ControllerParams base_params;
+
+static std::mutex load_lock;
+static std::map<std::string, LanderMap *> maps;
+static std::map<std::string, LanderPolicy *> policies;
+
+// The loaded map, NULL if it cannot be loaded. Failures are not kept,
+// so a map that turns up later can still be used
+static const LanderMap *Get_Map(const std::string &name) {
+  std::lock_guard<std::mutex> g(load_lock);
+  std::map<std::string, LanderMap *>::iterator it = maps.find(name);
+  if (it != maps.end()) return it->second;
+  LanderMap *map = new LanderMap;
+  if (!Sim_Load_Map(name.c_str(), map)) {
+    delete map;
+    return NULL;
+  }
+  maps[name] = map;
+  return map;
+}
+
+static const LanderPolicy *Get_Policy(const std::string &name) {
+  std::lock_guard<std::mutex> g(load_lock);
+  std::map<std::string, LanderPolicy *>::iterator it = policies.find(name);
+  if (it != policies.end()) return it->second;
+  LanderPolicy *pol = new LanderPolicy;
+  if (!Policy_Map(name.c_str(), pol)) {
+    delete pol;
+    return NULL;
+  }
+  policies[name] = pol;
+  return pol;
+}
+
+/*
+  Requests
+*/
+
+// Where results go. Shared by the reader and every job it queued, the
+// connection is closed when the last of them lets go
+struct Client {
+  FILE *out;
+  std::mutex lock;
+  ~Client() {
+    if (out != stdout) fclose(out);
+  }
+};
+
+struct Job {
+  std::shared_ptr<Client> client;
+  std::string id;               // As sent, already JSON
+  std::string map_name;
+  std::string policy_name;
+  FailConfig cfg;
+  long seed;
+  double max_time;
+  int exact;
+  ControllerParams params;
+};
+
+// Just enough JSON for a request: one flat object whose values are
+// numbers, strings, booleans, arrays of numbers, or objects of numbers
+// ("params"). Parse errors leave a message in err
+struct Parser {
+  const char *p;
+  const char *err;
+};
+
+static void Skip_Space(Parser *ps) {
+  while (isspace((unsigned char)*ps->p)) ps->p++;
+}
+
+static int Expect(Parser *ps, char c) {
+  Skip_Space(ps);
+  if (*ps->p != c) {
+    ps->err = "malformed JSON";
+    return 0;
+  }
+  ps->p++;
+  return 1;
+}
+
+static int Parse_String(Parser *ps, std::string *s) {
+  if (!Expect(ps, '"')) return 0;
+  s->clear();
+  while (*ps->p && *ps->p != '"') {
+    if (*ps->p == '\\' && ps->p[1]) ps->p++;
+    s->push_back(*ps->p++);
+  }
+  return Expect(ps, '"');
+}
+
+static int Parse_Number(Parser *ps, double *v) {
+  Skip_Space(ps);
+  char *end;
+  *v = strtod(ps->p, &end);
+  if (end == ps->p) {
+    ps->err = "expected a number";
+    return 0;
+  }
+  ps->p = end;
+  return 1;
+}
+
+static int Parse_Bool(Parser *ps, int *v) {
+  Skip_Space(ps);
+  if (!strncmp(ps->p, "true", 4)) *v = 1;
+  else if (!strncmp(ps->p, "false", 5)) *v = 0;
+  else {
+    ps->err = "expected true or false";
+    return 0;
+  }
+  ps->p += *v ? 4 : 5;
+  return 1;
+}
+
+// Calls item() for each member of an object (with the key) or each
+// element of an array (with an empty key), stopping at the first failure
+template <typename F>
+static int Parse_Members(Parser *ps, char open, char close, F item) {
+  if (!Expect(ps, open)) return 0;
+  Skip_Space(ps);
+  if (*ps->p == close) {
+    ps->p++;
+    return 1;
+  }
+  for (;;) {
+    std::string key;
+    if (open == '{' && !(Parse_String(ps, &key) && Expect(ps, ':'))) return 0;
+    if (!item(key)) return 0;
+    Skip_Space(ps);
+    if (*ps->p == close) {
+      ps->p++;
+      return 1;
+    }
+    if (!Expect(ps, ',')) return 0;
+  }
+}
+
+static int Param_Index(const std::string &name) {
+  for (int i = 0; i < Params_Count(); i++)
+    if (name == Params_Info(i)->name) return i;
+  return -1;
+}
+
+// Fills job from one request line, returns 0 with *err set if the
+// request is malformed. The id is filled in as early as possible so
+// the error can be matched to the request
+static int Parse_Request(const char *line, Job *job, const char **err) {
+  Parser ps = {line, NULL};
+  std::string mode_str = "0";
+  std::vector<int> comps;
+  int have_map = 0;
+
+  job->id = "null";
+  job->seed = 1;
+  job->max_time = 300;
+  job->exact = 0;
+  job->params = base_params;
+
+  int ok = Parse_Members(&ps, '{', '}', [&](const std::string &key) {
+    double v;
+    if (key == "id") {
+      Skip_Space(&ps);
+      const char *start = ps.p;
+      std::string s;
+      if (*ps.p == '"' ? !Parse_String(&ps, &s) : !Parse_Number(&ps, &v)) return 0;
+      job->id.assign(start, ps.p - start);
+      return 1;
+    }
+    if (key == "map") return have_map = Parse_String(&ps, &job->map_name);
+    if (key == "policy") return Parse_String(&ps, &job->policy_name);
+    if (key == "exact") return Parse_Bool(&ps, &job->exact);
+    if (key == "seed" || key == "mode" || key == "max_time") {
+      if (!Parse_Number(&ps, &v)) return 0;
+      if (key == "seed") job->seed = (long)v;
+      else if (key == "mode") mode_str = std::to_string((int)v);
+      else job->max_time = v;
+      return 1;
+    }
+    if (key == "comps") {
+      return Parse_Members(&ps, '[', ']', [&](const std::string &) {
+        if (!Parse_Number(&ps, &v)) return 0;
+        comps.push_back((int)v);
+        return 1;
+      });
+    }
+    if (key == "params") {
+      return Parse_Members(&ps, '{', '}', [&](const std::string &name) {
+        int i = Param_Index(name);
+        if (i < 0) {
+          ps.err = "unknown parameter";
+          return 0;
+        }
+        if (!Parse_Number(&ps, &v)) return 0;
+        Params_Set(&job->params, i, v);
+        return 1;
+      });
+    }
+    ps.err = "unknown request field";
+    return 0;
+  });
+  if (ok) {
+    Skip_Space(&ps);
+    if (*ps.p) {
+      ps.err = "trailing characters after the request";
+      ok = 0;
+    }
+  }
+  if (!ok) {
+    *err = ps.err != NULL ? ps.err : "malformed JSON";
+    return 0;
+  }
+  if (!have_map) {
+    *err = "no map given";
+    return 0;
+  }
+
+  // Same spelling as a Lander_Batch configuration, e.g. 3:1,5
+  std::string spec = mode_str;
+  for (size_t i = 0; i < comps.size(); i++) spec += (i ? "," : ":") + std::to_string(comps[i]);
+  if (!Parse_Config(spec.c_str(), &job->cfg) || (comps.size() > 0 && job->cfg.mode != 3)) {
+    *err = "bad failure mode or component list";
+    return 0;
+  }
+  return 1;
+}
+
+// Sends one result line. The id is echoed as sent, of any length, and
+// the fields after it (body, starting with a comma) are fixed size
+static void Reply(Client *c, const std::string &id, const char *body) {
+  std::string msg = "{\"id\": " + id + body + "}\n";
+  std::lock_guard<std::mutex> g(c->lock);
+  fputs(msg.c_str(), c->out);
+  fflush(c->out);
+}
+
+static void Reply_Error(Client *c, const std::string &id, const char *err) {
+  char body[256];
+  snprintf(body, sizeof(body), ", \"error\": \"%s\"", err);
+  Reply(c, id, body);
+}
+
+/*
+  Worker pool
+*/
+
+static std::mutex queue_lock;
+static std::condition_variable queue_ready;
+static std::deque<Job *> queue;
+
+static void Run_Job(Job *job) {
+  const LanderMap *map = Get_Map(job->map_name);
+  if (map == NULL) {
+    Reply_Error(job->client.get(), job->id, "unable to load map");
+    return;
+  }
+  const LanderPolicy *pol = NULL;
+  if (!job->policy_name.empty() && (pol = Get_Policy(job->policy_name)) == NULL) {
+    Reply_Error(job->client.get(), job->id, "unable to load policy");
+    return;
+  }
+
+  Scenario sc;
+  sc.map = map;
+  sc.shape = &shape;
+  sc.fail_mode = job->cfg.mode;
+  memcpy(sc.comps, job->cfg.comps, sizeof(sc.comps));
+  sc.ncomps = job->cfg.ncomps;
+  sc.seed = job->seed;
+  sc.max_time = job->max_time;
+  sc.map_name = job->map_name.c_str();
+  sc.trace_name = NULL;
+  sc.policy = pol;
+  sc.params = &job->params;
+  sc.exact_contact = job->exact;
+  sc.plan = NULL;
+  sc.time_control = 0;
+
+  EpisodeResult res;
+  Run_Episode(&sc, &res);
+
+  char body[256];
+  snprintf(body, sizeof(body),
+           ", \"status\": \"%s\", \"time\": %.3f, \"td_vx\": %.3f, \"td_vy\": %.3f, \"td_angle\": %.2f, \"ticks\": %ld",
+           Sim_Status_Name(res.status), res.time, res.td_vx, res.td_vy, res.td_angle, res.ticks);
+  Reply(job->client.get(), job->id, body);
+}
+
+static void Worker(void) {
+  for (;;) {
+    Job *job;
+    {
+      std::unique_lock<std::mutex> g(queue_lock);
+      queue_ready.wait(g, [] { return !queue.empty(); });
+      job = queue.front();
+      queue.pop_front();
+    }
+    if (job == NULL) return;    // Shutting down
+    Run_Job(job);
+    delete job;
+  }
+}
+
+static void Enqueue(Job *job) {
+  {
+    std::lock_guard<std::mutex> g(queue_lock);
+    queue.push_back(job);
+  }
+  queue_ready.notify_one();
+}
+
+// Reads requests from in until it ends, queueing the well formed ones
+static void Serve(FILE *in, std::shared_ptr<Client> client) {
+  std::vector<char> buf(MAX_LINE);
+  while (fgets(buf.data(), MAX_LINE, in) != NULL) {
+    char *s = buf.data();
+    size_t len = strlen(s);
+    if (len == MAX_LINE - 1 && s[len - 1] != '\n') {
+      Reply_Error(client.get(), "null", "request too long");
+      int ch;
+      while ((ch = fgetc(in)) != EOF && ch != '\n');
+      continue;
+    }
+    while (*s && isspace((unsigned char)*s)) s++;
+    if (!*s) continue;
+
+    Job *job = new Job;
+    const char *err;
+    if (!Parse_Request(s, job, &err)) {
+      Reply_Error(client.get(), job->id, err);
+      delete job;
+      continue;
+    }
+    job->client = client;
+    Enqueue(job);
+  }
+}
+
+static void Usage(void) {
+  fprintf(stderr, "Usage: Lander_Server [-j threads] [-P params] [-u socket]\n");
+  fprintf(stderr, "See header of Lander_Server.cpp for the request format\n");
+}
+
+int main(int argc, char *argv[]) {
+  int nthreads = (int)std::thread::hardware_concurrency();
+  const char *params_name = NULL;
+  const char *sock_name = NULL;
+
+  int a = 1;
+  while (a < argc && argv[a][0] == '-') {
+    if (!strcmp(argv[a], "-j") && a + 1 < argc) nthreads = (int)strtol(argv[++a], NULL, 10);
+    else if (!strcmp(argv[a], "-P") && a + 1 < argc) params_name = argv[++a];
+    else if (!strcmp(argv[a], "-u") && a + 1 < argc) sock_name = argv[++a];
+    else {
+      Usage();
+      return 1;
+    }
+    a++;
+  }
+  if (a != argc) {
+    Usage();
+    return 1;
+  }
+  if (nthreads < 1) nthreads = 1;
+
+  if (!Sim_Load_Shape("lander.ppm", &shape)) {
+    fprintf(stderr, "Unable to load lander image. Ensure it is in the same directory\n");
+    return 1;
+  }
+  Params_Default(&base_params);
+  if (params_name != NULL && !Params_Load(params_name, &base_params)) return 1;
+
+  std::vector<std::thread> workers;
+  for (int t = 0; t < nthreads; t++) workers.push_back(std::thread(Worker));
+
+  if (sock_name == NULL) {
+    std::shared_ptr<Client> client(new Client);
+    client->out = stdout;
+    Serve(stdin, client);
+
+    // Let the queued episodes finish, then stop the workers
+    for (int t = 0; t < nthreads; t++) Enqueue(NULL);
+    for (size_t t = 0; t < workers.size(); t++) workers[t].join();
+    return 0;
+  }
+
+  int lsock = socket(AF_UNIX, SOCK_STREAM, 0);
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(sock_name) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "Socket path %s is too long\n", sock_name);
+    return 1;
+  }
+  strcpy(addr.sun_path, sock_name);
+  unlink(sock_name);
+  signal(SIGPIPE, SIG_IGN);     // A client that hangs up early only loses its results
+  if (lsock < 0 || bind(lsock, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(lsock, 16) < 0) {
+    fprintf(stderr, "Unable to listen on socket %s\n", sock_name);
+    return 1;
+  }
+  fprintf(stderr, "Listening on %s with %d worker threads\n", sock_name, nthreads);
+
+  // One reader thread per connection, all feeding the same workers.
+  // The server runs until it is killed
+  for (;;) {
+    int fd = accept(lsock, NULL, NULL);
+    if (fd < 0) continue;
+    int fd2 = dup(fd);
+    FILE *in = fdopen(fd, "r");
+    FILE *out = fd2 < 0 ? NULL : fdopen(fd2, "w");
+    if (in == NULL || out == NULL) {
+      if (in != NULL) fclose(in);
+      else close(fd);
+      if (out != NULL) fclose(out);
+      else if (fd2 >= 0) close(fd2);
+      continue;
+    }
+    std::shared_ptr<Client> client(new Client);
+    client->out = out;
+    std::thread([in, client]() {
+      Serve(in, client);
+      fclose(in);
+    }).detach();
+  }
+}
@@ -0,0 +1,699 @@
+/*
+	Headless lander simulation - see Lander_Sim.h
+
+	The physics, actuator noise, sensor noise and failure schedule
+	follow the behaviour of the prebuilt Lander_Control.o:
+
+	- Actuators: the requested power is clamped to [0 1], scaled by .95
+	  and a uniform [0 .05] noise term is added. Rotate() requests are
+	  noisy in the same way and are carried out at MAX_ROT_RATE per step.
+	- Sensors: working sensors return the true value with NP1 relative
+	  uniform noise, failed sensors return garbage.
+	- Failures: modes 1 and 2 fail up to two components at random times
+	  in the first 8 seconds, mode 3 fails the listed components at .5s,
+	  mode 4 follows the schedule of a FlightPlan.
+	- Sonar: every SONAR_SWEEP seconds 36 beams go out from the lander,
+	  advancing SONAR_RANGE pixels per step. A beam that hits terrain
+	  updates its reading, beams that hit nothing report -1. Beams and
+	  the RangeDist() ray are marched by Ray_March (Lander_Raycast.h).
+	- Contact: the outline is tested at the end of each step. With exact
+	  contact on, tests are skipped while the terrain is out of reach and
+	  a step that ends in contact is bisected for the moment of touchdown.
+
+	Random draws come from counter-based streams keyed by the seed (one
+	per source, see RNG_* in Lander_Sim.h) rather than the black box's
+	single generator, so the noise differs from Lander_Control.o draw
+	for draw but follows the same distributions.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/stat.h>
+
+#include "Lander_Sim.h"
+#include "Lander_SDF.h"
+#include "Lander_Raycast.h"
+#include "Lander_Profile.h"
+
+#define DEG2RAD (PI/180.0)
+#define RAD2DEG (180.0/PI)
+
+/*
+  Map loading
+*/
+
+// Reads a binary (P6) .ppm file, returns the RGB data or NULL
+static unsigned char *Read_PPM(const char *fname, int *sx, int *sy) {
+  FILE *f = fopen(fname, "rb");
+  if (f == NULL) {
+    fprintf(stderr, "Unable to open file %s for reading, please check name and path\n", fname);
+    return NULL;
+  }
+
+  char line[1024];
+  int size_x, size_y, max_v;
+  if (fgets(line, sizeof(line), f) == NULL || strncmp(line, "P6", 2)) {
+    fprintf(stderr, "Wrong file format, not a .ppm file or header end-of-line characters missing\n");
+    fclose(f);
+    return NULL;
+  }
+
+  // Skip comment lines
+  do {
+    if (fgets(line, sizeof(line), f) == NULL) {
+      fprintf(stderr, "Failed to read header from .ppm file %s\n", fname);
+      fclose(f);
+      return NULL;
+    }
+  } while (line[0] == '#');
+
+  if (sscanf(line, "%d %d", &size_x, &size_y) != 2 ||
+      fgets(line, sizeof(line), f) == NULL ||
+      sscanf(line, "%d", &max_v) != 1 || max_v != 255) {
+    fprintf(stderr, "Failed to read .ppm header from %s\n", fname);
+    fclose(f);
+    return NULL;
+  }
+
+  unsigned char *im = (unsigned char *)calloc(size_x * size_y * 3, sizeof(unsigned char));
+  if (im == NULL) {
+    fprintf(stderr, "Out of memory allocating space for image\n");
+    fclose(f);
+    return NULL;
+  }
+
+  if (fread(im, size_x * size_y * 3 * sizeof(unsigned char), 1, f) != 1) {
+    fprintf(stderr, "Failed to read data from .ppm file %s\n", fname);
+    free(im);
+    fclose(f);
+    return NULL;
+  }
+
+  fclose(f);
+  *sx = size_x;
+  *sy = size_y;
+  return im;
+}
+
+int Sim_Read_Map(const char *fname, int flags, LanderTerrain *ter) {
+  int sx, sy;
+  unsigned char *im = Read_PPM(fname, &sx, &sy);
+  if (im == NULL) return 0;
+  if (sx != MAP_SIZE || sy != MAP_SIZE) {
+    fprintf(stderr, "Map %s is not %dx%d\n", fname, MAP_SIZE, MAP_SIZE);
+    free(im);
+    return 0;
+  }
+
+  unsigned char *cells = (unsigned char *)calloc(sx * sy, sizeof(unsigned char));
+  if (cells == NULL) {
+    free(im);
+    return 0;
+  }
+
+  // Classify pixels. Anything with a red component above 5 is solid
+  // (this is the test the range finder uses), bright red is platform.
+  int np = 0;
+  for (int j = 0; j < sy; j++) {
+    for (int i = 0; i < sx; i++) {
+      unsigned char *p = im + 3 * (i + j * sx);
+      if (p[0] > 250 && p[1] < 10 && p[2] < 10) {
+        cells[i + j * sx] = CELL_PLATFORM;
+        np++;
+      }
+      else if (p[0] > 5) cells[i + j * sx] = CELL_TERRAIN;
+    }
+  }
+  free(im);
+
+  if (np == 0) {
+    fprintf(stderr, "Map %s has no landing platform\n", fname);
+    free(cells);
+    return 0;
+  }
+  int ok = Terrain_Pack(cells, sx, sy, flags, ter);
+  free(cells);
+  return ok;
+}
+
+// Maps the .ltm that goes with a map file, if there is one that is at
+// least as new as the map
+static int Map_Packed(const char *fname, LanderTerrain *ter) {
+  char ltm_name[1024];
+  Terrain_File_Name(fname, ltm_name, sizeof(ltm_name));
+  if (strcmp(ltm_name, fname)) {
+    struct stat map_st, ltm_st;
+    if (stat(fname, &map_st) != 0 || stat(ltm_name, &ltm_st) != 0 ||
+        ltm_st.st_mtime < map_st.st_mtime)
+      return 0;
+  }
+  return Terrain_Map(ltm_name, ter);
+}
+
+int Sim_Load_Map(const char *fname, LanderMap *map) {
+  memset(map, 0, sizeof(LanderMap));
+  if (!Map_Packed(fname, &map->terrain)) {
+    const char *ext = strrchr(fname, '.');
+    if (ext != NULL && !strcmp(ext, ".ltm")) {
+      fprintf(stderr, "Unable to map terrain file %s, please check name and version\n", fname);
+      return 0;
+    }
+    if (!Sim_Read_Map(fname, 0, &map->terrain)) return 0;
+  }
+  const TerrainHeader *h = map->terrain.head;
+  if (h->sx != MAP_SIZE || h->sy != MAP_SIZE) {
+    fprintf(stderr, "Map %s is not %dx%d\n", fname, MAP_SIZE, MAP_SIZE);
+    Terrain_Free(&map->terrain);
+    return 0;
+  }
+  map->sx = h->sx;
+  map->sy = h->sy;
+  map->plat_x = h->plat_x;
+  map->plat_y = h->plat_y;
+
+  // Distance field, the simulation still works (only slower) without it
+  map->sdf = (LanderSDF *)malloc(sizeof(LanderSDF));
+  if (map->sdf != NULL) {
+    char sdf_name[1024];
+    Sdf_File_Name(fname, sdf_name, sizeof(sdf_name));
+    if (!Sdf_Load(sdf_name, map, map->sdf) && !Sdf_Build(map, map->sdf)) {
+      free(map->sdf);
+      map->sdf = NULL;
+    }
+  }
+  return 1;
+}
+
+void Sim_Free_Map(LanderMap *map) {
+  Terrain_Free(&map->terrain);
+  if (map->sdf != NULL) {
+    Sdf_Free(map->sdf);
+    free(map->sdf);
+    map->sdf = NULL;
+  }
+}
+
+int Sim_Load_Shape(const char *fname, LanderShape *shape) {
+  int sx, sy;
+  unsigned char *im = Read_PPM(fname, &sx, &sy);
+  if (im == NULL) return 0;
+
+  // Keep the non-black pixels that have a black (or missing) 4-neighbour
+  shape->n = 0;
+  shape->radius = 0;
+  for (int j = 0; j < sy; j++) {
+    for (int i = 0; i < sx; i++) {
+      unsigned char *p = im + 3 * (i + j * sx);
+      if (!(p[0] | p[1] | p[2])) continue;
+      bool edge = false;
+      int di[4] = {-1, 1, 0, 0};
+      int dj[4] = {0, 0, -1, 1};
+      for (int k = 0; k < 4; k++) {
+        int ii = i + di[k];
+        int jj = j + dj[k];
+        if (ii < 0 || jj < 0 || ii >= sx || jj >= sy) edge = true;
+        else {
+          unsigned char *q = im + 3 * (ii + jj * sx);
+          if (!(q[0] | q[1] | q[2])) edge = true;
+        }
+      }
+      if (edge && shape->n < MAX_OUTLINE) {
+        shape->u[shape->n] = i + .5 - sx / 2;
+        shape->v[shape->n] = j + .5 - sy / 2;
+        shape->radius = fmax(shape->radius, hypot(shape->u[shape->n], shape->v[shape->n]));
+        shape->n++;
+      }
+    }
+  }
+  free(im);
+  return shape->n > 0;
+}
+
+/*
+  Helper functions
+*/
+
+// SplitMix64 finalizer
+static unsigned long long Mix64(unsigned long long z) {
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+// Uniform [0 1) draw number n of a stream: a hash of (key, stream, n),
+// so the value depends on nothing but the seed and how many draws that
+// stream has made
+static double Rand_At(unsigned long long key, int stream, unsigned long long n) {
+  unsigned long long z = Mix64(key ^ ((unsigned long long)(stream + 1) * 0xD1B54A32D192ED03ULL));
+  z = Mix64(z + (n + 1) * 0x9E3779B97F4A7C15ULL);
+  return (z >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double Rand(LanderSim *sim, int stream) {
+  return Rand_At(sim->rng_key, stream, sim->rng_ctr[stream]++);
+}
+
+// Spreads a seed over the generator key so that consecutive seeds give
+// unrelated episodes
+static void Seed_Rand(LanderSim *sim, long seed) {
+  sim->rng_key = Mix64((unsigned long long)seed + 0x9E3779B97F4A7C15ULL);
+  for (int i = 0; i < N_RNG; i++) sim->rng_ctr[i] = 0;
+}
+
+// Applies the actuator noise model to a requested power
+static double Noisy_Power(LanderSim *sim, double power) {
+  double p;
+  if (power < 0) p = 0;
+  else if (power > 1) p = .95;
+  else p = power * .95;
+  return p + Rand(sim, RNG_ACTUATOR) * .05;
+}
+
+static void Fail_Component(LanderSim *sim, int comp) {
+  static const char *names[N_COMP] = {
+    "", "Main Thruster", "Left Thruster", "Right Thruster",
+    "Horizontal Velocity sensor", "Vertical Velocity sensor",
+    "Horizontal Position sensor", "Vertical Position sensor",
+    "Angle sensor", "Sonar"
+  };
+  if (comp < 1 || comp >= N_COMP || !sim->ok[comp]) return;
+  sim->ok[comp] = 0;
+  sim->fail_tick[comp] = sim->ticks;
+  if (comp == COMP_MAIN) sim->MT_OK = 0;
+  if (comp == COMP_LEFT) sim->LT_OK = 0;
+  if (comp == COMP_RIGHT) sim->RT_OK = 0;
+  if (sim->verbose) fprintf(stderr, "%s malfunction\n", names[comp]);
+}
+
+// Injects failures according to the failure mode
+static void Update_Failures(LanderSim *sim) {
+  if (sim->fail_mode == 4) {
+    for (int i = 1; i < N_COMP; i++)
+      if (sim->f_time[i] > 0 && sim->sim_time > sim->f_time[i]) Fail_Component(sim, i);
+    return;
+  }
+  if (sim->fail_mode < 1 || sim->fail_mode > 3) return;
+
+  int first = sim->fail_t1 > 0 && sim->sim_time > sim->fail_t1;
+  int second = sim->fail_t2 > 0 && sim->sim_time > sim->fail_t2;
+  if (!first && !second) return;
+
+  if (sim->fail_mode == 1) {
+    // Controls only
+    double r = Rand(sim, RNG_FAILURE);
+    if (r < .5) Fail_Component(sim, COMP_MAIN);
+    else if (r < .75) Fail_Component(sim, COMP_LEFT);
+    else Fail_Component(sim, COMP_RIGHT);
+  }
+  else if (sim->fail_mode == 2) {
+    // Controls and sensors
+    Fail_Component(sim, 1 + (int)(Rand(sim, RNG_FAILURE) * 8));
+  }
+  else {
+    for (int i = 1; i < N_COMP; i++)
+      if (sim->f_list[i]) Fail_Component(sim, i);
+  }
+
+  if (first) sim->fail_t1 = -1;
+  else sim->fail_t2 = -1;
+}
+
+// Restarts the sweep when due. Beams still live from the last sweep
+// found nothing
+static void Update_Ping(LanderSim *sim) {
+  sim->ping_time += T_STEP;
+  if (sim->ping_time > SONAR_SWEEP) {
+    sim->ping_time = 0;
+    for (int i = 0; i < 36; i++) {
+      if (sim->beam_live[i]) sim->sonar[i] = -1;
+      sim->beam_live[i] = 1;
+      sim->beam_r[i] = SONAR_START;
+    }
+  }
+}
+
+// Tests the lander outline at a pose against the terrain. Returns 1 on
+// contact, with *plat_only set if every cell touched is platform
+static int Outline_Contact(LanderSim *sim, double x, double y, double theta, int *plat_only) {
+  sim->contact_tests++;
+  double s = sin(theta);
+  double c = cos(theta);
+  int hit = 0;
+  *plat_only = 1;
+  for (int k = 0; k < sim->shape->n; k++) {
+    double u = sim->shape->u[k];
+    double v = sim->shape->v[k];
+    int ci = (int)round(x + u * c - v * s);
+    int cj = (int)round(y + u * s + v * c);
+    int cell = Map_Cell(sim->map, ci, cj);
+    if (cell == CELL_OPEN) continue;
+    hit = 1;
+    if (cell != CELL_PLATFORM) *plat_only = 0;
+  }
+  return hit;
+}
+
+// Ends the episode at contact, deciding whether we landed or crashed
+static void Touchdown(LanderSim *sim, int plat_only) {
+  double ang = sim->theta * RAD2DEG;
+  if (ang > 180) ang -= 360;
+  sim->td_vx = sim->vx;
+  sim->td_vy = sim->vy;
+  sim->td_angle = ang;
+  if (plat_only && fabs(sim->vy) < 10 && fabs(ang) < 15) sim->status = SIM_LANDED;
+  else sim->status = SIM_CRASHED;
+}
+
+static int Off_Map(const LanderSim *sim) {
+  return sim->x < 0 || sim->y < 0 || sim->x >= sim->map->sx || sim->y >= sim->map->sy;
+}
+
+// Checks the lander outline against the terrain at the end of the step
+static void Check_Contact(LanderSim *sim) {
+  if (Off_Map(sim)) {
+    sim->status = SIM_LOST;
+    return;
+  }
+
+  // Nothing can touch while the nearest solid is farther away than the
+  // outline reaches (plus a margin for the pixel rounding below)
+  if (sim->map->sdf != NULL && Sdf_Clearance(sim->map->sdf, sim->x, sim->y) > sim->shape->radius + 2)
+    return;
+
+  int plat_only;
+  if (Outline_Contact(sim, sim->x, sim->y, sim->theta, &plat_only)) Touchdown(sim, plat_only);
+}
+
+// Halvings of a step when locating contact, to 1/4096 of T_STEP
+#define CONTACT_BISECT 12
+
+// No thrust combination accelerates the lander faster (m/s^2)
+#define MAX_ACCEL (G_ACCEL + MT_ACCEL + LT_ACCEL + RT_ACCEL)
+
+// Exact contact detection for the step that started at (x0, y0) with
+// velocity (vx0, vy0). During a step the lander moves in a straight
+// line at its new velocity, so the pose at any fraction of the step is
+// an interpolation and first contact is found by bisection
+static void Check_Contact_Exact(LanderSim *sim) {
+  double x0 = sim->x0, y0 = sim->y0;
+  double vx0 = sim->vx0, vy0 = sim->vy0;
+  if (Off_Map(sim)) {
+    sim->status = SIM_LOST;
+    return;
+  }
+  if (sim->sim_time < sim->clear_until) return;
+
+  // Far from terrain, skip the tests until the lander could have covered
+  // the clearance: from speed v at MAX_ACCEL, less a step for the
+  // difference between the steps and the continuous motion
+  if (sim->map->sdf != NULL) {
+    double room = Sdf_Clearance(sim->map->sdf, sim->x, sim->y) - sim->shape->radius - 2;
+    if (room > 0) {
+      double v = sqrt(sim->vx * sim->vx + sim->vy * sim->vy);
+      double t = (sqrt(v * v + 2 * MAX_ACCEL * room / S_SCALE) - v) / MAX_ACCEL;
+      sim->clear_until = sim->sim_time + t - T_STEP;
+      return;
+    }
+  }
+
+  int plat_only;
+  if (!Outline_Contact(sim, sim->x, sim->y, sim->theta, &plat_only)) return;
+
+  double x1 = sim->x, y1 = sim->y;
+  double vx1 = sim->vx, vy1 = sim->vy;
+  double lo = 0, hi = 1;
+  for (int k = 0; k < CONTACT_BISECT; k++) {
+    double f = (lo + hi) / 2;
+    int p;
+    if (Outline_Contact(sim, x0 + f * (x1 - x0), y0 + f * (y1 - y0), sim->theta, &p)) {
+      hi = f;
+      plat_only = p;
+    }
+    else lo = f;
+  }
+  sim->x = x0 + hi * (x1 - x0);
+  sim->y = y0 + hi * (y1 - y0);
+  sim->vx = vx0 + hi * (vx1 - vx0);
+  sim->vy = vy0 + hi * (vy1 - vy0);
+  sim->sim_time -= (1 - hi) * T_STEP;
+  Touchdown(sim, plat_only);
+}
+
+/*
+  Simulation
+*/
+
+void Sim_Reset(LanderSim *sim, const LanderMap *map, const LanderShape *shape,
+               int fail_mode, const int *comps, int ncomps, long seed) {
+  memset(sim, 0, sizeof(LanderSim));
+  sim->map = map;
+  sim->shape = shape;
+  Seed_Rand(sim, seed);
+  sim->max_time = 300;
+
+  // Random initial state near the top of the map
+  sim->x = Rand(sim, RNG_INIT) * 925 + 50;
+  sim->y = Rand(sim, RNG_INIT) * 50 + 50;
+  sim->vx = Rand(sim, RNG_INIT) * 25 - 12.5;
+  sim->vy = -(Rand(sim, RNG_INIT) * 15);
+  sim->theta = 2 * Rand(sim, RNG_INIT) * PI;
+
+  for (int i = 1; i < N_COMP; i++) sim->ok[i] = 1;
+  for (int i = 0; i < N_COMP; i++) sim->fail_tick[i] = -1;
+  sim->MT_OK = sim->LT_OK = sim->RT_OK = 1;
+
+  for (int i = 0; i < 36; i++) {
+    sim->sonar[i] = -1;
+    sim->beam_r[i] = SONAR_START;
+    sim->beam_live[i] = 1;
+  }
+
+  sim->fail_mode = fail_mode;
+  sim->fail_t1 = -1;
+  sim->fail_t2 = -1;
+  if (fail_mode == 1 || fail_mode == 2) {
+    sim->fail_t1 = Rand(sim, RNG_FAILURE) * 4;
+    sim->fail_t2 = Rand(sim, RNG_FAILURE) * 8;
+  }
+  else if (fail_mode == 3) {
+    for (int i = 0; i < ncomps; i++)
+      if (comps[i] > 0 && comps[i] < N_COMP) sim->f_list[comps[i]] = 1;
+    sim->fail_t1 = .5;
+  }
+
+  sim->status = SIM_FLYING;
+}
+
+void Sim_Set_Plan(LanderSim *sim, const FlightPlan *plan) {
+  sim->x = plan->x;
+  sim->y = plan->y;
+  sim->vx = plan->vx;
+  sim->vy = plan->vy;
+  sim->theta = plan->theta;
+  sim->fail_mode = 4;
+  for (int i = 0; i < N_COMP; i++) sim->f_time[i] = i > 0 ? plan->fail_time[i] : 0;
+}
+
+void Sim_Step(LanderSim *sim) {
+  if (sim->status != SIM_FLYING) return;
+  PROF_SCOPE(PROF_SIM);
+
+  Sim_Step_Move(sim);
+  double dx, dy, r0, r1;
+  for (int i = 0; i < 36; i++)
+    if (Sim_Beam(sim, i, &dx, &dy, &r0, &r1))
+      Sim_Sonar_Return(sim, i, Ray_March(sim->map, sim->x, sim->y, dx, dy, r0, r1));
+  Sim_Step_Finish(sim);
+}
+
+void Sim_Step_Move(LanderSim *sim) {
+  // Rotation, at most MAX_ROT_RATE per step
+  if (sim->rot_left > 0) {
+    double d = fmin(sim->rot_left, MAX_ROT_RATE);
+    sim->theta += d;
+    sim->rot_left -= d;
+  }
+  else if (sim->rot_left < 0) {
+    double d = fmin(-sim->rot_left, MAX_ROT_RATE);
+    sim->theta -= d;
+    sim->rot_left += d;
+  }
+  if (sim->theta < 0) sim->theta += 2 * PI;
+  sim->theta = fmod(sim->theta, 2 * PI);
+
+  // Accelerations from gravity and whichever thrusters still work
+  double s = sin(sim->theta);
+  double c = cos(sim->theta);
+  sim->ax = 0;
+  sim->ay = -G_ACCEL;
+  if (sim->main_pw > 0 && sim->ok[COMP_MAIN]) {
+    sim->ax += MT_ACCEL * sim->main_pw * s;
+    sim->ay += MT_ACCEL * sim->main_pw * c;
+    sim->thrust_s += sim->main_pw * T_STEP;
+  }
+  if (sim->left_pw > 0 && sim->ok[COMP_LEFT]) {
+    sim->ax += LT_ACCEL * sim->left_pw * c;
+    sim->ay -= LT_ACCEL * sim->left_pw * s;
+    sim->thrust_s += sim->left_pw * T_STEP;
+  }
+  if (sim->right_pw > 0 && sim->ok[COMP_RIGHT]) {
+    sim->ax -= RT_ACCEL * sim->right_pw * c;
+    sim->ay += RT_ACCEL * sim->right_pw * s;
+    sim->thrust_s += sim->right_pw * T_STEP;
+  }
+
+  sim->x0 = sim->x;
+  sim->y0 = sim->y;
+  sim->vx0 = sim->vx;
+  sim->vy0 = sim->vy;
+  sim->vx += sim->ax * T_STEP;
+  sim->vy += sim->ay * T_STEP;
+  sim->x += sim->vx * T_STEP * S_SCALE;
+  sim->y -= sim->vy * T_STEP * S_SCALE;
+}
+
+// Sonar beam directions, beam i points i * 10 degrees clockwise from up
+static double beam_dx[36], beam_dy[36];
+
+static int Init_Beams(void) {
+  for (int i = 0; i < 36; i++) {
+    beam_dx[i] = sin(i * 10 * DEG2RAD);
+    beam_dy[i] = -cos(i * 10 * DEG2RAD);
+  }
+  return 1;
+}
+
+static int beams_ready = Init_Beams();
+
+int Sim_Beam(const LanderSim *sim, int i, double *dx, double *dy, double *r0, double *r1) {
+  if (!sim->ok[COMP_SONAR] || !sim->beam_live[i]) return 0;
+  *dx = beam_dx[i];
+  *dy = beam_dy[i];
+  *r0 = sim->beam_r[i];
+  *r1 = *r0 + SONAR_RANGE;
+  return 1;
+}
+
+void Sim_Sonar_Return(LanderSim *sim, int i, double r) {
+  if (r >= 0) {
+    sim->sonar[i] = r + (Rand(sim, RNG_SONAR) - .5) * NP2 * r;
+    sim->beam_live[i] = 0;
+  }
+  sim->beam_r[i] += SONAR_RANGE;
+}
+
+void Sim_Step_Finish(LanderSim *sim) {
+  Update_Ping(sim);
+
+  sim->sim_time += T_STEP;
+  sim->ticks++;
+  Update_Failures(sim);
+
+  if (sim->exact_contact) Check_Contact_Exact(sim);
+  else Check_Contact(sim);
+  if (sim->status == SIM_FLYING && sim->sim_time > sim->max_time)
+    sim->status = SIM_TIMEOUT;
+}
+
+void Sim_Set_Exact_Contact(LanderSim *sim, int on) {
+  sim->exact_contact = on;
+  sim->clear_until = 0;
+}
+
+/*
+  Flight controls
+*/
+
+void Sim_Main_Thruster(LanderSim *sim, double power) {
+  sim->main_pw = Noisy_Power(sim, power);
+}
+
+void Sim_Left_Thruster(LanderSim *sim, double power) {
+  sim->left_pw = Noisy_Power(sim, power);
+}
+
+void Sim_Right_Thruster(LanderSim *sim, double power) {
+  sim->right_pw = Noisy_Power(sim, power);
+}
+
+void Sim_Rotate(LanderSim *sim, double angle) {
+  sim->rot_left = (angle * .95 + Rand(sim, RNG_ACTUATOR) * .05) * DEG2RAD;
+}
+
+/*
+  Sensors
+*/
+
+double Sim_Velocity_X(LanderSim *sim) {
+  sim->reads[SENS_VEL_X]++;
+  if (!sim->ok[COMP_VEL_X]) return Rand(sim, RNG_SENSOR + SENS_VEL_X) * 50 - 25;
+  return sim->vx + (Rand(sim, RNG_SENSOR + SENS_VEL_X) - .5) * NP1 * sim->vx;
+}
+
+double Sim_Velocity_Y(LanderSim *sim) {
+  sim->reads[SENS_VEL_Y]++;
+  if (!sim->ok[COMP_VEL_Y]) return Rand(sim, RNG_SENSOR + SENS_VEL_Y) * 50 - 25;
+  return sim->vy + (Rand(sim, RNG_SENSOR + SENS_VEL_Y) - .5) * NP1 * sim->vy;
+}
+
+double Sim_Position_X(LanderSim *sim) {
+  sim->reads[SENS_POS_X]++;
+  if (!sim->ok[COMP_POS_X]) return Rand(sim, RNG_SENSOR + SENS_POS_X) * MAP_SIZE;
+  return sim->x + (Rand(sim, RNG_SENSOR + SENS_POS_X) - .5) * NP1 * sim->x;
+}
+
+double Sim_Position_Y(LanderSim *sim) {
+  sim->reads[SENS_POS_Y]++;
+  if (!sim->ok[COMP_POS_Y]) return Rand(sim, RNG_SENSOR + SENS_POS_Y) * MAP_SIZE;
+  return sim->y + (Rand(sim, RNG_SENSOR + SENS_POS_Y) - .5) * NP1 * sim->y;
+}
+
+double Sim_Angle(LanderSim *sim) {
+  sim->reads[SENS_ANGLE]++;
+  if (!sim->ok[COMP_ANGLE]) return (sim->theta + Rand(sim, RNG_SENSOR + SENS_ANGLE) * 2.5 - 1.25) * RAD2DEG;
+  return (sim->theta + Rand(sim, RNG_SENSOR + SENS_ANGLE) * NP1 - NP1 / 2) * RAD2DEG;
+}
+
+double Sim_RangeDist(LanderSim *sim) {
+  double dx, dy;
+  Sim_Range_Ray(sim, &dx, &dy);
+  return Sim_Range_Return(sim, Ray_March(sim->map, sim->x, sim->y, dx, dy, 0, MAP_SIZE));
+}
+
+void Sim_Range_Ray(const LanderSim *sim, double *dx, double *dy) {
+  // Along the main thruster direction
+  *dx = -sin(sim->theta);
+  *dy = cos(sim->theta);
+}
+
+double Sim_Range_Return(LanderSim *sim, double r) {
+  sim->reads[SENS_RANGE]++;
+  // Distances are measured from the bottom of the lander (19 pixels
+  // below its centre)
+  return r >= 0 ? r - 19 : -1;
+}
+
+const char *Sim_Status_Name(int status) {
+  switch (status) {
+    case SIM_FLYING: return "flying";
+    case SIM_LANDED: return "landed";
+    case SIM_CRASHED: return "crashed";
+    case SIM_LOST: return "lost";
+    case SIM_TIMEOUT: return "timeout";
+  }
+  return "unknown";
+}
+
+const char *Sim_Sensor_Name(int sensor) {
+  switch (sensor) {
+    case SENS_VEL_X: return "vx";
+    case SENS_VEL_Y: return "vy";
+    case SENS_POS_X: return "px";
+    case SENS_POS_Y: return "py";
+    case SENS_ANGLE: return "angle";
+    case SENS_RANGE: return "range";
+  }
+  return "unknown";
+}
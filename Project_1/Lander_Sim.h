@@ -0,0 +1,244 @@
+/*
+	Headless lander simulation.
+
+	This is a source-level replacement for the simulation half of
+	Lander_Control.o. It loads the same .ppm maps, advances the lander
+	state every T_STEP with the same physics, actuator and sensor noise
+	model as the black box, and does no rendering at all, so a complete
+	landing runs in milliseconds instead of at display speed.
+
+	All state lives in a LanderSim, so any number of landers can be
+	flown side by side: give each one a SimIO and its own
+	LanderController. Lander_Headless.cpp binds one of them to the
+	global interface declared in Lander_Control.h instead.
+*/
+
+#ifndef _LANDER_SIM_H
+#define _LANDER_SIM_H
+
+#include "Lander_Control.h"
+#include "Lander_Controller.h"
+#include "Lander_Terrain.h"
+
+// Map size, all maps used by the project are 1024x1024
+#define MAP_SIZE 1024
+
+// Episode status
+#define SIM_FLYING 0
+#define SIM_LANDED 1
+#define SIM_CRASHED 2
+#define SIM_LOST 3
+#define SIM_TIMEOUT 4
+
+// Failable components, numbered as on the Lander_Control command line
+#define COMP_MAIN 1
+#define COMP_LEFT 2
+#define COMP_RIGHT 3
+#define COMP_VEL_X 4
+#define COMP_VEL_Y 5
+#define COMP_POS_X 6
+#define COMP_POS_Y 7
+#define COMP_ANGLE 8
+#define COMP_SONAR 9
+#define N_COMP 10
+
+// Random streams. Every source of randomness draws from its own
+// counter-based stream, so extra draws in one (say, the controller
+// reading a sensor twice) never shift the values seen by another
+#define RNG_INIT 0              // Initial state
+#define RNG_FAILURE 1           // Failure times and components
+#define RNG_ACTUATOR 2          // Thruster and rotation noise
+#define RNG_SONAR 3             // Sonar noise
+#define RNG_SENSOR 4            // Plus SENS_*, one stream per sensor
+#define N_RNG (RNG_SENSOR + N_SENS)
+
+// Sonar sweep parameters (a sweep restarts every SONAR_SWEEP seconds,
+// each beam starts at SONAR_START pixels and advances SONAR_RANGE pixels
+// per time step)
+#define SONAR_SWEEP .25
+#define SONAR_START 15.0
+
+// Maximum number of outline pixels in the lander footprint
+#define MAX_OUTLINE 1024
+
+struct LanderSDF;
+
+// Terrain map. Cells are classified once at load time and kept packed
+// (Lander_Terrain.h), the original RGB data is not kept.
+struct LanderMap {
+  int sx, sy;
+  LanderTerrain terrain;
+  double plat_x, plat_y;  // Platform centroid (what PLAT_X/PLAT_Y report)
+  LanderSDF *sdf;         // Distance field (Lander_SDF.h), NULL if unavailable
+};
+
+// Returns the map cell (CELL_*) at a pixel, out-of-map pixels are open
+static inline int Map_Cell(const LanderMap *map, int i, int j) {
+  if (i < 0 || j < 0 || i >= map->sx || j >= map->sy) return CELL_OPEN;
+  if (!Terrain_Solid(&map->terrain, i, j)) return CELL_OPEN;
+  return Terrain_Platform(&map->terrain, i, j) ? CELL_PLATFORM : CELL_TERRAIN;
+}
+
+// Lander footprint: outline pixels of lander.ppm relative to the sprite
+// centre. The lander moves well under a pixel per step so testing the
+// outline is enough to catch every contact.
+struct LanderShape {
+  int n;
+  double radius;          // Farthest outline pixel from the centre
+  double u[MAX_OUTLINE];
+  double v[MAX_OUTLINE];
+};
+
+struct LanderSim {
+  const LanderMap *map;
+  const LanderShape *shape;
+
+  // Physical state. Position in pixels (y grows downward), velocity in
+  // m/s (vy positive upward), angle in radians clockwise from vertical
+  double x, y, vx, vy, theta;
+  double ax, ay;
+  double x0, y0, vx0, vy0;  // Position and velocity at the start of the step
+
+  // Actuator state as set by the (noisy) control functions
+  double main_pw, left_pw, right_pw;
+  double rot_left;        // Rotation still to be carried out, radians
+
+  // Component status indexed by component number, 1 means working
+  int ok[N_COMP];
+  int MT_OK, RT_OK, LT_OK;
+  long fail_tick[N_COMP]; // Tick a component failed at, -1 if it has not
+
+  // Sonar
+  double sonar[36];
+  double beam_r[36];
+  int beam_live[36];
+  double ping_time;
+
+  // Failure injection
+  int fail_mode;
+  int f_list[N_COMP];     // Mode 3: components to disable, 1 = disable
+  double f_time[N_COMP];  // Mode 4: time each component fails at, 0 = never
+  double fail_t1, fail_t2;
+
+  // Episode bookkeeping
+  double sim_time;
+  long ticks;
+  int status;
+  double td_vx, td_vy, td_angle;  // Velocity and angle (deg) at contact
+  double max_time;
+  int verbose;
+  long reads[N_SENS];     // Sensor calls made by the flight computer (SENS_*)
+  double thrust_s;        // Thrust delivered, in seconds at full power (all thrusters)
+
+  // Contact detection (see Sim_Set_Exact_Contact)
+  int exact_contact;
+  double clear_until;     // No contact is possible before this time
+  long contact_tests;     // Outline tests made
+
+  unsigned long long rng_key;
+  unsigned long long rng_ctr[N_RNG];  // Draws made so far, per stream
+};
+
+// Map and footprint loading, return 0 on failure. Sim_Load_Map takes a
+// .ppm or a packed .ltm map. Given a .ppm, it maps the .ltm next to it
+// instead if Lander_MkTerrain made one that is not older than the .ppm.
+// It also attaches the map's distance field, read from the .sdf file
+// next to the map if Lander_MkSDF made one that is up to date, built
+// otherwise
+int Sim_Load_Map(const char *fname, LanderMap *map);
+void Sim_Free_Map(LanderMap *map);
+
+// Read and classify a .ppm map into a packed terrain (flags as for
+// Terrain_Pack), ignoring any .ltm file
+int Sim_Read_Map(const char *fname, int flags, LanderTerrain *ter);
+int Sim_Load_Shape(const char *fname, LanderShape *shape);
+
+// Start a new episode. comps lists the components to disable in mode 3
+// (ncomps entries, numbered as on the command line)
+void Sim_Reset(LanderSim *sim, const LanderMap *map, const LanderShape *shape,
+               int fail_mode, const int *comps, int ncomps, long seed);
+
+// A landing fixed up front, for a corpus of them: the initial state and
+// the failure schedule
+struct FlightPlan {
+  double x, y, vx, vy, theta;
+  double fail_time[N_COMP]; // Time each component fails at (s), 0 = never
+};
+
+// Replace the seeded initial state and failures of an episode, right
+// after Sim_Reset(). The episode runs in failure mode 4 (the schedule),
+// the sensor and actuator noise still come from the seed
+void Sim_Set_Plan(LanderSim *sim, const FlightPlan *plan);
+
+// Advance the simulation by one T_STEP
+void Sim_Step(LanderSim *sim);
+
+// Sim_Step() in parts, for drivers that march the sonar beams of many
+// landers at once (see Raycast_Step in Lander_Raycast.h). After
+// Sim_Step_Move(), every beam i that Sim_Beam() reports as marching
+// this step samples from r0 up to r1 pixels along (dx, dy) from the
+// lander's new position, and the first solid sample (-1 for none) is
+// handed back with Sim_Sonar_Return(), in beam order. Sim_Step_Finish()
+// then completes the step
+void Sim_Step_Move(LanderSim *sim);
+int Sim_Beam(const LanderSim *sim, int i, double *dx, double *dy, double *r0, double *r1);
+void Sim_Sonar_Return(LanderSim *sim, int i, double r);
+void Sim_Step_Finish(LanderSim *sim);
+
+// Contact detection mode, for after Sim_Reset(). By default the outline
+// is tested against the terrain at the end of every step, and contact
+// is reported with the state at the end of that step. With exact
+// contact on, no test is made while the terrain clearance is more than
+// the lander can cover at its current speed and full thrust, and a
+// step that ends in contact is bisected for the moment of first
+// contact: the episode then ends with the time, position and velocity
+// at that moment. The controller is still run every T_STEP either way
+void Sim_Set_Exact_Contact(LanderSim *sim, int on);
+
+// Flight controls and sensors, same semantics as Lander_Control.h
+void Sim_Main_Thruster(LanderSim *sim, double power);
+void Sim_Left_Thruster(LanderSim *sim, double power);
+void Sim_Right_Thruster(LanderSim *sim, double power);
+void Sim_Rotate(LanderSim *sim, double angle);
+double Sim_Velocity_X(LanderSim *sim);
+double Sim_Velocity_Y(LanderSim *sim);
+double Sim_Position_X(LanderSim *sim);
+double Sim_Position_Y(LanderSim *sim);
+double Sim_Angle(LanderSim *sim);
+double Sim_RangeDist(LanderSim *sim);
+
+// Sim_RangeDist() in parts, as for the sonar: the ray samples from 0 up
+// to MAP_SIZE pixels along (dx, dy) from the lander, and the first
+// solid sample is turned into the reading by Sim_Range_Return()
+void Sim_Range_Ray(const LanderSim *sim, double *dx, double *dy);
+double Sim_Range_Return(LanderSim *sim, double r);
+
+const char *Sim_Status_Name(int status);
+const char *Sim_Sensor_Name(int sensor);
+
+// Connects a controller instance to a simulated lander
+class SimIO : public LanderIO {
+ public:
+  SimIO(LanderSim *sim) : sim(sim) {}
+
+  void Main_Thruster(double power) { Sim_Main_Thruster(sim, power); }
+  void Left_Thruster(double power) { Sim_Left_Thruster(sim, power); }
+  void Right_Thruster(double power) { Sim_Right_Thruster(sim, power); }
+  void Rotate(double angle) { Sim_Rotate(sim, angle); }
+  double Velocity_X() { return Sim_Velocity_X(sim); }
+  double Velocity_Y() { return Sim_Velocity_Y(sim); }
+  double Position_X() { return Sim_Position_X(sim); }
+  double Position_Y() { return Sim_Position_Y(sim); }
+  double Angle() { return Sim_Angle(sim); }
+  double RangeDist() { return Sim_RangeDist(sim); }
+  int MT_OK() { return sim->MT_OK; }
+  int RT_OK() { return sim->RT_OK; }
+  int LT_OK() { return sim->LT_OK; }
+  double PLAT_X() { return sim->map->plat_x; }
+  double PLAT_Y() { return sim->map->plat_y; }
+  const double *SONAR_DIST() { return sim->sonar; }
+
+  LanderSim *sim;
+};
+
+#endif
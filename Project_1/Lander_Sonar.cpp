@@ -0,0 +1,76 @@
+/*
+	Sonar sector reduction - see Lander_Sonar.h
+*/
+
+#include <string.h>
+
+#include "Lander_Sonar.h"
+
+// Beams are worked on rotated by four, so that every sector is one run:
+// position k holds beam (k + 32) % 36 and sector s ends before
+// sector_end[s]
+static const int sector_end[N_SECTOR] = {9, 18, 26, 36};
+
+static inline int Beam_Of(int k) {
+  return k < 4 ? k + 32 : k - 4;
+}
+
+void Sonar_Reduce(const double *sonar, double *dist, int *beam) {
+  // Rotate and replace missing returns by SECTOR_CLEAR. Plain loops
+  // without branches, the compiler turns them into vector compares,
+  // blends and minimums
+  double d[36];
+  for (int k = 0; k < 4; k++) d[k] = sonar[k + 32];
+  for (int k = 4; k < 36; k++) d[k] = sonar[k - 4];
+  for (int k = 0; k < 36; k++) d[k] = d[k] > -1 ? d[k] : SECTOR_CLEAR;
+
+  int k0 = 0;
+  for (int s = 0; s < N_SECTOR; s++) {
+    double m = SECTOR_CLEAR;
+    for (int k = k0; k < sector_end[s]; k++) m = d[k] < m ? d[k] : m;
+    dist[s] = m;
+    beam[s] = -1;
+    if (m < SECTOR_CLEAR) {
+      for (int k = k0; k < sector_end[s]; k++) {
+        if (d[k] == m) {
+          beam[s] = Beam_Of(k);
+          break;
+        }
+      }
+    }
+    k0 = sector_end[s];
+  }
+}
+
+void SonarStage::Reset() {
+  for (int i = 0; i < 36; i++) last[i] = -1;
+  for (int s = 0; s < N_SECTOR; s++) {
+    sec[s].dist = SECTOR_CLEAR;
+    sec[s].bearing = -1;
+    sec[s].beam = -1;
+    sec[s].changed = 0;
+  }
+  tick = -1;
+  changed = 0;
+}
+
+// A reading changed (or this is the first update), recompute the sectors
+void SonarStage::Refresh(const double *sonar) {
+  double dist[N_SECTOR];
+  int beam[N_SECTOR];
+  Sonar_Reduce(sonar, dist, beam);
+
+  int k0 = 0;
+  for (int s = 0; s < N_SECTOR; s++) {
+    bool moved = tick == 0;
+    for (int k = k0; k < sector_end[s] && !moved; k++) moved = last[Beam_Of(k)] != sonar[Beam_Of(k)];
+    if (moved) sec[s].changed = tick;
+    sec[s].dist = dist[s];
+    sec[s].beam = beam[s];
+    sec[s].bearing = beam[s] < 0 ? -1 : beam[s] * 10.0;
+    k0 = sector_end[s];
+  }
+
+  memcpy(last, sonar, sizeof(last));
+  changed = tick;
+}
@@ -0,0 +1,77 @@
+/*
+	Sonar sector reduction for the flight computer.
+
+	The 36 sonar beams are grouped into four sectors around the lander
+	(beams are in map directions, 10 degrees apart clockwise from up):
+
+	  up     beams 32-35 and 0-4
+	  right  beams 5-13
+	  down   beams 14-21
+	  left   beams 22-31
+
+	For each sector SonarStage keeps the nearest return, the beam and
+	bearing it came from, and how many ticks have passed since any
+	reading in the sector last changed. Readings only change when a
+	beam returns or a new sweep starts, so most ticks the array is the
+	same as on the tick before: Update() detects that with one compare
+	and keeps the cached sectors. When something did change, all four
+	sectors are recomputed in one branch-free pass over the beams.
+*/
+
+#ifndef _LANDER_SONAR_H
+#define _LANDER_SONAR_H
+
+#include <string.h>
+
+// Sectors
+#define SECTOR_UP 0
+#define SECTOR_RIGHT 1
+#define SECTOR_DOWN 2
+#define SECTOR_LEFT 3
+#define N_SECTOR 4
+
+// No sonar return in a sector
+#define SECTOR_CLEAR 1000000.0
+
+struct SonarSector {
+  double dist;              // Nearest return (pixels), SECTOR_CLEAR if none
+  double bearing;           // Direction of that return, degrees clockwise from up, -1 if none
+  int beam;                 // Beam of that return, -1 if none
+  long changed;             // Tick a reading in this sector last changed
+};
+
+// Nearest return and its beam (-1 if none) for each sector of a 36 entry
+// sonar array
+void Sonar_Reduce(const double *sonar, double *dist, int *beam);
+
+class SonarStage {
+ public:
+  SonarStage() { Reset(); }
+
+  void Reset();
+
+  // Take this tick's readings, returns true if any of them changed
+  bool Update(const double *sonar) {
+    tick++;
+    if (tick > 0 && memcmp(last, sonar, sizeof(last)) == 0) return false;
+    Refresh(sonar);
+    return true;
+  }
+
+  const SonarSector *Sector(int s) const { return &sec[s]; }
+  double Nearest(int s) const { return sec[s].dist; }
+
+  // Ticks since a reading in sector s changed, and since any changed
+  long Age(int s) const { return tick - sec[s].changed; }
+  long Age() const { return tick - changed; }
+
+ private:
+  void Refresh(const double *sonar);
+
+  double last[36];
+  SonarSector sec[N_SECTOR];
+  long tick;                // Updates so far, less one
+  long changed;
+};
+
+#endif
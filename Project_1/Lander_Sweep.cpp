@@ -0,0 +1,372 @@
+/*
+	Exhaustive failure combination sweep.
+
+	Flies N seeded landings for every subset of the nine failable
+	components (mode 3 with that component list, 512 subsets counting
+	the empty one) on every map. For each map it prints the success
+	rates as a matrix, one row per set of failed sensors and one column
+	per set of failed thrusters, followed by the minimal combinations
+	the controller cannot survive: those with no landing in N whose
+	every subset with one component fewer lands at least once.
+
+	Usage: Lander_Sweep [-n N] [-j threads] [-s seed] [-t max_time] [-k cache] map1.ppm [map2.ppm ...]
+
+	Episodes differ a lot in length (a crash can end in a second, a
+	landing without the main thruster takes minutes), so they run on a
+	work-stealing pool: each worker starts on its own contiguous share
+	of the episodes and, when that runs out, takes the back half of the
+	largest share left to another worker.
+
+	Results are cached per episode in a file (sweep.cache by default),
+	keyed by build, map, max_time, subset and seed. The build key is a
+	checksum the Makefile takes over the controller and simulator
+	sources and the compiler flags when it builds this program. A rerun
+	of the same build only flies the episodes it has not seen (a larger
+	N, another map), a rebuild with a changed controller flies them all
+	again. Results of other builds stay in the file, so going back to an
+	earlier build costs nothing.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Lander_Episode.h"
+
+#ifndef BUILD_HASH
+#define BUILD_HASH "unknown"
+#endif
+
+#define MAX_MAPS 8
+
+// Subsets of components 1-9, bit c - 1 set if component c fails. The
+// low three bits are the thrusters, the rest the sensors
+#define N_FAILABLE 9
+#define N_SUBSETS (1 << N_FAILABLE)
+#define THRUSTER_BITS 3
+#define N_THRUSTER_SETS (1 << THRUSTER_BITS)
+#define N_SENSOR_SETS (N_SUBSETS >> THRUSTER_BITS)
+
+struct Outcome {
+  int status;
+  double time;
+};
+
+struct Job {
+  int map, subset;
+  long seed;
+};
+
+// "1,5,8" for a subset, "-" for none
+static void Subset_Name(char *buf, size_t len, int subset) {
+  buf[0] = '\0';
+  for (int c = 1; c <= N_FAILABLE; c++) {
+    if (!(subset & (1 << (c - 1)))) continue;
+    size_t at = strlen(buf);
+    snprintf(buf + at, len - at, at > 0 ? ",%d" : "%d", c);
+  }
+  if (buf[0] == '\0') snprintf(buf, len, "-");
+}
+
+// FNV-1a over a file's contents, 0 if it cannot be read
+static unsigned long long File_Hash(const char *fname) {
+  FILE *f = fopen(fname, "rb");
+  if (f == NULL) return 0;
+  unsigned long long h = 0xcbf29ce484222325ULL;
+  unsigned char buf[65536];
+  size_t got;
+  while ((got = fread(buf, 1, sizeof(buf), f)) > 0)
+    for (size_t i = 0; i < got; i++) h = (h ^ buf[i]) * 0x100000001b3ULL;
+  fclose(f);
+  return h;
+}
+
+/*
+  Result cache
+*/
+
+typedef std::map<std::string, Outcome> ResultCache;
+
+static std::string Cache_Key(unsigned long long map_hash, double max_time, int subset, long seed) {
+  char buf[128];
+  snprintf(buf, sizeof(buf), "%s %016llx %g %d %ld", BUILD_HASH, map_hash, max_time, subset, seed);
+  return buf;
+}
+
+// One line per episode: build, map hash, max_time, subset, seed, then
+// status and time
+static void Cache_Load(const char *fname, ResultCache *cache) {
+  FILE *f = fopen(fname, "r");
+  if (f == NULL) return;
+  char build[64];
+  unsigned long long map_hash;
+  double max_time, time;
+  int subset, status;
+  long seed;
+  while (fscanf(f, "%63s %llx %lf %d %ld %d %lf", build, &map_hash, &max_time, &subset, &seed,
+                &status, &time) == 7) {
+    char key[192];
+    snprintf(key, sizeof(key), "%s %016llx %g %d %ld", build, map_hash, max_time, subset, seed);
+    Outcome o = {status, time};
+    (*cache)[key] = o;
+  }
+  fclose(f);
+}
+
+static int Cache_Append(const char *fname, const std::vector<std::string> &keys,
+                        const std::vector<Outcome> &out) {
+  FILE *f = fopen(fname, "a");
+  if (f == NULL) {
+    fprintf(stderr, "Unable to open file %s for writing\n", fname);
+    return 0;
+  }
+  for (size_t i = 0; i < keys.size(); i++)
+    fprintf(f, "%s %d %.17g\n", keys[i].c_str(), out[i].status, out[i].time);
+  if (fclose(f) != 0) {
+    fprintf(stderr, "Failed to write cache %s\n", fname);
+    return 0;
+  }
+  return 1;
+}
+
+/*
+  Work-stealing pool
+*/
+
+// Jobs next .. end - 1 are left to a worker. Both change only under the
+// lock, thieves read them without it to pick a victim
+struct Share {
+  std::mutex lock;
+  std::atomic<long> next, end;
+};
+
+static bool Take(Share *s, long *job) {
+  std::lock_guard<std::mutex> g(s->lock);
+  if (s->next >= s->end) return false;
+  *job = s->next++;
+  return true;
+}
+
+// Move the back half of the largest other share to shares[self]
+static bool Steal(std::vector<Share> &shares, int self) {
+  for (;;) {
+    int victim = -1;
+    long most = 0;
+    for (int w = 0; w < (int)shares.size(); w++) {
+      if (w == self) continue;
+      long left = shares[w].end - shares[w].next;   // Unlocked, only a hint
+      if (left > most) {
+        most = left;
+        victim = w;
+      }
+    }
+    if (victim < 0) return false;
+
+    long lo, hi;
+    {
+      std::lock_guard<std::mutex> g(shares[victim].lock);
+      long left = shares[victim].end - shares[victim].next;
+      if (left <= 0) continue;
+      hi = shares[victim].end;
+      lo = hi - (left + 1) / 2;
+      shares[victim].end = lo;
+    }
+    std::lock_guard<std::mutex> g(shares[self].lock);
+    shares[self].next = lo;
+    shares[self].end = hi;
+    return true;
+  }
+}
+
+static void Run_Jobs(long njobs, int nthreads, void (*run)(long job, void *arg), void *arg) {
+  std::vector<Share> shares(nthreads);
+  for (int w = 0; w < nthreads; w++) {
+    shares[w].next = njobs * w / nthreads;
+    shares[w].end = njobs * (w + 1) / nthreads;
+  }
+  std::vector<std::thread> workers;
+  for (int w = 0; w < nthreads; w++) {
+    workers.push_back(std::thread([&shares, w, run, arg]() {
+      long j;
+      for (;;) {
+        if (Take(&shares[w], &j)) run(j, arg);
+        else if (!Steal(shares, w)) break;
+      }
+    }));
+  }
+  for (size_t w = 0; w < workers.size(); w++) workers[w].join();
+}
+
+/*
+  Sweep
+*/
+
+struct Sweep {
+  const LanderMap *maps;
+  const char **map_names;
+  const LanderShape *shape;
+  double max_time;
+  const std::vector<Job> *jobs;
+  std::vector<Outcome> *out;
+};
+
+static void Fly(long j, void *arg) {
+  const Sweep *sw = (const Sweep *)arg;
+  const Job *job = &(*sw->jobs)[j];
+  Scenario sc;
+  sc.map = &sw->maps[job->map];
+  sc.shape = sw->shape;
+  sc.fail_mode = 3;
+  sc.ncomps = 0;
+  for (int c = 1; c <= N_FAILABLE; c++)
+    if (job->subset & (1 << (c - 1))) sc.comps[sc.ncomps++] = c;
+  sc.seed = job->seed;
+  sc.max_time = sw->max_time;
+  sc.map_name = sw->map_names[job->map];
+  sc.trace_name = NULL;
+  sc.policy = NULL;
+  sc.params = NULL;
+  sc.exact_contact = 0;
+  sc.plan = NULL;
+  sc.time_control = 0;
+  EpisodeResult res;
+  Run_Episode(&sc, &res);
+  Outcome o = {res.status, res.time};
+  (*sw->out)[j] = o;
+}
+
+static void Print_Map(const char *map_name, const long *landed, long n) {
+  char name[32];
+  printf("%s: success %% over %ld landings, rows are failed sensors, columns failed thrusters\n",
+         map_name, n);
+  printf("%-12s", "");
+  for (int t = 0; t < N_THRUSTER_SETS; t++) {
+    Subset_Name(name, sizeof(name), t);
+    printf(" %6s", name);
+  }
+  printf("\n");
+  for (int s = 0; s < N_SENSOR_SETS; s++) {
+    Subset_Name(name, sizeof(name), s << THRUSTER_BITS);
+    printf("%-12s", name);
+    for (int t = 0; t < N_THRUSTER_SETS; t++)
+      printf(" %6.0f", 100.0 * landed[(s << THRUSTER_BITS) | t] / n);
+    printf("\n");
+  }
+
+  int nfatal = 0;
+  for (int m = 0; m < N_SUBSETS; m++) nfatal += landed[m] == 0;
+  printf("%d of %d combinations never landed, minimal ones:", nfatal, N_SUBSETS);
+  for (int m = 0; m < N_SUBSETS; m++) {
+    if (landed[m] != 0) continue;
+    bool minimal = true;
+    for (int b = 0; b < N_FAILABLE && minimal; b++)
+      if (m & (1 << b)) minimal = landed[m & ~(1 << b)] > 0;
+    if (!minimal) continue;
+    Subset_Name(name, sizeof(name), m);
+    printf(" {%s}", name);
+  }
+  printf("\n\n");
+}
+
+static void Usage(void) {
+  fprintf(stderr, "Usage: Lander_Sweep [-n N] [-j threads] [-s seed] [-t max_time] [-k cache] map1.ppm [map2.ppm ...]\n");
+}
+
+int main(int argc, char *argv[]) {
+  long n = 10;
+  int nthreads = (int)std::thread::hardware_concurrency();
+  long seed = 1;
+  double max_time = 300;
+  const char *cache_name = "sweep.cache";
+
+  int a = 1;
+  while (a < argc && argv[a][0] == '-') {
+    if (!strcmp(argv[a], "-n") && a + 1 < argc) n = strtol(argv[++a], NULL, 10);
+    else if (!strcmp(argv[a], "-j") && a + 1 < argc) nthreads = (int)strtol(argv[++a], NULL, 10);
+    else if (!strcmp(argv[a], "-s") && a + 1 < argc) seed = strtol(argv[++a], NULL, 10);
+    else if (!strcmp(argv[a], "-t") && a + 1 < argc) max_time = atof(argv[++a]);
+    else if (!strcmp(argv[a], "-k") && a + 1 < argc) cache_name = argv[++a];
+    else {
+      Usage();
+      return 1;
+    }
+    a++;
+  }
+  if (a >= argc || n < 1) {
+    Usage();
+    return 1;
+  }
+  if (nthreads < 1) nthreads = 1;
+
+  static LanderMap maps[MAX_MAPS];
+  const char *map_names[MAX_MAPS];
+  unsigned long long map_hash[MAX_MAPS];
+  int nmaps = 0;
+  unsigned long long shape_hash = File_Hash("lander.ppm");
+  for (; a < argc && nmaps < MAX_MAPS; a++) {
+    if (!Sim_Load_Map(argv[a], &maps[nmaps])) return 1;
+    map_names[nmaps] = argv[a];
+    map_hash[nmaps] = File_Hash(argv[a]) ^ shape_hash;
+    nmaps++;
+  }
+  static LanderShape shape;
+  if (!Sim_Load_Shape("lander.ppm", &shape)) {
+    fprintf(stderr, "Unable to load lander image. Ensure it is in the same directory\n");
+    return 1;
+  }
+
+  ResultCache cache;
+  Cache_Load(cache_name, &cache);
+
+  // Everything not in the cache, cell by cell so each worker's share
+  // starts out as whole cells
+  std::vector<Job> jobs;
+  std::vector<std::string> keys;
+  for (int m = 0; m < nmaps; m++) {
+    for (int s = 0; s < N_SUBSETS; s++) {
+      for (long k = 0; k < n; k++) {
+        std::string key = Cache_Key(map_hash[m], max_time, s, seed + k);
+        if (cache.find(key) != cache.end()) continue;
+        Job job = {m, s, seed + k};
+        jobs.push_back(job);
+        keys.push_back(key);
+      }
+    }
+  }
+  long total = (long)nmaps * N_SUBSETS * n;
+  fprintf(stderr, "build %s: %ld of %ld episodes cached, flying %zu on %d threads\n", BUILD_HASH,
+          total - (long)jobs.size(), total, jobs.size(), nthreads);
+
+  struct timespec t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  std::vector<Outcome> out(jobs.size());
+  Sweep sw = {maps, map_names, &shape, max_time, &jobs, &out};
+  Run_Jobs((long)jobs.size(), nthreads, Fly, &sw);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  double wall = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+  if (!jobs.empty()) {
+    fprintf(stderr, "%zu episodes in %.2fs (%.0f episodes/s)\n", jobs.size(), wall, jobs.size() / wall);
+    if (!Cache_Append(cache_name, keys, out)) return 1;
+    for (size_t i = 0; i < keys.size(); i++) cache[keys[i]] = out[i];
+  }
+
+  for (int m = 0; m < nmaps; m++) {
+    std::vector<long> landed(N_SUBSETS, 0);
+    for (int s = 0; s < N_SUBSETS; s++)
+      for (long k = 0; k < n; k++)
+        landed[s] += cache[Cache_Key(map_hash[m], max_time, s, seed + k)].status == SIM_LANDED;
+    Print_Map(map_names[m], &landed[0], n);
+  }
+
+  for (int i = 0; i < nmaps; i++) Sim_Free_Map(&maps[i]);
+  return 0;
+}
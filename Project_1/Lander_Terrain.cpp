@@ -0,0 +1,154 @@
+/*
+	Packed terrain maps - see Lander_Terrain.h
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Lander_Terrain.h"
+
+static int Row_Bytes(int width) {
+  return (width + 63) / 64 * 8;
+}
+
+// Point the section pointers at the storage in ter->file
+static void Attach(LanderTerrain *ter) {
+  const unsigned char *base = (const unsigned char *)ter->file.base;
+  ter->head = (const TerrainHeader *)base;
+  ter->occ = base + ter->head->occ_offset;
+  ter->plat = base + ter->head->plat_offset;
+  ter->height = (ter->head->flags & TERRAIN_HEIGHT) ? (const unsigned short *)(base + ter->head->height_offset) : NULL;
+}
+
+/*
+  Packing
+*/
+
+int Terrain_Pack(const unsigned char *cells, int sx, int sy, int flags, LanderTerrain *ter) {
+  memset(ter, 0, sizeof(LanderTerrain));
+
+  // Platform extents and centroid
+  TerrainHeader h;
+  memset(&h, 0, sizeof(h));
+  h.plat_x0 = sx;
+  h.plat_y0 = sy;
+  h.plat_x1 = -1;
+  h.plat_y1 = -1;
+  double px = 0, py = 0;
+  int np = 0;
+  for (int j = 0; j < sy; j++) {
+    for (int i = 0; i < sx; i++) {
+      if (cells[i + j * sx] != CELL_PLATFORM) continue;
+      if (i < h.plat_x0) h.plat_x0 = i;
+      if (i > h.plat_x1) h.plat_x1 = i;
+      if (j < h.plat_y0) h.plat_y0 = j;
+      if (j > h.plat_y1) h.plat_y1 = j;
+      px += i;
+      py += j;
+      np++;
+    }
+  }
+  if (np == 0) return 0;
+
+  memcpy(h.magic, "LTRN", 4);
+  h.version = TERRAIN_VERSION;
+  h.sx = sx;
+  h.sy = sy;
+  h.flags = flags & TERRAIN_HEIGHT;
+  h.row_bytes = Row_Bytes(sx);
+  h.plat_row_bytes = Row_Bytes(h.plat_x1 - h.plat_x0 + 1);
+  h.plat_x = px / np;
+  h.plat_y = py / np;
+  h.occ_offset = Section_Align(sizeof(TerrainHeader));
+  h.plat_offset = Section_Align(h.occ_offset + (unsigned long long)h.row_bytes * sy);
+  h.height_offset = Section_Align(h.plat_offset + (unsigned long long)h.plat_row_bytes * (h.plat_y1 - h.plat_y0 + 1));
+  h.size = h.height_offset;
+  if (h.flags & TERRAIN_HEIGHT) h.size = Section_Align(h.size + (unsigned long long)sx * sizeof(unsigned short));
+
+  if (!Section_Alloc(h.size, &ter->file)) {
+    fprintf(stderr, "Out of memory packing terrain\n");
+    return 0;
+  }
+  unsigned char *base = (unsigned char *)ter->file.base;
+  memcpy(base, &h, sizeof(h));
+  unsigned char *occ = base + h.occ_offset;
+  unsigned char *plat = base + h.plat_offset;
+  for (int j = 0; j < sy; j++) {
+    for (int i = 0; i < sx; i++) {
+      int c = cells[i + j * sx];
+      if (c != CELL_OPEN) occ[(size_t)j * h.row_bytes + (i >> 3)] |= 1 << (i & 7);
+      if (c == CELL_PLATFORM) {
+        int u = i - h.plat_x0;
+        int v = j - h.plat_y0;
+        plat[(size_t)v * h.plat_row_bytes + (u >> 3)] |= 1 << (u & 7);
+      }
+    }
+  }
+  if (h.flags & TERRAIN_HEIGHT) {
+    unsigned short *height = (unsigned short *)(base + h.height_offset);
+    for (int i = 0; i < sx; i++) {
+      int j = 0;
+      while (j < sy && cells[i + j * sx] == CELL_OPEN) j++;
+      height[i] = (unsigned short)j;
+    }
+  }
+
+  Attach(ter);
+  return 1;
+}
+
+/*
+  Files
+*/
+
+void Terrain_File_Name(const char *map_name, char *out, int len) {
+  snprintf(out, len, "%s", map_name);
+  char *ext = strrchr(out, '.');
+  if (ext != NULL && strchr(ext, '/') == NULL) *ext = '\0';
+  int n = strlen(out);
+  snprintf(out + n, len - n, ".ltm");
+}
+
+int Terrain_Save(const char *fname, const LanderTerrain *ter) {
+  return Section_Save(fname, &ter->file, "terrain");
+}
+
+// The layout checks, so a truncated or foreign file cannot send the
+// cell tests out of bounds
+static int Valid_Header(const SectionFile *sf) {
+  const TerrainHeader *h = (const TerrainHeader *)sf->base;
+  size_t len = sf->len;
+  if (!Section_Check(sf, "LTRN", TERRAIN_VERSION, h->size))
+    return 0;
+  if (h->sx <= 0 || h->sy <= 0 || h->sx > 65535 || h->sy > 65535 ||
+      h->row_bytes != Row_Bytes(h->sx))
+    return 0;
+  if (h->plat_x0 < 0 || h->plat_x0 > h->plat_x1 || h->plat_x1 >= h->sx ||
+      h->plat_y0 < 0 || h->plat_y0 > h->plat_y1 || h->plat_y1 >= h->sy ||
+      h->plat_row_bytes != Row_Bytes(h->plat_x1 - h->plat_x0 + 1))
+    return 0;
+  if (h->occ_offset % SECTION_ALIGN || h->plat_offset % SECTION_ALIGN || h->height_offset % SECTION_ALIGN ||
+      h->occ_offset + (unsigned long long)h->row_bytes * h->sy > len ||
+      h->plat_offset + (unsigned long long)h->plat_row_bytes * (h->plat_y1 - h->plat_y0 + 1) > len)
+    return 0;
+  if ((h->flags & TERRAIN_HEIGHT) &&
+      h->height_offset + (unsigned long long)h->sx * sizeof(unsigned short) > len)
+    return 0;
+  return 1;
+}
+
+int Terrain_Map(const char *fname, LanderTerrain *ter) {
+  memset(ter, 0, sizeof(LanderTerrain));
+  if (Section_Map(fname, sizeof(TerrainHeader), &ter->file) != SECTION_OK) return 0;
+  if (!Valid_Header(&ter->file)) {
+    Section_Free(&ter->file);
+    return 0;
+  }
+  Attach(ter);
+  return 1;
+}
+
+void Terrain_Free(LanderTerrain *ter) {
+  Section_Free(&ter->file);
+  memset(ter, 0, sizeof(LanderTerrain));
+}
@@ -0,0 +1,105 @@
+/*
+	Packed terrain maps.
+
+	Flight only needs to know, for each map pixel, whether it is open,
+	terrain or platform. A .ltm file stores just that, which replaces the
+	3 MB RGB .ppm with about 130 KB:
+
+	- a versioned header with the map size, the platform extents and
+	  the platform centroid,
+	- a 1-bit occupancy bitmap (set = solid), rows padded to 8 bytes,
+	- a 1-bit platform bitmap covering only the platform extents,
+	- optionally a heightfield: for each column, the first solid row
+	  from the top of the map.
+
+	Nothing reads the heightfield yet. The RangeDist() ray follows the
+	lander's tilt, so a column lookup would answer it only when the
+	lander is exactly upright, which it practically never is. It is
+	left out unless asked for (Lander_MkTerrain -h), and a map without
+	it has the same occupancy and platform sections.
+
+	The file is laid out exactly as it is used in memory (a section
+	file, see Lander_Section.h), so Terrain_Map() just maps it. Maps
+	read from a .ppm are packed into the same layout in a malloc'd
+	buffer, so the rest of the code does not care where the terrain came
+	from.
+*/
+
+#ifndef _LANDER_TERRAIN_H
+#define _LANDER_TERRAIN_H
+
+#include <stddef.h>
+
+#include "Lander_Section.h"
+
+// Map cell values
+#define CELL_OPEN 0
+#define CELL_TERRAIN 1
+#define CELL_PLATFORM 2
+
+#define TERRAIN_VERSION 1
+
+// Header flags
+#define TERRAIN_HEIGHT 1          // Heightfield section present
+
+struct TerrainHeader {
+  char magic[4];                  // "LTRN"
+  int version;
+  int sx, sy;
+  int flags;
+  int row_bytes;                  // Occupancy bitmap row stride
+  int plat_x0, plat_y0;           // Platform extents, inclusive
+  int plat_x1, plat_y1;
+  int plat_row_bytes;             // Platform bitmap row stride
+  int reserved;
+  double plat_x, plat_y;          // Platform centroid
+  unsigned long long occ_offset;  // Section offsets from the file start
+  unsigned long long plat_offset;
+  unsigned long long height_offset;
+  unsigned long long size;        // Whole file
+};
+
+struct LanderTerrain {
+  const TerrainHeader *head;
+  const unsigned char *occ;
+  const unsigned char *plat;
+  const unsigned short *height;   // NULL without TERRAIN_HEIGHT
+  SectionFile file;
+};
+
+// Pack classified cells (CELL_* values, row-major) into a terrain in
+// memory. flags selects the optional sections. Returns 0 on failure, or
+// if there is no platform
+int Terrain_Pack(const unsigned char *cells, int sx, int sy, int flags, LanderTerrain *ter);
+
+// Map a .ltm file read-only. Returns 0, without printing anything, if
+// the file is missing, has another version or is malformed
+int Terrain_Map(const char *fname, LanderTerrain *ter);
+void Terrain_Free(LanderTerrain *ter);
+
+int Terrain_Save(const char *fname, const LanderTerrain *ter);
+
+// Name of the .ltm file that goes with a map: the map name with its
+// extension replaced
+void Terrain_File_Name(const char *map_name, char *out, int len);
+
+// Cell tests. Callers check the map bounds
+static inline int Terrain_Solid(const LanderTerrain *ter, int i, int j) {
+  return (ter->occ[(size_t)j * ter->head->row_bytes + (i >> 3)] >> (i & 7)) & 1;
+}
+
+static inline int Terrain_Platform(const LanderTerrain *ter, int i, int j) {
+  const TerrainHeader *h = ter->head;
+  if (i < h->plat_x0 || i > h->plat_x1 || j < h->plat_y0 || j > h->plat_y1) return 0;
+  i -= h->plat_x0;
+  j -= h->plat_y0;
+  return (ter->plat[(size_t)j * h->plat_row_bytes + (i >> 3)] >> (i & 7)) & 1;
+}
+
+// First solid row in column i, sy if the column is open. Needs the
+// heightfield, unused so far
+static inline int Terrain_Surface(const LanderTerrain *ter, int i) {
+  return ter->height[i];
+}
+
+#endif
@@ -0,0 +1,183 @@
+/*
+	Flight trace viewer.
+
+	Prints the frames of a .ltr trace written by the flight recorder
+	(see Lander_Recorder.h), or renders them over the map as .ppm
+	images, so crash frames only cost disk space when someone wants to
+	look at them.
+
+	Usage: Lander_Trace [-m map] [-f first] [-l last] [-e every] [-o prefix] trace.ltr
+
+	Frames are numbered from 0, the oldest in the trace. Printing shows
+	every frame by default. With -o, frames are rendered to
+	prefix_NNNN.ppm instead, by default the last 50. The map is the one
+	recorded in the trace unless -m names another.
+
+	In the images terrain is grey, the platform red, the true track
+	green, the estimated track yellow, the current sonar returns cyan
+	and the lander outline white.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "Lander_Recorder.h"
+#include "Lander_Phase.h"
+
+#define DEFAULT_RENDER 50
+
+static void Usage(void) {
+  fprintf(stderr, "Usage: Lander_Trace [-m map] [-f first] [-l last] [-e every] [-o prefix] trace.ltr\n");
+}
+
+static void Print_Frame(int k, const FlightFrame *f) {
+  printf("%4d tick=%d pos=%.1f,%.1f vel=%.2f,%.2f ang=%.1f | sens pos=%.1f,%.1f vel=%.2f,%.2f ang=%.1f range=%.1f"
+         " | est pos=%.1f,%.1f vel=%.2f,%.2f ang=%.1f failed=%02x | cmd M=%.2f L=%.2f R=%.2f",
+         k, f->tick, f->x, f->y, f->vx, f->vy, f->theta * 180 / PI,
+         f->s_px, f->s_py, f->s_vx, f->s_vy, f->s_angle, f->s_range,
+         f->e_px, f->e_py, f->e_vx, f->e_vy, f->e_angle, f->failed,
+         f->main_pw, f->left_pw, f->right_pw);
+  if (f->flags & FRAME_ROTATED) printf(" rot=%.1f", f->rotate);
+  printf(" phase=%s", f->phase < N_PHASE ? phase_name[f->phase] : "?");
+  if ((f->flags & (FRAME_MT_OK | FRAME_LT_OK | FRAME_RT_OK)) != (FRAME_MT_OK | FRAME_LT_OK | FRAME_RT_OK))
+    printf(" thrusters=%c%c%c", f->flags & FRAME_MT_OK ? 'M' : '-',
+           f->flags & FRAME_LT_OK ? 'L' : '-', f->flags & FRAME_RT_OK ? 'R' : '-');
+  printf("\n");
+}
+
+/*
+  Rendering
+*/
+
+static void Plot(unsigned char *im, int sx, int sy, double x, double y,
+                 unsigned char r, unsigned char g, unsigned char b) {
+  int i = (int)round(x);
+  int j = (int)round(y);
+  if (i < 0 || j < 0 || i >= sx || j >= sy) return;
+  unsigned char *p = im + 3 * (i + j * sx);
+  p[0] = r;
+  p[1] = g;
+  p[2] = b;
+}
+
+// Draws frame k with the tracks of every frame before it
+static int Render_Frame(const char *fname, const LanderMap *map, const LanderShape *shape,
+                        const FlightFrame *frames, int k) {
+  int sx = map->sx, sy = map->sy;
+  unsigned char *im = (unsigned char *)calloc((size_t)sx * sy * 3, 1);
+  if (im == NULL) {
+    fprintf(stderr, "Out of memory allocating space for image\n");
+    return 0;
+  }
+
+  for (int j = 0; j < sy; j++) {
+    for (int i = 0; i < sx; i++) {
+      int c = Map_Cell(map, i, j);
+      if (c == CELL_TERRAIN) Plot(im, sx, sy, i, j, 110, 110, 110);
+      else if (c == CELL_PLATFORM) Plot(im, sx, sy, i, j, 255, 0, 0);
+    }
+  }
+
+  for (int t = 0; t <= k; t++) {
+    Plot(im, sx, sy, frames[t].e_px, frames[t].e_py, 255, 255, 0);
+    Plot(im, sx, sy, frames[t].x, frames[t].y, 0, 255, 0);
+  }
+
+  const FlightFrame *f = &frames[k];
+  for (int i = 0; i < 36; i++) {
+    if (f->sonar[i] < 0) continue;
+    double a = i * 10 * PI / 180;
+    Plot(im, sx, sy, f->x + f->sonar[i] * sin(a), f->y - f->sonar[i] * cos(a), 0, 255, 255);
+  }
+
+  // Same outline transform as the contact test in Lander_Sim.cpp
+  double s = sin(f->theta);
+  double c = cos(f->theta);
+  for (int n = 0; n < shape->n; n++) {
+    double u = shape->u[n];
+    double v = shape->v[n];
+    Plot(im, sx, sy, f->x + u * c - v * s, f->y + u * s + v * c, 255, 255, 255);
+  }
+
+  FILE *out = fopen(fname, "wb");
+  if (out == NULL) {
+    fprintf(stderr, "Unable to open file %s for writing\n", fname);
+    free(im);
+    return 0;
+  }
+  fprintf(out, "P6\n%d %d\n255\n", sx, sy);
+  int ok = fwrite(im, (size_t)sx * sy * 3, 1, out) == 1;
+  if (fclose(out) != 0) ok = 0;
+  if (!ok) fprintf(stderr, "Failed to write image %s\n", fname);
+  free(im);
+  return ok;
+}
+
+int main(int argc, char *argv[]) {
+  const char *map_name = NULL;
+  const char *prefix = NULL;
+  int first = -1, last = -1, every = 1;
+
+  int a = 1;
+  while (a < argc && argv[a][0] == '-') {
+    if (!strcmp(argv[a], "-m") && a + 1 < argc) map_name = argv[++a];
+    else if (!strcmp(argv[a], "-f") && a + 1 < argc) first = (int)strtol(argv[++a], NULL, 10);
+    else if (!strcmp(argv[a], "-l") && a + 1 < argc) last = (int)strtol(argv[++a], NULL, 10);
+    else if (!strcmp(argv[a], "-e") && a + 1 < argc) every = (int)strtol(argv[++a], NULL, 10);
+    else if (!strcmp(argv[a], "-o") && a + 1 < argc) prefix = argv[++a];
+    else {
+      Usage();
+      return 1;
+    }
+    a++;
+  }
+  if (a != argc - 1 || every < 1) {
+    Usage();
+    return 1;
+  }
+
+  TraceHeader head;
+  FlightFrame *frames;
+  if (!Trace_Load(argv[a], &head, &frames)) return 1;
+
+  int n = head.nframes;
+  if (last < 0 || last >= n) last = n - 1;
+  if (first < 0) first = prefix != NULL && last + 1 > DEFAULT_RENDER ? last + 1 - DEFAULT_RENDER : 0;
+
+  printf("%s: map=%s mode=%d", argv[a], head.map_name, head.fail_mode);
+  for (int i = 1; i < N_COMP; i++)
+    if (head.f_list[i]) printf(" comp=%d", i);
+  printf(" seed=%ld status=%s time=%.3f vx=%.3f vy=%.3f angle=%.2f frames=%d\n",
+         head.seed, Sim_Status_Name(head.status), head.time, head.td_vx, head.td_vy, head.td_angle, n);
+
+  if (prefix == NULL) {
+    for (int k = first; k <= last; k += every) Print_Frame(k, &frames[k]);
+    free(frames);
+    return 0;
+  }
+
+  static LanderMap map;
+  static LanderShape shape;
+  if (!Sim_Load_Map(map_name != NULL ? map_name : head.map_name, &map)) {
+    fprintf(stderr, "Unable to open map image, pass it with -m\n");
+    return 1;
+  }
+  if (!Sim_Load_Shape("lander.ppm", &shape)) {
+    fprintf(stderr, "Unable to load lander image. Ensure it is in the same directory\n");
+    return 1;
+  }
+
+  int count = 0;
+  for (int k = first; k <= last; k += every) {
+    char fname[1024];
+    snprintf(fname, sizeof(fname), "%s_%04d.ppm", prefix, ++count);
+    if (!Render_Frame(fname, &map, &shape, frames, k)) return 1;
+  }
+  printf("%d frames rendered to %s_0001.ppm ... %s_%04d.ppm\n", count, prefix, prefix, count);
+
+  Sim_Free_Map(&map);
+  free(frames);
+  return 0;
+}
@@ -0,0 +1,650 @@
+/*
+	Controller gain autotuner.
+
+	Searches the controller gains (see Lander_Params.h) for the ones
+	that land most often, and fastest, with CMA-ES. Every candidate is
+	flown N randomized landings in each (map, failure configuration)
+	cell, and all the landings of a generation are spread over a pool
+	of worker threads.
+
+	Usage: Lander_Tune [-n N] [-j threads] [-s seed] [-t max_time] [-c config] ...
+	                   [-g generations] [-l lambda] [-S sigma] [-w time_weight]
+	                   [-i start.params] [-k cache] [-o lander.params] map1.ppm [map2.ppm ...]
+
+	A landing that fails costs 1, one that lands costs time_weight times
+	its time to land over max_time. A cell costs the mean over its
+	landings and a candidate the mean over cells, so every map and
+	failure mode counts the same however hard it is. Configurations are
+	given as for Lander_Batch, by default modes 0, 1 and 2 are flown.
+
+	The search works on each parameter scaled to [0, 1] over its range,
+	starting from the defaults (or -i) with step sigma. Candidates are
+	rounded to 1e-4 of the range and every candidate flies the same
+	seeds (common random numbers), so two candidates differ only by
+	their gains, and an evaluation can be cached under the rounded gains.
+	With -k the cache is kept in a file, and a rerun of the same build
+	with the same maps, configurations, N, seed, max_time and
+	time_weight picks up the evaluations it already has. The build is
+	a checksum of the controller and simulator sources and the compiler
+	flags (as for Lander_Sweep), so a changed controller starts over.
+
+	The best gains so far are written after every generation. At the
+	end the starting and the tuned gains are also flown on N fresh seeds
+	per cell, to show how much of the improvement carries over to
+	landings the search did not see.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Lander_Episode.h"
+
+#ifndef BUILD_HASH
+#define BUILD_HASH "unknown"
+#endif
+
+#define MAX_CONFIGS 64
+#define MAX_MAPS 8
+
+// Rounding of the scaled parameters
+#define QUANT 10000
+
+// What one candidate did, per cell
+struct Evaluation {
+  std::vector<long> landed;
+  std::vector<double> time;     // Sum of the times to land
+  double cost;
+};
+
+// Evaluation setup shared by all candidates
+struct Setup {
+  const LanderMap *maps;
+  const char **map_names;
+  int nmaps;
+  const FailConfig *configs;
+  int nconfigs;
+  const LanderShape *shape;
+  long n, seed;
+  double max_time, time_weight;
+  int nthreads;
+};
+
+typedef std::vector<int> ParamKey;
+
+/*
+  Parameters
+*/
+
+static void Key_To_Params(const ParamKey &key, ControllerParams *p) {
+  for (int i = 0; i < (int)key.size(); i++) {
+    const ParamInfo *pi = Params_Info(i);
+    Params_Set(p, i, pi->lo + (pi->hi - pi->lo) * key[i] / QUANT);
+  }
+}
+
+static ParamKey Params_To_Key(const ControllerParams *p) {
+  ParamKey key(Params_Count());
+  for (int i = 0; i < Params_Count(); i++) {
+    const ParamInfo *pi = Params_Info(i);
+    double u = (Params_Get(p, i) - pi->lo) / (pi->hi - pi->lo);
+    key[i] = (int)lround(fmin(fmax(u, 0), 1) * QUANT);
+  }
+  return key;
+}
+
+// Candidate x in scaled coordinates to a key, and how far outside the
+// search range it was (squared)
+static ParamKey Scaled_To_Key(const double *x, int d, double *outside) {
+  ParamKey key(d);
+  *outside = 0;
+  for (int i = 0; i < d; i++) {
+    double u = fmin(fmax(x[i], 0), 1);
+    *outside += (x[i] - u) * (x[i] - u);
+    key[i] = (int)lround(u * QUANT);
+  }
+  return key;
+}
+
+/*
+  Evaluation
+*/
+
+// Fly every candidate on seeds seed .. seed + n - 1 in every cell
+static void Evaluate(const Setup *su, long seed, const std::vector<ParamKey> &keys,
+                     std::vector<Evaluation> *evals) {
+  long ncells = (long)su->nmaps * su->nconfigs;
+  long per_cand = ncells * su->n;
+  long njobs = per_cand * (long)keys.size();
+  std::vector<ControllerParams> params(keys.size());
+  for (size_t c = 0; c < keys.size(); c++) Key_To_Params(keys[c], &params[c]);
+  std::vector<EpisodeResult> results(njobs);
+  std::atomic<long> next(0);
+
+  std::vector<std::thread> workers;
+  for (int t = 0; t < su->nthreads; t++) {
+    workers.push_back(std::thread([&]() {
+      long j;
+      while ((j = next.fetch_add(1)) < njobs) {
+        long cand = j / per_cand;
+        long cell = j % per_cand / su->n;
+        const FailConfig *cfg = &su->configs[cell % su->nconfigs];
+        Scenario sc;
+        sc.map = &su->maps[cell / su->nconfigs];
+        sc.shape = su->shape;
+        sc.fail_mode = cfg->mode;
+        memcpy(sc.comps, cfg->comps, sizeof(sc.comps));
+        sc.ncomps = cfg->ncomps;
+        sc.seed = seed + j % su->n;
+        sc.max_time = su->max_time;
+        sc.map_name = su->map_names[cell / su->nconfigs];
+        sc.trace_name = NULL;
+        sc.policy = NULL;
+        sc.params = &params[cand];
+        sc.exact_contact = 0;
+        sc.plan = NULL;
+        sc.time_control = 0;
+        Run_Episode(&sc, &results[j]);
+      }
+    }));
+  }
+  for (size_t t = 0; t < workers.size(); t++) workers[t].join();
+
+  evals->resize(keys.size());
+  for (size_t c = 0; c < keys.size(); c++) {
+    Evaluation *ev = &(*evals)[c];
+    ev->landed.assign(ncells, 0);
+    ev->time.assign(ncells, 0);
+    ev->cost = 0;
+    for (long cell = 0; cell < ncells; cell++) {
+      double cost = 0;
+      for (long k = 0; k < su->n; k++) {
+        const EpisodeResult *r = &results[c * per_cand + cell * su->n + k];
+        if (r->status != SIM_LANDED) {
+          cost += 1;
+          continue;
+        }
+        ev->landed[cell]++;
+        ev->time[cell] += r->time;
+        cost += su->time_weight * r->time / su->max_time;
+      }
+      ev->cost += cost / su->n / ncells;
+    }
+  }
+}
+
+/*
+  Evaluation cache
+*/
+
+typedef std::map<ParamKey, Evaluation> EvalCache;
+
+// Identifies the evaluation setup, a cache file is only used with the
+// setup it was made with
+static std::string Setup_Line(const Setup *su) {
+  char buf[256];
+  snprintf(buf, sizeof(buf), "# build %s n %ld seed %ld max_time %g time_weight %g params %d maps",
+           BUILD_HASH, su->n, su->seed, su->max_time, su->time_weight, Params_Count());
+  std::string line = buf;
+  for (int i = 0; i < su->nmaps; i++) line += std::string(" ") + su->map_names[i];
+  line += " configs";
+  for (int i = 0; i < su->nconfigs; i++) line += std::string(" ") + su->configs[i].name;
+  return line + "\n";
+}
+
+// One line per evaluation: the key, then cost, landings and time sums
+static void Cache_Load(const char *fname, const Setup *su, EvalCache *cache) {
+  FILE *f = fopen(fname, "r");
+  if (f == NULL) return;
+  std::string setup = Setup_Line(su);
+  std::vector<char> line(setup.size() + 4096);
+  if (fgets(&line[0], line.size(), f) == NULL || setup != &line[0]) {
+    fprintf(stderr, "%s was made with another setup, not using it\n", fname);
+    fclose(f);
+    return;
+  }
+  long ncells = (long)su->nmaps * su->nconfigs;
+  int d = Params_Count();
+  while (fgets(&line[0], line.size(), f) != NULL) {
+    ParamKey key(d);
+    Evaluation ev;
+    ev.landed.resize(ncells);
+    ev.time.resize(ncells);
+    char *p = &line[0], *end;
+    bool ok = true;
+    for (int i = 0; i < d && ok; i++) {
+      key[i] = (int)strtol(p, &end, 10);
+      ok = end != p;
+      p = end;
+    }
+    ev.cost = strtod(p, &end);
+    ok = ok && end != p;
+    p = end;
+    for (long c = 0; c < ncells && ok; c++) {
+      ev.landed[c] = strtol(p, &end, 10);
+      ok = end != p;
+      p = end;
+      ev.time[c] = strtod(p, &end);
+      ok = ok && end != p;
+      p = end;
+    }
+    if (ok) (*cache)[key] = ev;
+  }
+  fclose(f);
+  fprintf(stderr, "%zu cached evaluations from %s\n", cache->size(), fname);
+}
+
+static int Cache_Save(const char *fname, const Setup *su, const EvalCache *cache) {
+  FILE *f = fopen(fname, "w");
+  if (f == NULL) {
+    fprintf(stderr, "Unable to open file %s for writing\n", fname);
+    return 0;
+  }
+  fputs(Setup_Line(su).c_str(), f);
+  for (EvalCache::const_iterator it = cache->begin(); it != cache->end(); ++it) {
+    for (size_t i = 0; i < it->first.size(); i++) fprintf(f, "%d ", it->first[i]);
+    fprintf(f, "%.17g", it->second.cost);
+    for (size_t c = 0; c < it->second.landed.size(); c++)
+      fprintf(f, " %ld %.17g", it->second.landed[c], it->second.time[c]);
+    fprintf(f, "\n");
+  }
+  if (fclose(f) != 0) {
+    fprintf(stderr, "Failed to write cache %s\n", fname);
+    return 0;
+  }
+  return 1;
+}
+
+/*
+  CMA-ES
+*/
+
+// Normal deviates for the search, from splitmix64
+struct Gauss {
+  unsigned long long s;
+  bool have;
+  double spare;
+};
+
+static double Uniform(Gauss *g) {
+  unsigned long long z = (g->s += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  z ^= z >> 31;
+  return ((z >> 11) + .5) / 9007199254740992.0;
+}
+
+static double Normal(Gauss *g) {
+  if (g->have) {
+    g->have = false;
+    return g->spare;
+  }
+  double r = sqrt(-2 * log(Uniform(g)));
+  double t = 2 * M_PI * Uniform(g);
+  g->spare = r * sin(t);
+  g->have = true;
+  return r * cos(t);
+}
+
+// Eigen decomposition of the symmetric d x d matrix C (row major) by
+// Jacobi rotations: C = B diag(e) B^T, eigenvectors in the columns of B
+static void Eigen(int d, const double *C, double *B, double *e) {
+  std::vector<double> A(C, C + d * d);
+  for (int i = 0; i < d * d; i++) B[i] = i % (d + 1) == 0;
+  for (int sweep = 0; sweep < 64; sweep++) {
+    double off = 0;
+    for (int i = 0; i < d; i++)
+      for (int j = i + 1; j < d; j++) off += A[i * d + j] * A[i * d + j];
+    if (off < 1e-30) break;
+    for (int p = 0; p < d; p++) {
+      for (int q = p + 1; q < d; q++) {
+        double apq = A[p * d + q];
+        if (fabs(apq) < 1e-300) continue;
+        double theta = (A[q * d + q] - A[p * d + p]) / (2 * apq);
+        double t = (theta >= 0 ? 1 : -1) / (fabs(theta) + sqrt(theta * theta + 1));
+        double c = 1 / sqrt(t * t + 1), s = t * c;
+        for (int k = 0; k < d; k++) {
+          double akp = A[k * d + p], akq = A[k * d + q];
+          A[k * d + p] = c * akp - s * akq;
+          A[k * d + q] = s * akp + c * akq;
+        }
+        for (int k = 0; k < d; k++) {
+          double apk = A[p * d + k], aqk = A[q * d + k];
+          A[p * d + k] = c * apk - s * aqk;
+          A[q * d + k] = s * apk + c * aqk;
+        }
+        for (int k = 0; k < d; k++) {
+          double bkp = B[k * d + p], bkq = B[k * d + q];
+          B[k * d + p] = c * bkp - s * bkq;
+          B[k * d + q] = s * bkp + c * bkq;
+        }
+      }
+    }
+  }
+  for (int i = 0; i < d; i++) e[i] = A[i * d + i];
+}
+
+// (mu/mu_w, lambda)-CMA-ES state, after Hansen's tutorial
+struct CMA {
+  int d, lambda, mu;
+  std::vector<double> w;
+  double mueff, cc, cs, c1, cmu, damps, chin;
+  std::vector<double> m, ps, pc, C, B, D;
+  double sigma;
+  int gen;
+};
+
+static void CMA_Init(CMA *es, int d, int lambda, const double *x0, double sigma) {
+  es->d = d;
+  es->lambda = lambda;
+  es->mu = lambda / 2;
+  es->w.resize(es->mu);
+  double sw = 0, sw2 = 0;
+  for (int i = 0; i < es->mu; i++) {
+    es->w[i] = log(es->mu + .5) - log(i + 1.0);
+    sw += es->w[i];
+  }
+  for (int i = 0; i < es->mu; i++) {
+    es->w[i] /= sw;
+    sw2 += es->w[i] * es->w[i];
+  }
+  es->mueff = 1 / sw2;
+  es->cc = (4 + es->mueff / d) / (d + 4 + 2 * es->mueff / d);
+  es->cs = (es->mueff + 2) / (d + es->mueff + 5);
+  es->c1 = 2 / ((d + 1.3) * (d + 1.3) + es->mueff);
+  es->cmu = fmin(1 - es->c1, 2 * (es->mueff - 2 + 1 / es->mueff) / ((d + 2) * (d + 2) + es->mueff));
+  es->damps = 1 + 2 * fmax(0, sqrt((es->mueff - 1) / (d + 1)) - 1) + es->cs;
+  es->chin = sqrt((double)d) * (1 - 1.0 / (4 * d) + 1.0 / (21.0 * d * d));
+  es->m.assign(x0, x0 + d);
+  es->ps.assign(d, 0);
+  es->pc.assign(d, 0);
+  es->C.assign(d * d, 0);
+  es->B.assign(d * d, 0);
+  es->D.assign(d, 1);
+  for (int i = 0; i < d; i++) es->C[i * d + i] = es->B[i * d + i] = 1;
+  es->sigma = sigma;
+  es->gen = 0;
+}
+
+// Draw lambda candidates: z standard normal, x = m + sigma B D z
+static void CMA_Sample(const CMA *es, Gauss *g, std::vector<double> *x, std::vector<double> *z) {
+  int d = es->d;
+  x->resize(es->lambda * d);
+  z->resize(es->lambda * d);
+  for (int k = 0; k < es->lambda; k++) {
+    double *zk = &(*z)[k * d];
+    double *xk = &(*x)[k * d];
+    for (int i = 0; i < d; i++) zk[i] = Normal(g);
+    for (int i = 0; i < d; i++) {
+      double y = 0;
+      for (int j = 0; j < d; j++) y += es->B[i * d + j] * es->D[j] * zk[j];
+      xk[i] = es->m[i] + es->sigma * y;
+    }
+  }
+}
+
+// Update from this generation's costs
+static void CMA_Update(CMA *es, const std::vector<double> &x, const std::vector<double> &z,
+                       const std::vector<double> &cost) {
+  int d = es->d;
+  std::vector<int> order(es->lambda);
+  for (int k = 0; k < es->lambda; k++) order[k] = k;
+  std::sort(order.begin(), order.end(), [&](int a, int b) { return cost[a] < cost[b]; });
+
+  // New mean, and the mean step in z (for ps) and in y = B D z (for pc, C)
+  std::vector<double> zw(d, 0), yw(d, 0);
+  std::vector<double> old = es->m;
+  for (int i = 0; i < d; i++) es->m[i] = 0;
+  for (int r = 0; r < es->mu; r++) {
+    const double *xk = &x[order[r] * d];
+    const double *zk = &z[order[r] * d];
+    for (int i = 0; i < d; i++) {
+      es->m[i] += es->w[r] * xk[i];
+      zw[i] += es->w[r] * zk[i];
+    }
+  }
+  for (int i = 0; i < d; i++) yw[i] = (es->m[i] - old[i]) / es->sigma;
+
+  // ps takes C^-1/2 yw = B zw
+  double a = sqrt(es->cs * (2 - es->cs) * es->mueff);
+  for (int i = 0; i < d; i++) {
+    double bz = 0;
+    for (int j = 0; j < d; j++) bz += es->B[i * d + j] * zw[j];
+    es->ps[i] = (1 - es->cs) * es->ps[i] + a * bz;
+  }
+  double psn = 0;
+  for (int i = 0; i < d; i++) psn += es->ps[i] * es->ps[i];
+  psn = sqrt(psn);
+  es->gen++;
+  double hsig = psn / sqrt(1 - pow(1 - es->cs, 2.0 * es->gen)) / es->chin < 1.4 + 2.0 / (d + 1);
+
+  double b = sqrt(es->cc * (2 - es->cc) * es->mueff);
+  for (int i = 0; i < d; i++) es->pc[i] = (1 - es->cc) * es->pc[i] + hsig * b * yw[i];
+
+  // Rank one and rank mu updates
+  double keep = 1 - es->c1 - es->cmu + (1 - hsig) * es->c1 * es->cc * (2 - es->cc);
+  for (int i = 0; i < d; i++) {
+    for (int j = 0; j <= i; j++) {
+      double rmu = 0;
+      for (int r = 0; r < es->mu; r++) {
+        const double *xk = &x[order[r] * d];
+        rmu += es->w[r] * (xk[i] - old[i]) * (xk[j] - old[j]);
+      }
+      rmu /= es->sigma * es->sigma;
+      double c = keep * es->C[i * d + j] + es->c1 * es->pc[i] * es->pc[j] + es->cmu * rmu;
+      es->C[i * d + j] = es->C[j * d + i] = c;
+    }
+  }
+
+  es->sigma *= exp(es->cs / es->damps * (psn / es->chin - 1));
+
+  Eigen(d, &es->C[0], &es->B[0], &es->D[0]);
+  for (int i = 0; i < d; i++) es->D[i] = sqrt(fmax(es->D[i], 1e-20));
+}
+
+/*
+  Output
+*/
+
+static void Print_Cells(const Setup *su, const char *title, const Evaluation *a, const Evaluation *b) {
+  printf("%s\n%-10s %-10s %-22s %-22s\n", title, "map", "config", "start", "tuned");
+  for (int cell = 0; cell < su->nmaps * su->nconfigs; cell++) {
+    char s[2][32];
+    const Evaluation *ev[2] = {a, b};
+    for (int k = 0; k < 2; k++) {
+      long l = ev[k]->landed[cell];
+      if (l > 0) snprintf(s[k], sizeof(s[k]), "%.3f, %.2f s", (double)l / su->n, ev[k]->time[cell] / l);
+      else snprintf(s[k], sizeof(s[k]), "%.3f", 0.0);
+    }
+    printf("%-10s %-10s %-22s %-22s\n", su->map_names[cell / su->nconfigs],
+           su->configs[cell % su->nconfigs].name, s[0], s[1]);
+  }
+  printf("cost %.4f -> %.4f\n", a->cost, b->cost);
+}
+
+static int Save_Best(const char *fname, const Setup *su, const ParamKey &key, const Evaluation *ev) {
+  std::string note = "# Lander_Tune, lower cost is better (see Lander_Tune.cpp)\n";
+  note += Setup_Line(su);
+  char buf[128];
+  snprintf(buf, sizeof(buf), "# cost %.4f, success and mean time to land per cell:\n", ev->cost);
+  note += buf;
+  for (int cell = 0; cell < su->nmaps * su->nconfigs; cell++) {
+    long l = ev->landed[cell];
+    snprintf(buf, sizeof(buf), "#   %s %s: %.3f, %.2f s\n", su->map_names[cell / su->nconfigs],
+             su->configs[cell % su->nconfigs].name, (double)l / su->n, l > 0 ? ev->time[cell] / l : 0);
+    note += buf;
+  }
+  ControllerParams p;
+  Key_To_Params(key, &p);
+  return Params_Save(fname, &p, note.c_str());
+}
+
+static void Usage(void) {
+  fprintf(stderr, "Usage: Lander_Tune [-n N] [-j threads] [-s seed] [-t max_time] [-c config] ...\n");
+  fprintf(stderr, "                   [-g generations] [-l lambda] [-S sigma] [-w time_weight]\n");
+  fprintf(stderr, "                   [-i start.params] [-k cache] [-o lander.params] map1.ppm [map2.ppm ...]\n");
+}
+
+int main(int argc, char *argv[]) {
+  Setup su;
+  su.n = 20;
+  su.nthreads = (int)std::thread::hardware_concurrency();
+  su.seed = 1;
+  su.max_time = 300;
+  su.time_weight = 1;
+  FailConfig configs[MAX_CONFIGS];
+  int nconfigs = 0;
+  int generations = 40;
+  int lambda = 0;
+  double sigma = .15;
+  const char *start_name = NULL;
+  const char *cache_name = NULL;
+  const char *out_name = PARAMS_FILE;
+
+  int a = 1;
+  while (a < argc && argv[a][0] == '-') {
+    if (!strcmp(argv[a], "-n") && a + 1 < argc) su.n = strtol(argv[++a], NULL, 10);
+    else if (!strcmp(argv[a], "-j") && a + 1 < argc) su.nthreads = (int)strtol(argv[++a], NULL, 10);
+    else if (!strcmp(argv[a], "-s") && a + 1 < argc) su.seed = strtol(argv[++a], NULL, 10);
+    else if (!strcmp(argv[a], "-t") && a + 1 < argc) su.max_time = atof(argv[++a]);
+    else if (!strcmp(argv[a], "-g") && a + 1 < argc) generations = (int)strtol(argv[++a], NULL, 10);
+    else if (!strcmp(argv[a], "-l") && a + 1 < argc) lambda = (int)strtol(argv[++a], NULL, 10);
+    else if (!strcmp(argv[a], "-S") && a + 1 < argc) sigma = atof(argv[++a]);
+    else if (!strcmp(argv[a], "-w") && a + 1 < argc) su.time_weight = atof(argv[++a]);
+    else if (!strcmp(argv[a], "-i") && a + 1 < argc) start_name = argv[++a];
+    else if (!strcmp(argv[a], "-k") && a + 1 < argc) cache_name = argv[++a];
+    else if (!strcmp(argv[a], "-o") && a + 1 < argc) out_name = argv[++a];
+    else if (!strcmp(argv[a], "-c") && a + 1 < argc && nconfigs < MAX_CONFIGS) {
+      if (!Parse_Config(argv[++a], &configs[nconfigs++])) {
+        fprintf(stderr, "Bad failure configuration %s\n", argv[a]);
+        return 1;
+      }
+    }
+    else {
+      Usage();
+      return 1;
+    }
+    a++;
+  }
+  int d = Params_Count();
+  if (lambda == 0) lambda = 4 + (int)(3 * log((double)d));
+  if (a >= argc || su.n < 1 || generations < 1 || lambda < 4 || !(sigma > 0) || !(su.max_time > 0)) {
+    Usage();
+    return 1;
+  }
+  if (su.nthreads < 1) su.nthreads = 1;
+
+  if (nconfigs == 0) {
+    const char *defaults[] = {"0", "1", "2"};
+    for (int i = 0; i < 3; i++) Parse_Config(defaults[i], &configs[nconfigs++]);
+  }
+
+  static LanderMap maps[MAX_MAPS];
+  const char *map_names[MAX_MAPS];
+  int nmaps = 0;
+  for (; a < argc && nmaps < MAX_MAPS; a++) {
+    if (!Sim_Load_Map(argv[a], &maps[nmaps])) return 1;
+    map_names[nmaps++] = argv[a];
+  }
+  static LanderShape shape;
+  if (!Sim_Load_Shape("lander.ppm", &shape)) {
+    fprintf(stderr, "Unable to load lander image. Ensure it is in the same directory\n");
+    return 1;
+  }
+  su.maps = maps;
+  su.map_names = map_names;
+  su.nmaps = nmaps;
+  su.configs = configs;
+  su.nconfigs = nconfigs;
+  su.shape = &shape;
+
+  ControllerParams start;
+  Params_Default(&start);
+  if (start_name != NULL && !Params_Load(start_name, &start)) return 1;
+  ParamKey start_key = Params_To_Key(&start);
+
+  EvalCache cache;
+  if (cache_name != NULL) Cache_Load(cache_name, &su, &cache);
+
+  std::vector<double> x0(d);
+  for (int i = 0; i < d; i++) x0[i] = (double)start_key[i] / QUANT;
+  CMA es;
+  CMA_Init(&es, d, lambda, &x0[0], sigma);
+  Gauss g = {(unsigned long long)su.seed, false, 0};
+
+  struct timespec t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+
+  // The starting point is evaluated first, the search has to beat it
+  std::vector<ParamKey> todo(1, start_key);
+  std::vector<Evaluation> evals;
+  if (cache.find(start_key) == cache.end()) {
+    Evaluate(&su, su.seed, todo, &evals);
+    cache[start_key] = evals[0];
+  }
+  ParamKey best_key = start_key;
+  double best_cost = cache[start_key].cost;
+  printf("start: cost %.4f\n", best_cost);
+  printf("%4s %6s %6s %10s %10s %8s\n", "gen", "evals", "cached", "gen best", "best", "sigma");
+
+  std::vector<double> x, z;
+  for (int gen = 0; gen < generations; gen++) {
+    CMA_Sample(&es, &g, &x, &z);
+    std::vector<ParamKey> keys(lambda);
+    std::vector<double> outside(lambda);
+    todo.clear();
+    for (int k = 0; k < lambda; k++) {
+      keys[k] = Scaled_To_Key(&x[k * d], d, &outside[k]);
+      if (cache.find(keys[k]) == cache.end() && std::find(todo.begin(), todo.end(), keys[k]) == todo.end())
+        todo.push_back(keys[k]);
+    }
+    Evaluate(&su, su.seed, todo, &evals);
+    for (size_t c = 0; c < todo.size(); c++) cache[todo[c]] = evals[c];
+
+    std::vector<double> cost(lambda);
+    double gen_best = 1e30;
+    for (int k = 0; k < lambda; k++) {
+      const Evaluation *ev = &cache[keys[k]];
+      cost[k] = ev->cost + outside[k];
+      gen_best = fmin(gen_best, ev->cost);
+      if (ev->cost < best_cost) {
+        best_cost = ev->cost;
+        best_key = keys[k];
+      }
+    }
+    CMA_Update(&es, x, z, cost);
+
+    printf("%4d %6d %6d %10.4f %10.4f %8.4f\n", gen + 1, lambda, lambda - (int)todo.size(),
+           gen_best, best_cost, es.sigma);
+    fflush(stdout);
+    if (!Save_Best(out_name, &su, best_key, &cache[best_key])) return 1;
+    if (cache_name != NULL && !todo.empty()) Cache_Save(cache_name, &su, &cache);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  double wall = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+  printf("%zu evaluations on %d threads in %.2fs, best written to %s\n\n",
+         cache.size(), su.nthreads, wall, out_name);
+
+  Print_Cells(&su, "Tuning seeds (success, mean time to land):", &cache[start_key], &cache[best_key]);
+
+  // Fresh seeds, right after the tuning ones
+  todo.clear();
+  todo.push_back(start_key);
+  todo.push_back(best_key);
+  Evaluate(&su, su.seed + su.n, todo, &evals);
+  printf("\n");
+  Print_Cells(&su, "Fresh seeds:", &evals[0], &evals[1]);
+
+  for (int i = 0; i < nmaps; i++) Sim_Free_Map(&maps[i]);
+  return 0;
+}
@@ -0,0 +1,344 @@
+/*
+	Live flight viewer.
+
+	Flies one landing in the headless simulator on its own thread, at
+	full speed or paced to a multiple of real time, and shows it in a
+	GLUT window drawn on the main thread. The flight thread never waits
+	for the display: after every tick it copies a frame (see
+	Lander_Recorder.h) into a lock-free ring (Lander_Ring.h) if there is
+	room, and goes on. The window drains the ring on its own timer,
+	keeps the track and HIST samples of velocity for a plot, and
+	draws the newest frame. When drawing falls behind, frames are
+	dropped, not the flight slowed.
+
+	Usage: Lander_View [-s seed] [-t max_time] [-x speed] [-f fps] [-p policy] [-P params] MapName FailMode [component1] ...
+
+	-x sets the pace as a multiple of real time (default 1), 0 flies as
+	fast as the simulation goes. -f sets the display rate (default 60).
+	Without DISPLAY the flight runs with no viewer and no ring at all,
+	at full speed, and prints its result like Lander_Headless. Press 'q'
+	in the window to quit.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include <GL/glut.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "Lander_Recorder.h"
+#include "Lander_Ring.h"
+
+// Frames in flight between the two threads, about five seconds of
+// flight; only a stalled window ever fills it
+#define VIEW_RING 1024
+
+// Ticks between velocity plot samples, HIST samples cover 9 s
+#define HIST_EVERY 10
+
+typedef SpscRing<FlightFrame, VIEW_RING> FrameRing;
+
+struct Flight {
+  LanderSim sim;
+  LanderController *controller;
+  double speed;
+  FrameRing *ring;                  // NULL to fly without a viewer
+  std::atomic<bool> done, quit;
+  std::atomic<long> dropped;        // Frames the ring had no room for
+  double wall;                      // Seconds the flight took
+};
+
+// Flight thread: the same loop as Lander_Headless, plus publishing
+static void Fly(Flight *fl) {
+  LanderSim *sim = &fl->sim;
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  while (sim->status == SIM_FLYING && !fl->quit.load(std::memory_order_relaxed)) {
+    fl->controller->Lander_Control();
+    fl->controller->Safety_Override();
+    if (fl->ring != NULL) {
+      FlightFrame *f = fl->ring->Claim();
+      if (f != NULL) {
+        Frame_Capture(f, sim, fl->controller);
+        fl->ring->Publish();
+      }
+      else fl->dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    Sim_Step(sim);
+
+    // Pacing, the check is one clock read a tick
+    if (fl->speed > 0) {
+      std::chrono::duration<double> due(sim->sim_time / fl->speed);
+      std::chrono::steady_clock::time_point at =
+          t0 + std::chrono::duration_cast<std::chrono::steady_clock::duration>(due);
+      if (std::chrono::steady_clock::now() < at) std::this_thread::sleep_until(at);
+    }
+  }
+  fl->wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  fl->done.store(true, std::memory_order_release);
+}
+
+/*
+  Viewer. GLUT callbacks take no arguments, so its state is global
+*/
+
+static Flight *view_flight;
+static const LanderMap *view_map;
+static const LanderShape *view_shape;
+static std::vector<unsigned char> view_background;
+static std::vector<float> view_track;      // x, y of every frame received
+static FlightFrame view_last;              // Newest frame received
+static long view_frames;                   // Frames received
+static float view_hist[HIST][2];           // vx, vy samples, a ring
+static long view_samples;
+static std::thread view_thread;
+static int view_period_ms;
+
+static void Draw_Text(int x, int y, const char *text) {
+  glRasterPos2i(x, y);
+  for (const char *c = text; *c; c++) glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, *c);
+}
+
+static void Display(void) {
+  int sx = view_map->sx, sy = view_map->sy;
+  glClear(GL_COLOR_BUFFER_BIT);
+
+  // Map, its rows are top down
+  glRasterPos2i(0, 0);
+  glPixelZoom(1, -1);
+  glDrawPixels(sx, sy, GL_RGB, GL_UNSIGNED_BYTE, &view_background[0]);
+
+  if (view_frames == 0) {
+    glutSwapBuffers();
+    return;
+  }
+  const FlightFrame *f = &view_last;
+
+  // Track
+  glColor3f(0, 1, 0);
+  glBegin(GL_LINE_STRIP);
+  for (size_t i = 0; i < view_track.size(); i += 2) glVertex2f(view_track[i], view_track[i + 1]);
+  glEnd();
+
+  // Sonar returns
+  glColor3f(0, 1, 1);
+  glBegin(GL_POINTS);
+  for (int i = 0; i < 36; i++) {
+    if (f->sonar[i] < 0) continue;
+    double a = i * 10 * PI / 180;
+    glVertex2f(f->x + f->sonar[i] * sin(a), f->y - f->sonar[i] * cos(a));
+  }
+  glEnd();
+
+  // Lander outline, same transform as the contact test in Lander_Sim.cpp
+  double s = sin(f->theta);
+  double c = cos(f->theta);
+  glColor3f(1, 1, 1);
+  glBegin(GL_POINTS);
+  for (int n = 0; n < view_shape->n; n++) {
+    double u = view_shape->u[n];
+    double v = view_shape->v[n];
+    glVertex2f(f->x + u * c - v * s, f->y + u * s + v * c);
+  }
+  glEnd();
+
+  // Flames, away from each firing nozzle, as long as the delivered power
+  double r = view_shape->radius;
+  double flame[3][3] = {{0, 1, f->d_main}, {-1, 0, f->d_left}, {1, 0, f->d_right}};
+  glColor3f(1, .5, 0);
+  glBegin(GL_LINES);
+  for (int k = 0; k < 3; k++) {
+    if (flame[k][2] <= 0) continue;
+    double dx = flame[k][0] * c - flame[k][1] * s;
+    double dy = flame[k][0] * s + flame[k][1] * c;
+    glVertex2f(f->x + dx * r, f->y + dy * r);
+    glVertex2f(f->x + dx * r * (1 + flame[k][2]), f->y + dy * r * (1 + flame[k][2]));
+  }
+  glEnd();
+
+  // Velocity over the last HIST samples, vx yellow and vy magenta, 1 m/s
+  // a pixel about a midline
+  long n = view_samples < HIST ? view_samples : HIST;
+  int x0 = 10, ymid = 80;
+  glColor3f(.4, .4, .4);
+  glBegin(GL_LINES);
+  glVertex2i(x0, ymid);
+  glVertex2i(x0 + HIST, ymid);
+  glEnd();
+  for (int v = 0; v < 2; v++) {
+    glColor3f(1, v ? 0 : 1, v ? 1 : 0);
+    glBegin(GL_LINE_STRIP);
+    for (long k = 0; k < n; k++) {
+      const float *h = view_hist[(view_samples - n + k) % HIST];
+      glVertex2f(x0 + k, ymid - fmax(-60, fmin(60, h[v])));
+    }
+    glEnd();
+  }
+
+  char text[256];
+  const LanderSim *sim = &view_flight->sim;
+  glColor3f(1, 1, 1);
+  snprintf(text, sizeof(text), "t=%.2f s  vx=%.2f  vy=%.2f  angle=%.1f  thrusters=%c%c%c  dropped=%ld",
+           f->tick * T_STEP, f->vx, f->vy, f->theta * 180 / PI,
+           f->flags & FRAME_MT_OK ? 'M' : '-', f->flags & FRAME_LT_OK ? 'L' : '-',
+           f->flags & FRAME_RT_OK ? 'R' : '-', view_flight->dropped.load(std::memory_order_relaxed));
+  Draw_Text(10, 20, text);
+  if (view_flight->done.load(std::memory_order_acquire)) {
+    snprintf(text, sizeof(text), "%s after %.2f s, 'q' quits", Sim_Status_Name(sim->status), sim->sim_time);
+    Draw_Text(10, 36, text);
+  }
+  glutSwapBuffers();
+}
+
+// Drain what the flight thread published since the last redraw, at most
+// a ring's worth so a flight at full speed cannot keep the window busy
+static void Timer(int value) {
+  const FlightFrame *f;
+  for (int k = 0; k < VIEW_RING && (f = view_flight->ring->Peek()) != NULL; k++) {
+    view_last = *f;
+    if (f->tick % HIST_EVERY == 0) {
+      view_hist[view_samples % HIST][0] = f->vx;
+      view_hist[view_samples % HIST][1] = f->vy;
+      view_samples++;
+    }
+    view_track.push_back(f->x);
+    view_track.push_back(f->y);
+    view_frames++;
+    view_flight->ring->Release();
+  }
+  glutPostRedisplay();
+  glutTimerFunc(view_period_ms, Timer, value);
+}
+
+static void Keyboard(unsigned char key, int, int) {
+  if (key != 'q' && key != 'Q') return;
+  view_flight->quit.store(true);
+  view_thread.join();
+  exit(0);
+}
+
+static void Reshape(int w, int h) {
+  glViewport(0, 0, w, h);
+  glMatrixMode(GL_PROJECTION);
+  glLoadIdentity();
+  glOrtho(0, view_map->sx, view_map->sy, 0, -1, 1);
+  glMatrixMode(GL_MODELVIEW);
+  glLoadIdentity();
+}
+
+// Same colours as the frames Lander_Trace renders
+static void Make_Background(const LanderMap *map) {
+  view_background.assign((size_t)map->sx * map->sy * 3, 0);
+  for (int j = 0; j < map->sy; j++) {
+    for (int i = 0; i < map->sx; i++) {
+      unsigned char *p = &view_background[3 * ((size_t)j * map->sx + i)];
+      int cell = Map_Cell(map, i, j);
+      if (cell == CELL_TERRAIN) p[0] = p[1] = p[2] = 110;
+      else if (cell == CELL_PLATFORM) p[0] = 255;
+    }
+  }
+}
+
+static void Usage(void) {
+  fprintf(stderr, "Usage: Lander_View [-s seed] [-t max_time] [-x speed] [-f fps] [-p policy] [-P params] MapName FailMode [component1] [component2] ... [component9]\n");
+}
+
+int main(int argc, char *argv[]) {
+  long seed = (long)time(NULL);
+  double max_time = 300;
+  double speed = 1;
+  int fps = 60;
+  const char *policy_name = NULL;
+  const char *params_name = NULL;
+
+  int a = 1;
+  while (a < argc && argv[a][0] == '-') {
+    if (!strcmp(argv[a], "-s") && a + 1 < argc) seed = strtol(argv[++a], NULL, 10);
+    else if (!strcmp(argv[a], "-t") && a + 1 < argc) max_time = atof(argv[++a]);
+    else if (!strcmp(argv[a], "-x") && a + 1 < argc) speed = atof(argv[++a]);
+    else if (!strcmp(argv[a], "-f") && a + 1 < argc) fps = (int)strtol(argv[++a], NULL, 10);
+    else if (!strcmp(argv[a], "-p") && a + 1 < argc) policy_name = argv[++a];
+    else if (!strcmp(argv[a], "-P") && a + 1 < argc) params_name = argv[++a];
+    else {
+      Usage();
+      return 1;
+    }
+    a++;
+  }
+  if (argc - a < 2 || fps < 1 || speed < 0) {
+    Usage();
+    return 1;
+  }
+
+  const char *map_name = argv[a];
+  int fail_mode = (int)strtol(argv[a + 1], NULL, 10);
+  int comps[N_COMP];
+  int ncomps = 0;
+  for (int i = a + 2; i < argc && ncomps < N_COMP; i++)
+    comps[ncomps++] = (int)strtol(argv[i], NULL, 10);
+
+  static LanderMap map;
+  static LanderShape shape;
+  if (!Sim_Load_Map(map_name, &map)) return 1;
+  if (!Sim_Load_Shape("lander.ppm", &shape)) {
+    fprintf(stderr, "Unable to load lander image. Ensure it is in the same directory\n");
+    return 1;
+  }
+  static LanderPolicy policy;
+  if (policy_name != NULL && !Policy_Map(policy_name, &policy)) return 1;
+  ControllerParams params;
+  Params_Default(&params);
+  if (params_name != NULL && !Params_Load(params_name, &params)) return 1;
+
+  static Flight fl;
+  Sim_Reset(&fl.sim, &map, &shape, fail_mode, comps, ncomps, seed);
+  fl.sim.max_time = max_time;
+  SimIO io(&fl.sim);
+  LanderController controller(&io);
+  controller.Set_Policy(policy_name != NULL ? &policy : NULL);
+  controller.Set_Params(&params);
+  fl.controller = &controller;
+  fl.done = false;
+  fl.quit = false;
+  fl.dropped = 0;
+
+  if (getenv("DISPLAY") == NULL) {
+    fprintf(stderr, "DISPLAY is not set, flying without the viewer\n");
+    fl.speed = 0;
+    fl.ring = NULL;
+    Fly(&fl);
+    printf("map=%s mode=%d seed=%ld status=%s time=%.3f vx=%.3f vy=%.3f angle=%.2f ticks=%ld wall_ms=%.3f\n",
+           map_name, fail_mode, seed, Sim_Status_Name(fl.sim.status), fl.sim.sim_time,
+           fl.sim.td_vx, fl.sim.td_vy, fl.sim.td_angle, fl.sim.ticks, fl.wall * 1000);
+    Sim_Free_Map(&map);
+    return fl.sim.status == SIM_LANDED ? 0 : 2;
+  }
+
+  static FrameRing ring;
+  fl.speed = speed;
+  fl.ring = &ring;
+  view_flight = &fl;
+  view_map = &map;
+  view_shape = &shape;
+  view_period_ms = 1000 / fps;
+  Make_Background(&map);
+
+  glutInit(&argc, argv);
+  glutInitDisplayMode(GLUT_RGB | GLUT_DOUBLE);
+  glutInitWindowSize(map.sx, map.sy);
+  glutCreateWindow("Lander_View");
+  glutDisplayFunc(Display);
+  glutReshapeFunc(Reshape);
+  glutKeyboardFunc(Keyboard);
+  glutTimerFunc(view_period_ms, Timer, 0);
+
+  view_thread = std::thread(Fly, &fl);
+  glutMainLoop();
+  return 0;
+}